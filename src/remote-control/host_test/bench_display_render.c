@@ -0,0 +1,261 @@
+/*
+ * Render and flush benchmark of the display task's frame path: the real
+ * render() and flush() of display.c on fake_panel.c.
+ *
+ * Each scenario is rendered twice, once through the cached text layer and
+ * once with text_draw() replaced by the per-character path it superseded,
+ * which shifted every glyph column into place on every frame. Both draw
+ * identical frames (checked; the strings are ASCII, which is all the old
+ * path could draw), so the difference is the cost of the text layer alone.
+ *
+ * Host times measure CPU work only and are relative; on the device the
+ * same numbers are in display_get_metrics() (last_render_us,
+ * last_frame_us). The SPI time is computed from the bytes at the panel
+ * clock.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common/config.h"
+#include "display/font.h"
+#include "display/framebuffer.h"
+#include "display/text.h"
+
+#define BENCH_FRAMES        100000
+#define BENCH_ROUNDS        5       /* Render times are the best round */
+#define BENCH_CHECK_FRAMES  500
+#define BENCH_MESSAGES      256     /* Distinct messages, many more than TEXT_CACHE_SIZE */
+
+static bool s_legacy = false;
+
+static void legacy_draw_column(framebuffer_t *fb, int x, int y, uint8_t bits)
+{
+    if (x < 0 || x >= FB_WIDTH || y <= -8 || y >= FB_HEIGHT) {
+        return;
+    }
+    int page = y >> 3;
+    int shift = y & 7;
+    if (page >= 0) {
+        fb->pages[page][x] |= (uint8_t)(bits << shift);
+    }
+    if (shift != 0 && page + 1 < FB_PAGES) {
+        fb->pages[page + 1][x] |= (uint8_t)(bits >> (8 - shift));
+    }
+}
+
+/* The old fb_draw_text(), clipped to the columns left..right-1 */
+static void legacy_draw_text(framebuffer_t *fb, int x, int y, int left, int right, const char *text)
+{
+    for (; *text != '\0' && x < right; text++) {
+        const uint8_t *glyph = font_glyph((uint8_t)*text);
+        for (int col = 0; col < FONT_GLYPH_WIDTH; col++) {
+            if (x + col >= left) {
+                legacy_draw_column(fb, x + col, y, glyph[col]);
+            }
+        }
+        x += FONT_ADVANCE;
+    }
+}
+
+static int legacy_text_width(const char *text)
+{
+    size_t len = strlen(text);
+    return len > 0 ? (int)len * FONT_ADVANCE - 1 : 0;
+}
+
+static bool legacy_text_draw(framebuffer_t *fb, int x, int y, int width, const char *text, uint32_t scroll)
+{
+    int text_width = legacy_text_width(text);
+    if (text_width <= width) {
+        legacy_draw_text(fb, x, y, x, x + width, text);
+        return false;
+    }
+
+    /* The period is wider than the area: two repetitions cover it */
+    int period = text_width + TEXT_MARQUEE_GAP_PX;
+    int offset = (int)(scroll % (uint32_t)period);
+    legacy_draw_text(fb, x - offset, y, x, x + width, text);
+    legacy_draw_text(fb, x - offset + period, y, x, x + width, text);
+    return true;
+}
+
+static int bench_text_width(const char *text)
+{
+    return s_legacy ? legacy_text_width(text) : text_width(text);
+}
+
+static bool bench_text_draw(framebuffer_t *fb, int x, int y, int width, const char *text, uint32_t scroll)
+{
+    return s_legacy ? legacy_text_draw(fb, x, y, width, text, scroll) : text_draw(fb, x, y, width, text, scroll);
+}
+
+/* display.c draws its text through the functions above */
+#define text_width bench_text_width
+#define text_draw bench_text_draw
+#include "display_harness.h"
+
+typedef struct {
+    const char *name;
+    /* Request, time and time on screen of frame i */
+    const display_request_t *(*frame)(uint32_t i, int64_t *now_us, uint32_t *shown_ms);
+} scenario_t;
+
+static display_request_t s_messages[BENCH_MESSAGES];
+static display_request_t s_static_text;
+static display_request_t s_marquee_text;
+static display_request_t s_now_playing;
+
+/* A new message every frame: one new string, two cached ones */
+static const display_request_t *frame_new_message(uint32_t i, int64_t *now_us, uint32_t *shown_ms)
+{
+    *now_us = 0;
+    *shown_ms = 0;
+    return &s_messages[i % BENCH_MESSAGES];
+}
+
+/* The same screen again, e.g. after a redundant request */
+static const display_request_t *frame_redraw(uint32_t i, int64_t *now_us, uint32_t *shown_ms)
+{
+    (void)i;
+    *now_us = 0;
+    *shown_ms = 0;
+    return &s_static_text;
+}
+
+static const display_request_t *frame_marquee_step(uint32_t i, int64_t *now_us, uint32_t *shown_ms)
+{
+    *shown_ms = DISPLAY_MARQUEE_HOLD_MS + i * DISPLAY_MARQUEE_STEP_MS;
+    *now_us = (int64_t)*shown_ms * 1000;
+    return &s_marquee_text;
+}
+
+/* Scrolling title, cover, clock and progress bar */
+static const display_request_t *frame_now_playing(uint32_t i, int64_t *now_us, uint32_t *shown_ms)
+{
+    *shown_ms = DISPLAY_MARQUEE_HOLD_MS + i * DISPLAY_MARQUEE_STEP_MS;
+    *now_us = (int64_t)*shown_ms * 1000;
+    return &s_now_playing;
+}
+
+static const scenario_t SCENARIOS[] = {
+    { "new message", frame_new_message },
+    { "redraw", frame_redraw },
+    { "marquee step", frame_marquee_step },
+    { "now playing", frame_now_playing },
+};
+
+static void build_requests(void)
+{
+    for (int i = 0; i < BENCH_MESSAGES; i++) {
+        char line[DISPLAY_LINE_MAX];
+        snprintf(line, sizeof(line), "Karte %03d erkannt", i);
+        s_messages[i] = display_harness_text(line, "Spielt gerade");
+    }
+    s_static_text = display_harness_text("Karte erkannt", "Spielt gerade");
+    s_marquee_text = display_harness_text("Unbekannte Karte: 04 A2 19 6B 3C 81 90", "Bitte zuordnen");
+    s_now_playing = display_harness_now_playing("Der kleine Drache Kokosnuss - Folge 12", true, 30.0f,
+                                                3600.0f, true);
+}
+
+/* Both text paths must draw the same frames, or the comparison is void */
+static bool frames_match(const scenario_t *scenario)
+{
+    for (uint32_t i = 0; i < BENCH_CHECK_FRAMES; i++) {
+        int64_t now_us;
+        uint32_t shown_ms;
+        const display_request_t *req = scenario->frame(i, &now_us, &shown_ms);
+
+        s_legacy = true;
+        render(&s_display, req, now_us, shown_ms);
+        framebuffer_t legacy = s_display.next;
+        s_legacy = false;
+        render(&s_display, req, now_us, shown_ms);
+        if (memcmp(&legacy, &s_display.next, sizeof(legacy)) != 0) {
+            fprintf(stderr, "%s: frame %lu differs between the text paths\n", scenario->name, (unsigned long)i);
+            return false;
+        }
+    }
+    return true;
+}
+
+static double render_us(const scenario_t *scenario, bool legacy)
+{
+    int64_t best_us = INT64_MAX;
+
+    s_legacy = legacy;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        int64_t start_us = esp_timer_get_time();
+        for (uint32_t i = 0; i < BENCH_FRAMES; i++) {
+            int64_t now_us;
+            uint32_t shown_ms;
+            const display_request_t *req = scenario->frame(i, &now_us, &shown_ms);
+            render(&s_display, req, now_us, shown_ms);
+        }
+        int64_t elapsed_us = esp_timer_get_time() - start_us;
+        if (elapsed_us < best_us) {
+            best_us = elapsed_us;
+        }
+    }
+    s_legacy = false;
+    return (double)best_us / BENCH_FRAMES;
+}
+
+/* Diff and queue cost and bytes per frame, in steady state after the first frame */
+static void flush_cost(const scenario_t *scenario, double *flush_us, double *bytes)
+{
+    uint64_t total_bytes = 0;
+    int64_t flush_total_us = 0;
+
+    display_harness_reset();
+    display_harness_frame(scenario->frame(0, &(int64_t){ 0 }, &(uint32_t){ 0 }), 0, 0, NULL);
+    for (uint32_t i = 1; i <= BENCH_FRAMES; i++) {
+        int64_t now_us;
+        uint32_t shown_ms;
+        const display_request_t *req = scenario->frame(i, &now_us, &shown_ms);
+        render(&s_display, req, now_us, shown_ms);
+        int64_t start_us = esp_timer_get_time();
+        total_bytes += flush(&s_display);
+        flush_total_us += esp_timer_get_time() - start_us;
+        ssd1306_spi_wait(&s_display.panel);     /* The fake panel copies the data here */
+    }
+    *flush_us = (double)flush_total_us / BENCH_FRAMES;
+    *bytes = (double)total_bytes / BENCH_FRAMES;
+}
+
+int main(void)
+{
+    build_requests();
+    display_harness_reset();
+
+    printf("%d frames per scenario, render time of the best of %d rounds; "
+           "render = render(), flush = fb_diff() and queueing\n", BENCH_FRAMES, BENCH_ROUNDS);
+    printf("%-14s %11s %11s %8s %9s %9s %11s %8s\n", "scenario", "cached us", "per-char us", "speedup",
+           "hit rate", "flush us", "bytes/frame", "SPI us");
+
+    for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); i++) {
+        const scenario_t *scenario = &SCENARIOS[i];
+        if (!frames_match(scenario)) {
+            return 1;
+        }
+
+        text_metrics_t before;
+        text_metrics_t after;
+        text_get_metrics(&before);
+        double cached_us = render_us(scenario, false);
+        text_get_metrics(&after);
+        double legacy_us = render_us(scenario, true);
+
+        double flush_us;
+        double bytes;
+        flush_cost(scenario, &flush_us, &bytes);
+
+        uint32_t lookups = after.lookups - before.lookups;
+        double hit_rate = lookups > 0 ? 100.0 * (after.hits - before.hits) / lookups : 0.0;
+        double spi_us = bytes * 8.0 * 1e6 / BOARD_OLED_SPI_FREQ_HZ;
+        printf("%-14s %11.3f %11.3f %7.1fx %8.1f%% %9.3f %11.1f %8.0f\n", scenario->name, cached_us, legacy_us,
+               legacy_us / cached_us, hit_rate, flush_us, bytes, spi_us);
+    }
+    return 0;
+}
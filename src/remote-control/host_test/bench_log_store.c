@@ -0,0 +1,81 @@
+/*
+ * Write and recovery benchmark of storage/log_store.c on fake_partition.c,
+ * with the partition size of partitions.csv.
+ *
+ * Host times measure the store's own CPU work only; the flash work per
+ * update (bytes programmed, erases) is what the device pays on top.
+ */
+
+#include <stdio.h>
+
+#include "log_store_harness.h"
+
+#define BENCH_PARTITION_SIZE    0x20000     /* logstore in partitions.csv */
+#define BENCH_KEYS              8           /* Resume positions of recent cards, playtime */
+#define BENCH_UPDATES           200000
+#define BENCH_UPDATES_PER_FLUSH 4           /* Changes collected in one LOG_STORE_FLUSH_DELAY_MS window */
+#define BENCH_REBOOTS           200
+
+int main(void)
+{
+    fake_partition_reset(BENCH_PARTITION_SIZE);
+    if (log_store_reboot() != ESP_OK) {
+        fprintf(stderr, "mount failed\n");
+        return 1;
+    }
+
+    /* Writes */
+    uint64_t payload_bytes = 0;
+    uint32_t max_flush_us = 0;
+    int64_t start_us = esp_timer_get_time();
+    for (uint32_t i = 0; i < BENCH_UPDATES; i++) {
+        char key[LOG_STORE_KEY_MAX];
+        snprintf(key, sizeof(key), "resume_%02lu", (unsigned long)(i % BENCH_KEYS));
+        float position = (float)i * 0.5f;
+        if (log_store_set(key, &position, sizeof(position)) != ESP_OK) {
+            fprintf(stderr, "set failed\n");
+            return 1;
+        }
+        payload_bytes += sizeof(position);
+        if ((i + 1) % BENCH_UPDATES_PER_FLUSH == 0) {
+            if (log_store_flush() != ESP_OK) {
+                fprintf(stderr, "flush failed\n");
+                return 1;
+            }
+            max_flush_us = s_metrics.last_flush_us > max_flush_us ? s_metrics.last_flush_us : max_flush_us;
+        }
+    }
+    int64_t write_us = esp_timer_get_time() - start_us;
+
+    log_store_metrics_t metrics;
+    log_store_get_metrics(&metrics);
+    fake_partition_stats_t flash;
+    fake_partition_get_stats(&flash);
+    printf("writes: %d updates in %d-update batches, %.0f updates/s on the host "
+           "(%.2f us per update, flush max %lu us)\n",
+           BENCH_UPDATES, BENCH_UPDATES_PER_FLUSH, BENCH_UPDATES * 1e6 / (double)write_us,
+           (double)write_us / BENCH_UPDATES, (unsigned long)max_flush_us);
+    printf("flash per update: %.1f bytes programmed (%.1fx the payload), %.3f erases; "
+           "%lu erases over %lu sectors in total, %lu compactions\n",
+           (double)flash.bytes_written / BENCH_UPDATES, (double)flash.bytes_written / (double)payload_bytes,
+           (double)flash.erases / BENCH_UPDATES, (unsigned long)flash.erases,
+           (unsigned long)metrics.sectors, (unsigned long)metrics.compactions);
+
+    /* Recovery of the partition as the writes left it */
+    uint64_t recovery_us = 0;
+    uint32_t max_recovery_us = 0;
+    for (int i = 0; i < BENCH_REBOOTS; i++) {
+        if (log_store_reboot() != ESP_OK) {
+            fprintf(stderr, "mount failed\n");
+            return 1;
+        }
+        recovery_us += s_metrics.recovery_us;
+        max_recovery_us = s_metrics.recovery_us > max_recovery_us ? s_metrics.recovery_us : max_recovery_us;
+    }
+    log_store_get_metrics(&metrics);
+    printf("recovery: %lu records from %lu/%lu sectors (%lu bytes read) in avg %.1f us, max %lu us on the host\n",
+           (unsigned long)metrics.records_recovered, (unsigned long)metrics.sectors_used,
+           (unsigned long)metrics.sectors, (unsigned long)metrics.sectors_used * SECTOR_SIZE,
+           (double)recovery_us / BENCH_REBOOTS, (unsigned long)max_recovery_us);
+    return 0;
+}
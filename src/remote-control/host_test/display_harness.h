@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * display.c is compiled into the test itself, so its render() and flush()
+ * can be driven frame by frame without the display task, against
+ * fake_panel.c instead of the SPI driver.
+ */
+#include "display/display.c"
+#include "fake_panel.h"
+
+static display_t s_display;
+
+/** Fresh display and panel, as after a reset: the first frame is sent in full */
+static void display_harness_reset(void)
+{
+    memset(&s_display, 0, sizeof(s_display));
+    fake_panel_reset();
+}
+
+/**
+ * One pass of the display task: draw req as it looks shown_ms after it
+ * appeared, send the changes and wait until the panel has them.
+ *
+ * @param refresh_ms If not NULL, the delay until the screen needs redrawing
+ * @return SPI bytes sent, as counted by flush()
+ */
+static uint32_t display_harness_frame(const display_request_t *req, int64_t now_us, uint32_t shown_ms,
+                                      uint32_t *refresh_ms)
+{
+    uint32_t refresh = render(&s_display, req, now_us, shown_ms);
+    uint32_t bytes = flush(&s_display);
+    ssd1306_spi_wait(&s_display.panel);
+    if (refresh_ms) {
+        *refresh_ms = refresh;
+    }
+    return bytes;
+}
+
+static display_request_t display_harness_text(const char *line1, const char *line2)
+{
+    display_request_t req = { .type = DISPLAY_REQ_TEXT };
+    text_copy(req.text.line1, sizeof(req.text.line1), line1);
+    text_copy(req.text.line2, sizeof(req.text.line2), line2);
+    return req;
+}
+
+/** Now-playing screen anchored at time 0, with a checkered cover if has_cover */
+static display_request_t display_harness_now_playing(const char *title, bool playing, float position,
+                                                     float duration, bool has_cover)
+{
+    display_request_t req = { .type = DISPLAY_REQ_NOW_PLAYING };
+    display_now_playing_t *np = &req.now_playing;
+
+    text_copy(np->title, sizeof(np->title), title);
+    np->playing = playing;
+    np->volume = 40;
+    np->position = position;
+    np->duration = duration;
+    np->anchor_us = 0;
+    np->has_cover = has_cover;
+    for (int i = 0; has_cover && i < DISPLAY_COVER_BYTES; i++) {
+        np->cover[i] = (i / 4) % 2 ? 0x0F : 0xF0;
+    }
+    return req;
+}
@@ -0,0 +1,124 @@
+#include "fake_panel.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "display/ssd1306_spi.h"
+
+/* Address command in front of every page range, as in the driver */
+#define ADDRESS_BYTES 3
+
+/* Each write is an address command and a data transaction */
+#define MAX_QUEUED (SSD1306_SPI_QUEUE_SIZE / 2)
+
+#define PBM_MAX_SCALE 8
+
+typedef struct {
+    int page;
+    int column;
+    const uint8_t *data;
+    size_t len;
+} queued_write_t;
+
+static framebuffer_t s_ram;
+static queued_write_t s_queue[MAX_QUEUED];
+static int s_queued = 0;
+static int s_fail_writes = 0;
+static fake_panel_stats_t s_stats;
+
+static void drain(void)
+{
+    for (int i = 0; i < s_queued; i++) {
+        memcpy(&s_ram.pages[s_queue[i].page][s_queue[i].column], s_queue[i].data, s_queue[i].len);
+    }
+    s_queued = 0;
+}
+
+void fake_panel_reset(void)
+{
+    for (int page = 0; page < FB_PAGES; page++) {
+        for (int x = 0; x < FB_WIDTH; x++) {
+            s_ram.pages[page][x] = (uint8_t)((x * 37 + page * 101) ^ 0xA5);
+        }
+    }
+    s_queued = 0;
+    s_fail_writes = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+void fake_panel_fail_writes(int count)
+{
+    s_fail_writes = count;
+}
+
+const framebuffer_t *fake_panel_ram(void)
+{
+    return &s_ram;
+}
+
+void fake_panel_take_stats(fake_panel_stats_t *stats)
+{
+    *stats = s_stats;
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+bool fake_panel_write_pbm(const char *path, int scale)
+{
+    if (scale < 1 || scale > PBM_MAX_SCALE) {
+        return false;
+    }
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    int width = FB_WIDTH * scale;
+    fprintf(file, "P4\n%d %d\n", width, FB_HEIGHT * scale);
+    for (int y = 0; y < FB_HEIGHT * scale; y++) {
+        int row = y / scale;
+        uint8_t line[FB_WIDTH * PBM_MAX_SCALE / 8] = { 0 };
+        for (int x = 0; x < width; x++) {
+            if (s_ram.pages[row >> 3][x / scale] & (1u << (row & 7))) {
+                line[x >> 3] |= (uint8_t)(0x80u >> (x & 7));
+            }
+        }
+        fwrite(line, 1, (size_t)(width + 7) / 8, file);
+    }
+    return fclose(file) == 0;
+}
+
+esp_err_t ssd1306_spi_init(ssd1306_spi_t *panel, const ssd1306_spi_config_t *config)
+{
+    (void)config;
+    memset(panel, 0, sizeof(*panel));
+    return ESP_OK;
+}
+
+esp_err_t ssd1306_spi_write(ssd1306_spi_t *panel, int page, int column, const uint8_t *data, size_t len)
+{
+    (void)panel;
+    if (page < 0 || page >= FB_PAGES || column < 0 || len == 0 || column + len > FB_WIDTH) {
+        s_stats.bad_writes++;
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_fail_writes > 0) {
+        s_fail_writes--;
+        return ESP_FAIL;
+    }
+    if (s_queued == MAX_QUEUED) {
+        drain();
+    }
+
+    s_queue[s_queued++] = (queued_write_t){ .page = page, .column = column, .data = data, .len = len };
+    s_stats.writes++;
+    s_stats.bytes += ADDRESS_BYTES + len;
+    s_stats.page_mask |= (uint8_t)(1u << page);
+    return ESP_OK;
+}
+
+esp_err_t ssd1306_spi_wait(ssd1306_spi_t *panel)
+{
+    (void)panel;
+    drain();
+    return ESP_OK;
+}
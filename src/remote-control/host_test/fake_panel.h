@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "display/framebuffer.h"
+
+/**
+ * @file fake_panel.h
+ * @brief RAM-backed SSD1306 behind the ssd1306_spi.h interface
+ *
+ * ssd1306_spi_write() only queues a write, like the DMA driver; the column
+ * bytes are read from the caller's buffer when the queue is full or at
+ * ssd1306_spi_wait(). A frame that changes a buffer it has queued therefore
+ * shows up wrong on the fake panel, as it would on the real one.
+ *
+ * The panel RAM starts out as a noise pattern, so anything the first frame
+ * fails to send stands out.
+ */
+
+typedef struct {
+    uint32_t writes;            /* Page ranges sent */
+    uint32_t bytes;             /* Address command and column bytes */
+    uint8_t page_mask;          /* Bit n: page n was written */
+    uint32_t bad_writes;        /* Rejected: range outside the panel */
+} fake_panel_stats_t;
+
+/** Power-on state: noise in the panel RAM, nothing queued, counters cleared */
+void fake_panel_reset(void);
+
+/** Let the next count writes fail with ESP_FAIL */
+void fake_panel_fail_writes(int count);
+
+/** Panel RAM, in framebuffer layout; complete after ssd1306_spi_wait() */
+const framebuffer_t *fake_panel_ram(void);
+
+/** Copy the counters and clear them */
+void fake_panel_take_stats(fake_panel_stats_t *stats);
+
+/** Save the panel RAM as a binary PBM image, scale x scale pixels per pixel (1..8) */
+bool fake_panel_write_pbm(const char *path, int scale);
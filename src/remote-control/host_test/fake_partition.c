@@ -0,0 +1,160 @@
+#include "fake_partition.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_partition.h"
+
+#define WORD_SIZE 4
+
+static esp_partition_t s_partition;
+static uint8_t *s_data = NULL;
+static int64_t s_units_left = -1;      /* Negative: no cut armed */
+static fake_cut_mode_t s_cut_mode = FAKE_CUT_CLEAN;
+static bool s_powered_off = false;
+static fake_partition_stats_t s_stats;
+
+void fake_partition_reset(size_t size)
+{
+    free(s_data);
+    s_data = malloc(size);
+    memset(s_data, 0xFF, size);
+    memset(&s_partition, 0, sizeof(s_partition));
+    s_partition.type = ESP_PARTITION_TYPE_DATA;
+    s_partition.size = size;
+    s_partition.erase_size = FAKE_PARTITION_SECTOR_SIZE;
+    strcpy(s_partition.label, "fake");
+    s_units_left = -1;
+    s_powered_off = false;
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+void fake_partition_cut_after(int64_t units, fake_cut_mode_t mode)
+{
+    s_units_left = units;
+    s_cut_mode = mode;
+}
+
+bool fake_partition_powered_off(void)
+{
+    return s_powered_off;
+}
+
+void fake_partition_power_on(void)
+{
+    s_powered_off = false;
+    s_units_left = -1;
+    s_stats.cut_op = FAKE_OP_NONE;
+}
+
+uint8_t *fake_partition_data(void)
+{
+    return s_data;
+}
+
+void fake_partition_get_stats(fake_partition_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+typedef enum {
+    UNIT_DONE,
+    UNIT_CUT,       /* Power lost during this unit */
+    UNIT_NO_POWER,
+} unit_result_t;
+
+static unit_result_t take_unit(void)
+{
+    if (s_powered_off) {
+        return UNIT_NO_POWER;
+    }
+    if (s_units_left == 0) {
+        s_powered_off = true;
+        return UNIT_CUT;
+    }
+    if (s_units_left > 0) {
+        s_units_left--;
+    }
+    s_stats.units++;
+    return UNIT_DONE;
+}
+
+static void program(size_t offset, const uint8_t *src, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        s_data[offset + i] &= src[i];
+    }
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    (void)type;
+    (void)subtype;
+    (void)label;
+    return s_data ? &s_partition : NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (partition != &s_partition || src_offset + size > s_partition.size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_powered_off) {
+        return ESP_FAIL;
+    }
+    memcpy(dst, s_data + src_offset, size);
+    s_stats.reads++;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    if (partition != &s_partition || dst_offset + size > s_partition.size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const uint8_t *bytes = src;
+    for (size_t done = 0; done < size; done += WORD_SIZE) {
+        size_t len = size - done < WORD_SIZE ? size - done : WORD_SIZE;
+        unit_result_t result = take_unit();
+        if (result != UNIT_DONE) {
+            if (result == UNIT_CUT) {
+                s_stats.cut_op = FAKE_OP_WRITE;
+                s_stats.cut_offset = dst_offset + done;
+            }
+            if (result == UNIT_CUT && s_cut_mode == FAKE_CUT_TORN) {
+                program(dst_offset + done, bytes + done, len > 1 ? len / 2 : 1);
+            }
+            return ESP_FAIL;
+        }
+        program(dst_offset + done, bytes + done, len);
+    }
+    s_stats.writes++;
+    s_stats.bytes_written += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (partition != &s_partition || offset + size > s_partition.size ||
+        offset % FAKE_PARTITION_SECTOR_SIZE != 0 || size % FAKE_PARTITION_SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t done = 0; done < size; done += FAKE_PARTITION_SECTOR_SIZE) {
+        unit_result_t result = take_unit();
+        if (result != UNIT_DONE) {
+            if (result == UNIT_CUT) {
+                s_stats.cut_op = FAKE_OP_ERASE;
+                s_stats.cut_offset = offset + done;
+            }
+            if (result == UNIT_CUT && s_cut_mode == FAKE_CUT_TORN) {
+                memset(s_data + offset + done + FAKE_PARTITION_SECTOR_SIZE / 2, 0xFF,
+                       FAKE_PARTITION_SECTOR_SIZE / 2);
+            }
+            return ESP_FAIL;
+        }
+        memset(s_data + offset + done, 0xFF, FAKE_PARTITION_SECTOR_SIZE);
+        s_stats.erases++;
+    }
+    return ESP_OK;
+}
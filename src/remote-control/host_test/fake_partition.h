@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file fake_partition.h
+ * @brief RAM-backed NOR flash partition with power-loss injection
+ *
+ * Serves esp_partition_find_first() for any label. Like NOR flash, a write
+ * can only clear bits (the result is old AND new) and an erase sets a whole
+ * 4 KB sector back to 0xFF.
+ *
+ * Flash work is counted in units: one per 4-byte word programmed and one per
+ * sector erased. After fake_partition_cut_after(n) the partition loses power
+ * once n units are done; the operation in progress fails with ESP_FAIL and
+ * so does every later one until fake_partition_power_on().
+ */
+
+#define FAKE_PARTITION_SECTOR_SIZE 4096
+
+typedef enum {
+    /* The interrupted operation leaves no trace */
+    FAKE_CUT_CLEAN,
+    /* The interrupted word is half programmed; an interrupted erase only
+       clears the second half of the sector */
+    FAKE_CUT_TORN,
+} fake_cut_mode_t;
+
+typedef enum {
+    FAKE_OP_NONE,
+    FAKE_OP_WRITE,
+    FAKE_OP_ERASE,
+} fake_op_t;
+
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t bytes_written;
+    uint32_t erases;
+    uint64_t units;             /* Since fake_partition_reset() */
+    fake_op_t cut_op;           /* Operation the power was lost in */
+    size_t cut_offset;          /* and where */
+} fake_partition_stats_t;
+
+/** Fresh, fully erased partition of size bytes, powered, no cut armed */
+void fake_partition_reset(size_t size);
+
+/** Lose power after units more units of flash work; negative disarms */
+void fake_partition_cut_after(int64_t units, fake_cut_mode_t mode);
+
+bool fake_partition_powered_off(void);
+
+/** Restore power; flash contents stay as the cut left them */
+void fake_partition_power_on(void);
+
+uint8_t *fake_partition_data(void);
+
+void fake_partition_get_stats(fake_partition_stats_t *stats);
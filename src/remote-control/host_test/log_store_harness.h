@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+ * log_store.c is compiled into the test itself, so a simulated reboot can
+ * reset its static state the way a real one does.
+ */
+#include "storage/log_store.c"
+#include "fake_partition.h"
+
+/** Forget all RAM state, as after a reset */
+static void log_store_reset_state(void)
+{
+    s_partition = NULL;
+    s_lock = NULL;
+    s_flush_timer = NULL;
+    s_flush_task = NULL;
+    memset(s_entries, 0, sizeof(s_entries));
+    memset(s_sector_seq, 0, sizeof(s_sector_seq));
+    s_sector_count = 0;
+    s_head = 0;
+    s_head_offset = SECTOR_SIZE;
+    s_next_seq = 1;
+    memset(&s_metrics, 0, sizeof(s_metrics));
+}
+
+/** Power loss and reboot: restore power, forget all RAM state, mount again */
+static esp_err_t log_store_reboot(void)
+{
+    fake_partition_power_on();
+    log_store_reset_state();
+    return log_store_init();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+/* Host build: just the SPI types the display driver interface uses */
+
+#include <stddef.h>
+
+#include "esp_err.h"
+
+typedef enum {
+    SPI1_HOST,
+    SPI2_HOST,
+    SPI3_HOST,
+} spi_host_device_t;
+
+#define SPI_DMA_CH_AUTO 3
+
+typedef struct spi_device_t *spi_device_handle_t;
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+} spi_bus_config_t;
+
+typedef struct {
+    size_t length;
+    const void *tx_buffer;
+    void *user;
+} spi_transaction_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *config, int dma_chan);
@@ -0,0 +1,20 @@
+#pragma once
+
+/* Host build: logging goes to stderr, and only when host_log_enabled is set */
+
+#include <stdio.h>
+
+extern int host_log_enabled;
+
+#define HOST_LOG(level, tag, format, ...) \
+    do { \
+        if (host_log_enabled) { \
+            fprintf(stderr, level " (%s) " format "\n", tag, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG("D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG("V", tag, format, ##__VA_ARGS__)
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Same result as the ROM function: zlib-style CRC-32, continued from crc */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
@@ -0,0 +1,432 @@
+/*
+ * Host tests of the display pipeline: framebuffer.c, text.c and the real
+ * render()/flush() of display.c on fake_panel.c.
+ *
+ * Every frame is checked against the panel RAM the queued writes produced
+ * and saved as a PBM image (frames/, or the directory given as argument),
+ * so the screens can be looked at without hardware. For each kind of update
+ * the SPI bytes and the pages written are printed and checked: a clock tick
+ * or a marquee step must only send the pages it changes.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "display_harness.h"
+#include "display/font.h"
+
+/* A full frame: every page with its address command */
+#define FULL_FRAME_BYTES (FB_PAGES * (PAGE_ADDRESS_BYTES + FB_WIDTH))
+
+#define PAGE(n) (1u << (n))
+
+static int s_failures = 0;
+static const char *s_frames_dir = "frames";
+static int s_frame_count = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            s_failures++; \
+            return false; \
+        } \
+    } while (0)
+
+static bool fb_equal(const framebuffer_t *a, const framebuffer_t *b)
+{
+    return memcmp(a->pages, b->pages, sizeof(a->pages)) == 0;
+}
+
+static bool fb_is_clear(const framebuffer_t *fb)
+{
+    static const framebuffer_t clear;
+    return fb_equal(fb, &clear);
+}
+
+/* ---- framebuffer.c ---- */
+
+static bool test_blit(void)
+{
+    static const uint8_t full[] = { 0xFF, 0xFF, 0xFF, 0xFF };
+    static const uint8_t ramp[] = { 0x01, 0x02, 0x04, 0x08 };
+    framebuffer_t fb;
+
+    /* Straddling two pages */
+    fb_clear(&fb);
+    fb_blit(&fb, 10, 3, full, 1);
+    CHECK(fb.pages[0][10] == 0xF8 && fb.pages[1][10] == 0x07, "0x%02X 0x%02X", fb.pages[0][10], fb.pages[1][10]);
+
+    /* Left and right edges: only the visible columns, from the right offset */
+    fb_clear(&fb);
+    fb_blit(&fb, -2, 0, ramp, 4);
+    CHECK(fb.pages[0][0] == 0x04 && fb.pages[0][1] == 0x08 && fb.pages[0][2] == 0, "left edge");
+    fb_blit(&fb, FB_WIDTH - 2, 8, ramp, 4);
+    CHECK(fb.pages[1][FB_WIDTH - 2] == 0x01 && fb.pages[1][FB_WIDTH - 1] == 0x02, "right edge");
+
+    /* Top and bottom edges: the rows outside are dropped */
+    fb_clear(&fb);
+    fb_blit(&fb, 0, -3, full, 1);
+    fb_blit(&fb, 1, FB_HEIGHT - 4, full, 1);
+    CHECK(fb.pages[0][0] == 0x1F, "top edge 0x%02X", fb.pages[0][0]);
+    CHECK(fb.pages[FB_PAGES - 1][1] == 0xF0, "bottom edge 0x%02X", fb.pages[FB_PAGES - 1][1]);
+
+    /* Entirely outside */
+    fb_clear(&fb);
+    fb_blit(&fb, 0, -8, full, 4);
+    fb_blit(&fb, 0, FB_HEIGHT, full, 4);
+    fb_blit(&fb, -4, 0, full, 4);
+    fb_blit(&fb, FB_WIDTH, 0, full, 4);
+    CHECK(fb_is_clear(&fb), "nothing drawn");
+
+    /* Blits OR into what is there */
+    fb_blit(&fb, 5, 0, ramp, 1);
+    fb_blit(&fb, 5, 1, ramp, 1);
+    CHECK(fb.pages[0][5] == 0x03, "0x%02X", fb.pages[0][5]);
+
+    printf("blit: clipping and page straddling ok\n");
+    return true;
+}
+
+static bool test_diff(void)
+{
+    framebuffer_t a;
+    framebuffer_t b;
+    fb_dirty_range_t ranges[FB_PAGES];
+
+    fb_clear(&a);
+    fb_clear(&b);
+    CHECK(fb_diff(&a, &b, ranges) == 0, "identical frames");
+    for (int page = 0; page < FB_PAGES; page++) {
+        CHECK(!ranges[page].dirty, "page %d", page);
+    }
+
+    b.pages[2][5] = 0x01;
+    b.pages[2][90] = 0x80;
+    b.pages[7][127] = 0x10;
+    uint32_t bytes = fb_diff(&a, &b, ranges);
+    CHECK(bytes == 86 + 1, "%lu bytes", (unsigned long)bytes);
+    CHECK(ranges[2].dirty && ranges[2].first == 5 && ranges[2].last == 90, "page 2 range");
+    CHECK(ranges[7].dirty && ranges[7].first == 127 && ranges[7].last == 127, "page 7 range");
+    for (int page = 0; page < FB_PAGES; page++) {
+        CHECK(ranges[page].dirty == (page == 2 || page == 7), "page %d", page);
+    }
+
+    printf("diff: per-page column ranges ok\n");
+    return true;
+}
+
+/* ---- text.c ---- */
+
+static bool glyph_at(const framebuffer_t *fb, int x, uint32_t codepoint)
+{
+    return memcmp(&fb->pages[0][x], font_glyph(codepoint), FONT_GLYPH_WIDTH) == 0;
+}
+
+static bool test_text(void)
+{
+    framebuffer_t fb;
+    char buf[8];
+
+    CHECK(text_width("") == 0, "empty");
+    CHECK(text_width("A") == FONT_GLYPH_WIDTH, "one glyph");
+    CHECK(text_width("AB") == FONT_ADVANCE + FONT_GLYPH_WIDTH, "two glyphs");
+
+    /* UTF-8: "ä" is one glyph, a broken sequence a '?' and the byte after it */
+    fb_clear(&fb);
+    CHECK(!text_draw(&fb, 0, 0, FB_WIDTH, "\xC3\xA4" "b", 0), "fits");
+    CHECK(glyph_at(&fb, 0, 0xE4) && glyph_at(&fb, FONT_ADVANCE, 'b'), "umlaut");
+    fb_clear(&fb);
+    text_draw(&fb, 0, 0, FB_WIDTH, "\xC3(", 0);
+    CHECK(glyph_at(&fb, 0, '?') && glyph_at(&fb, FONT_ADVANCE, '('), "malformed");
+
+    /* Cutting never splits a character */
+    text_copy(buf, 4, "a\xC3\xA4" "b");
+    CHECK(strcmp(buf, "a\xC3\xA4") == 0, "cut after the umlaut");
+    text_copy(buf, 3, "a\xC3\xA4" "b");
+    CHECK(strcmp(buf, "a") == 0, "cut before the umlaut");
+
+    /* Longer text is drawn as its first TEXT_KEY_MAX - 1 bytes */
+    char longest[TEXT_KEY_MAX + 16];
+    memset(longest, 'x', sizeof(longest) - 1);
+    longest[sizeof(longest) - 1] = '\0';
+    CHECK(text_width(longest) == (TEXT_KEY_MAX - 1) * FONT_ADVANCE - 1, "%d px", text_width(longest));
+
+    printf("text: width, UTF-8 and cutting ok\n");
+    return true;
+}
+
+static bool test_marquee(void)
+{
+    const char *title = "Benjamin Bl\xC3\xBC" "mchen und das gro\xC3\x9F" "e Zoofest";
+    int width = text_width(title);
+    int period = width + TEXT_MARQUEE_GAP_PX;
+    framebuffer_t start;
+    framebuffer_t a;
+    framebuffer_t b;
+
+    CHECK(width > FB_WIDTH, "title must be wider than the panel (%d px)", width);
+
+    /* Scroll 0 is the start of the text, as if it fitted */
+    fb_clear(&start);
+    CHECK(text_draw(&start, 0, 0, FB_WIDTH, title, 0), "scrolls");
+    CHECK(glyph_at(&start, 0, 'B'), "starts at the first character");
+
+    /* The marquee repeats after text and gap, at any offset */
+    for (uint32_t scroll = 0; scroll < (uint32_t)period; scroll += 7) {
+        fb_clear(&a);
+        fb_clear(&b);
+        text_draw(&a, 0, 0, FB_WIDTH, title, scroll);
+        text_draw(&b, 0, 0, FB_WIDTH, title, scroll + 3u * (uint32_t)period);
+        CHECK(fb_equal(&a, &b), "scroll %lu", (unsigned long)scroll);
+    }
+
+    /* Right at the end the gap shows, then the text starts again */
+    fb_clear(&a);
+    text_draw(&a, 0, 0, FB_WIDTH, title, (uint32_t)width);
+    for (int x = 0; x < TEXT_MARQUEE_GAP_PX; x++) {
+        CHECK(a.pages[0][x] == 0, "gap column %d", x);
+    }
+    CHECK(glyph_at(&a, TEXT_MARQUEE_GAP_PX, 'B'), "text again after the gap");
+
+    /* Text that fits ignores the scroll position */
+    fb_clear(&a);
+    fb_clear(&b);
+    CHECK(!text_draw(&a, 0, 0, FB_WIDTH, "Kurz", 0), "fits");
+    text_draw(&b, 0, 0, FB_WIDTH, "Kurz", 40);
+    CHECK(fb_equal(&a, &b), "no scrolling");
+
+    printf("marquee: period %d px, gap and wrap-around ok\n", period);
+    return true;
+}
+
+static bool test_cache(void)
+{
+    framebuffer_t fb;
+    text_metrics_t before;
+    text_metrics_t after;
+    char key[16];
+
+    fb_clear(&fb);
+    text_get_metrics(&before);
+    text_draw(&fb, 0, 0, FB_WIDTH, "cached line", 0);
+    text_draw(&fb, 0, 8, FB_WIDTH, "cached line", 0);
+    text_get_metrics(&after);
+    CHECK(after.lookups - before.lookups == 2 && after.hits - before.hits == 1, "second draw is a hit");
+
+    /* TEXT_CACHE_SIZE newer strings push out the least recently used one */
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        snprintf(key, sizeof(key), "line %d", i);
+        text_draw(&fb, 0, 16, FB_WIDTH, key, 0);
+    }
+    text_get_metrics(&before);
+    text_draw(&fb, 0, 0, FB_WIDTH, "cached line", 0);
+    text_get_metrics(&after);
+    CHECK(after.hits == before.hits, "evicted");
+
+    printf("cache: hits and LRU eviction ok\n");
+    return true;
+}
+
+/* ---- display.c render() and flush() ---- */
+
+/*
+ * Draw one frame, check that the panel shows exactly it and that flush()
+ * counted the bytes the panel received, save it and report the update.
+ */
+static bool frame(const char *name, const display_request_t *req, int64_t now_us, uint32_t shown_ms,
+                  uint32_t *bytes, uint8_t *pages, uint32_t *refresh_ms)
+{
+    fake_panel_stats_t stats;
+    char path[256];
+
+    fake_panel_take_stats(&stats);
+    *bytes = display_harness_frame(req, now_us, shown_ms, refresh_ms);
+    fake_panel_take_stats(&stats);
+    *pages = stats.page_mask;
+
+    CHECK(stats.bad_writes == 0, "%s: %lu writes outside the panel", name, (unsigned long)stats.bad_writes);
+    CHECK(stats.bytes == *bytes, "%s: flush() counted %lu bytes, the panel got %lu", name,
+          (unsigned long)*bytes, (unsigned long)stats.bytes);
+    CHECK(fb_equal(fake_panel_ram(), &s_display.next), "%s: panel differs from the frame", name);
+
+    snprintf(path, sizeof(path), "%s/%02d_%s.pbm", s_frames_dir, ++s_frame_count, name);
+    CHECK(fake_panel_write_pbm(path, 2), "cannot write %s", path);
+
+    printf("  %-22s %5lu bytes  pages", name, (unsigned long)*bytes);
+    for (int page = 0; page < FB_PAGES; page++) {
+        if (*pages & PAGE(page)) {
+            printf(" %d", page);
+        }
+    }
+    printf("\n");
+    return true;
+}
+
+static bool test_text_screen(void)
+{
+    display_request_t req = display_harness_text("Karte erkannt", "Die Maus");
+    uint32_t bytes;
+    uint32_t refresh_ms;
+    uint8_t pages;
+
+    printf("text screen updates:\n");
+    display_harness_reset();
+    if (!frame("text_first", &req, 0, 0, &bytes, &pages, &refresh_ms)) {
+        return false;
+    }
+    CHECK(bytes == FULL_FRAME_BYTES, "the first frame is sent in full, got %lu", (unsigned long)bytes);
+    CHECK(refresh_ms == 0, "static screen");
+
+    if (!frame("text_same", &req, 0, 0, &bytes, &pages, &refresh_ms)) {
+        return false;
+    }
+    CHECK(bytes == 0 && pages == 0, "unchanged frame sends nothing");
+
+    /* Line 2 is the 8 rows from y = 40: page 5 only */
+    req = display_harness_text("Karte erkannt", "Der kleine Drache");
+    if (!frame("text_line2", &req, 0, 0, &bytes, &pages, &refresh_ms)) {
+        return false;
+    }
+    CHECK(pages == PAGE(5), "pages 0x%02X", pages);
+    CHECK(bytes < PAGE_ADDRESS_BYTES + FB_WIDTH, "%lu bytes", (unsigned long)bytes);
+
+    /* Line 1 at y = 20 straddles pages 2 and 3 */
+    req = display_harness_text("Karte entfernt", "Der kleine Drache");
+    if (!frame("text_line1", &req, 0, 0, &bytes, &pages, &refresh_ms)) {
+        return false;
+    }
+    CHECK(pages == (PAGE(2) | PAGE(3)), "pages 0x%02X", pages);
+    return true;
+}
+
+static bool test_marquee_screen(void)
+{
+    display_request_t req = display_harness_text("Unbekannte Karte: 04 A2 19 6B 3C 81 90", "Bitte zuordnen");
+    uint32_t bytes;
+    uint32_t refresh_ms;
+    uint8_t pages;
+
+    printf("marquee updates:\n");
+    if (!frame("marquee_start", &req, 0, 0, &bytes, &pages, &refresh_ms)) {
+        return false;
+    }
+    CHECK(refresh_ms == DISPLAY_MARQUEE_HOLD_MS, "holds the start, refresh in %lu ms", (unsigned long)refresh_ms);
+
+    /* The hold ends without moving: nothing to send */
+    if (!frame("marquee_hold", &req, 0, DISPLAY_MARQUEE_HOLD_MS, &bytes, &pages, &refresh_ms)) {
+        return false;
+    }
+    CHECK(bytes == 0, "%lu bytes", (unsigned long)bytes);
+    CHECK(refresh_ms == DISPLAY_MARQUEE_STEP_MS, "%lu ms", (unsigned long)refresh_ms);
+
+    uint32_t total = 0;
+    for (int step = 1; step <= 10; step++) {
+        uint32_t shown_ms = DISPLAY_MARQUEE_HOLD_MS + (uint32_t)step * DISPLAY_MARQUEE_STEP_MS;
+        char name[32];
+        snprintf(name, sizeof(name), "marquee_step%d", step);
+        if (!frame(name, &req, 0, shown_ms, &bytes, &pages, &refresh_ms)) {
+            return false;
+        }
+        CHECK(pages == (PAGE(2) | PAGE(3)), "step %d: only the scrolling line, pages 0x%02X", step, pages);
+        total += bytes;
+    }
+    printf("  marquee: %lu bytes per step on average\n", (unsigned long)(total / 10));
+    return true;
+}
+
+static bool test_now_playing_screen(void)
+{
+    display_request_t req = display_harness_now_playing("Die Maus", true, 30.0f, 200.0f, true);
+    uint32_t bytes;
+    uint32_t refresh_ms;
+    uint8_t pages;
+
+    printf("now-playing updates:\n");
+    if (!frame("playing_first", &req, 0, 0, &bytes, &pages, &refresh_ms)) {
+        return false;
+    }
+    CHECK(refresh_ms == 1000, "next second in %lu ms", (unsigned long)refresh_ms);
+
+    /* A clock tick: time (page 5) and progress bar (page 7) */
+    uint32_t total = 0;
+    for (int second = 1; second <= 10; second++) {
+        char name[32];
+        snprintf(name, sizeof(name), "playing_tick%d", second);
+        if (!frame(name, &req, (int64_t)second * 1000000, (uint32_t)second * 1000, &bytes, &pages,
+                   &refresh_ms)) {
+            return false;
+        }
+        CHECK((pages & PAGE(5)) && (pages & ~(PAGE(5) | PAGE(7))) == 0, "second %d: pages 0x%02X", second, pages);
+        total += bytes;
+    }
+    printf("  clock tick: %lu bytes per second on average\n", (unsigned long)(total / 10));
+
+    /* Pausing only changes the status row */
+    req = display_harness_now_playing("Die Maus", false, 40.0f, 200.0f, true);
+    if (!frame("paused", &req, 10 * 1000000, 0, &bytes, &pages, &refresh_ms)) {
+        return false;
+    }
+    CHECK(pages == PAGE(0), "pages 0x%02X", pages);
+    CHECK(refresh_ms == 0, "nothing moves while paused");
+
+    /* Without a cover the text moves left: the cover and text pages change */
+    req = display_harness_now_playing("Die Maus", false, 40.0f, 200.0f, false);
+    if (!frame("no_cover", &req, 10 * 1000000, 0, &bytes, &pages, &refresh_ms)) {
+        return false;
+    }
+    CHECK((pages & (PAGE(0) | PAGE(1) | PAGE(7))) == 0, "pages 0x%02X", pages);
+    return true;
+}
+
+static bool test_write_failure(void)
+{
+    display_request_t req = display_harness_text("Fehler", "beim Senden");
+    uint32_t bytes;
+    uint32_t refresh_ms;
+    uint8_t pages;
+
+    printf("failed write:\n");
+    fake_panel_fail_writes(1);
+    display_harness_frame(&req, 0, 0, NULL);
+    CHECK(!s_display.shown_valid, "a failed write invalidates the shadow buffer");
+
+    /* The frame after it resends everything, so the panel is right again */
+    if (!frame("after_failure", &req, 0, 0, &bytes, &pages, &refresh_ms)) {
+        return false;
+    }
+    CHECK(bytes == FULL_FRAME_BYTES, "%lu bytes", (unsigned long)bytes);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        s_frames_dir = argv[1];
+    }
+    if (mkdir(s_frames_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "cannot create %s\n", s_frames_dir);
+        return 1;
+    }
+
+    test_blit();
+    test_diff();
+    test_text();
+    test_marquee();
+    test_cache();
+    test_text_screen();
+    test_marquee_screen();
+    test_now_playing_screen();
+    test_write_failure();
+
+    if (s_failures) {
+        fprintf(stderr, "%d failure(s)\n", s_failures);
+        return 1;
+    }
+    printf("all display render tests passed, %d frames in %s/\n", s_frame_count, s_frames_dir);
+    return 0;
+}
@@ -0,0 +1,365 @@
+/*
+ * Power-loss tests of storage/log_store.c on fake_partition.c.
+ *
+ * A fixed workload of sets, erases and batched flushes runs until the
+ * partition loses power after n units of flash work, for every n the
+ * workload needs, once with clean and once with torn cuts. After each cut
+ * the store is mounted again; every key must read as its last flushed value,
+ * or as its new value if the interrupted flush was writing it. The store
+ * must then keep working: values written after the cut, including through
+ * compactions over the damaged sectors, survive the next reboot.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "log_store_harness.h"
+
+#define TEST_SECTORS        MIN_SECTORS
+#define TEST_KEYS           24
+#define TEST_BATCHES        160     /* Fills the partition about one and a half times */
+#define TEST_BATCH_CHANGES  8
+#define HEAVY_CHECK_EVERY   64      /* Cuts between full wrap-arounds after recovery */
+#define WRAP_ROUNDS         60      /* Rounds of TEST_KEYS writes that cycle every sector */
+
+typedef struct {
+    bool present;
+    uint8_t len;
+    uint8_t value[LOG_STORE_VALUE_MAX];
+} value_t;
+
+typedef struct {
+    value_t ram[TEST_KEYS];         /* What the application set */
+    value_t durable[TEST_KEYS];     /* As of the last flush that returned ESP_OK */
+    bool dirty[TEST_KEYS];          /* Changed since then */
+    bool crashed;
+} model_t;
+
+typedef struct {
+    uint64_t first_unit;
+    uint64_t last_unit;
+} unit_range_t;
+
+static int s_failures = 0;
+static uint32_t s_random;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            s_failures++; \
+            return false; \
+        } \
+    } while (0)
+
+static uint32_t next_random(void)
+{
+    s_random ^= s_random << 13;
+    s_random ^= s_random >> 17;
+    s_random ^= s_random << 5;
+    return s_random;
+}
+
+/* Keys of different lengths, so records of many sizes meet at sector ends */
+static void key_name(int key, char *name)
+{
+    snprintf(name, LOG_STORE_KEY_MAX, "%.*s%02d", key % 16, "resume_position_", key);
+}
+
+static bool value_equal(const value_t *a, const value_t *b)
+{
+    if (a->present != b->present) {
+        return false;
+    }
+    return !a->present || (a->len == b->len && memcmp(a->value, b->value, a->len) == 0);
+}
+
+static void read_key(int key, value_t *out)
+{
+    char name[LOG_STORE_KEY_MAX];
+    size_t len = sizeof(out->value);
+    key_name(key, name);
+    memset(out, 0, sizeof(*out));
+    out->present = log_store_get(name, out->value, &len) == ESP_OK;
+    out->len = out->present ? (uint8_t)len : 0;
+}
+
+static uint64_t units_done(void)
+{
+    fake_partition_stats_t stats;
+    fake_partition_get_stats(&stats);
+    return stats.units;
+}
+
+/*
+ * Run the workload from an empty partition until it completes or the power
+ * is cut. compactions, if given, receives the unit ranges of the flushes
+ * that compacted a sector.
+ */
+static bool run_workload(model_t *model, int64_t cut, fake_cut_mode_t mode,
+                         unit_range_t *compactions, int *compaction_count)
+{
+    memset(model, 0, sizeof(*model));
+    s_random = 0x2545F491u;
+    fake_partition_reset(TEST_SECTORS * SECTOR_SIZE);
+    fake_partition_cut_after(cut, mode);
+    log_store_reset_state();
+
+    esp_err_t err = log_store_init();
+    if (fake_partition_powered_off()) {
+        model->crashed = true;
+        return true;
+    }
+    CHECK(err == ESP_OK, "first mount: %s", esp_err_to_name(err));
+
+    for (int batch = 0; batch < TEST_BATCHES; batch++) {
+        for (int i = 0; i < TEST_BATCH_CHANGES; i++) {
+            int key = next_random() % TEST_KEYS;
+            char name[LOG_STORE_KEY_MAX];
+            key_name(key, name);
+            value_t *value = &model->ram[key];
+            if (value->present && next_random() % 8 == 0) {
+                CHECK(log_store_erase(name) == ESP_OK, "erase %s", name);
+                value->present = false;
+            } else {
+                value->present = true;
+                value->len = 1 + next_random() % LOG_STORE_VALUE_MAX;
+                for (int b = 0; b < value->len; b++) {
+                    value->value[b] = (uint8_t)next_random();
+                }
+                CHECK(log_store_set(name, value->value, value->len) == ESP_OK, "set %s", name);
+            }
+            model->dirty[key] = true;
+        }
+
+        uint32_t compactions_before = s_metrics.compactions;
+        uint64_t first_unit = units_done();
+        err = log_store_flush();
+        if (fake_partition_powered_off()) {
+            model->crashed = true;
+            return true;
+        }
+        CHECK(err == ESP_OK, "flush of batch %d: %s", batch, esp_err_to_name(err));
+        if (compactions && s_metrics.compactions != compactions_before) {
+            compactions[*compaction_count].first_unit = first_unit;
+            compactions[*compaction_count].last_unit = units_done();
+            (*compaction_count)++;
+        }
+        memcpy(model->durable, model->ram, sizeof(model->durable));
+        memset(model->dirty, 0, sizeof(model->dirty));
+    }
+    return true;
+}
+
+/* Sectors released by compaction: magic zeroed, old records still there */
+static int count_released_unerased(void)
+{
+    const uint8_t *data = fake_partition_data();
+    int count = 0;
+    for (int sector = 0; sector < TEST_SECTORS; sector++) {
+        const uint8_t *start = data + sector * SECTOR_SIZE;
+        uint32_t magic;
+        memcpy(&magic, start, sizeof(magic));
+        count += magic == 0 && start[sizeof(sector_header_t)] == RECORD_MARKER;
+    }
+    return count;
+}
+
+static bool verify_recovery(const model_t *model, int64_t cut, fake_cut_mode_t mode)
+{
+    esp_err_t err = log_store_reboot();
+    CHECK(err == ESP_OK, "cut %lld/%d: mount: %s", (long long)cut, mode, esp_err_to_name(err));
+
+    /* Released sectors must read as free, never be replayed */
+    const uint8_t *data = fake_partition_data();
+    for (int sector = 0; sector < TEST_SECTORS; sector++) {
+        uint32_t magic;
+        memcpy(&magic, data + sector * SECTOR_SIZE, sizeof(magic));
+        CHECK(magic != 0 || s_sector_seq[sector] == 0,
+              "cut %lld/%d: released sector %d in use", (long long)cut, mode, sector);
+    }
+
+    for (int key = 0; key < TEST_KEYS; key++) {
+        value_t value;
+        read_key(key, &value);
+        bool ok = value_equal(&value, &model->durable[key]) ||
+                  (model->dirty[key] && value_equal(&value, &model->ram[key]));
+        CHECK(ok, "cut %lld/%d: key %d reads %s (len %u)", (long long)cut, mode, key,
+              value.present ? "a wrong value" : "missing", value.len);
+    }
+    return true;
+}
+
+/* New writes after the recovery survive a reboot, also after rounds of compaction */
+static bool verify_continues(int rounds, int64_t cut, fake_cut_mode_t mode)
+{
+    uint8_t value[LOG_STORE_VALUE_MAX];
+    for (int round = 0; round < rounds; round++) {
+        for (int key = 0; key < TEST_KEYS; key++) {
+            char name[LOG_STORE_KEY_MAX];
+            key_name(key, name);
+            memset(value, round * 31 + key, sizeof(value));
+            CHECK(log_store_set(name, value, 1 + (round + key) % LOG_STORE_VALUE_MAX) == ESP_OK,
+                  "cut %lld/%d: set after recovery", (long long)cut, mode);
+        }
+        esp_err_t err = log_store_flush();
+        CHECK(err == ESP_OK, "cut %lld/%d: flush after recovery, round %d: %s", (long long)cut, mode, round,
+              esp_err_to_name(err));
+    }
+
+    esp_err_t err = log_store_reboot();
+    CHECK(err == ESP_OK, "cut %lld/%d: second mount: %s", (long long)cut, mode, esp_err_to_name(err));
+    CHECK(s_metrics.torn_records == 0 || rounds < WRAP_ROUNDS,
+          "cut %lld/%d: torn record survived a full wrap-around", (long long)cut, mode);
+    for (int key = 0; key < TEST_KEYS; key++) {
+        value_t read;
+        read_key(key, &read);
+        memset(value, (rounds - 1) * 31 + key, sizeof(value));
+        size_t len = 1 + (rounds - 1 + key) % LOG_STORE_VALUE_MAX;
+        CHECK(read.present && read.len == len && memcmp(read.value, value, len) == 0,
+              "cut %lld/%d: key %d lost after recovery", (long long)cut, mode, key);
+    }
+    return true;
+}
+
+static bool cut_and_verify(int64_t cut, fake_cut_mode_t mode, bool heavy, fake_partition_stats_t *cut_stats,
+                           int *released_unerased)
+{
+    model_t model;
+    if (!run_workload(&model, cut, mode, NULL, NULL)) {
+        return false;
+    }
+    CHECK(model.crashed, "cut %lld/%d: workload finished before the cut", (long long)cut, mode);
+    fake_partition_get_stats(cut_stats);
+    *released_unerased = count_released_unerased();
+    return verify_recovery(&model, cut, mode) && verify_continues(heavy ? WRAP_ROUNDS : 1, cut, mode);
+}
+
+/* A record cut at every word, in the middle of a sector */
+static bool test_torn_record(void)
+{
+    const uint8_t old_value[4] = {1, 2, 3, 4};
+    uint8_t new_value[LOG_STORE_VALUE_MAX];
+    memset(new_value, 0x5A, sizeof(new_value));
+    int64_t record_units = record_size(strlen("volume"), sizeof(new_value)) / 4;
+
+    for (int mode = FAKE_CUT_CLEAN; mode <= FAKE_CUT_TORN; mode++) {
+        for (int64_t cut = 0; cut < record_units; cut++) {
+            fake_partition_reset(TEST_SECTORS * SECTOR_SIZE);
+            CHECK(log_store_reboot() == ESP_OK, "mount");
+            CHECK(log_store_set("volume", old_value, sizeof(old_value)) == ESP_OK, "set");
+            CHECK(log_store_flush() == ESP_OK, "flush");
+
+            fake_partition_cut_after(cut, mode);
+            log_store_set("volume", new_value, sizeof(new_value));
+            CHECK(log_store_flush() != ESP_OK && fake_partition_powered_off(), "cut %lld not hit", (long long)cut);
+
+            CHECK(log_store_reboot() == ESP_OK, "mount after cut %lld", (long long)cut);
+            uint8_t value[LOG_STORE_VALUE_MAX];
+            size_t len = sizeof(value);
+            CHECK(log_store_get("volume", value, &len) == ESP_OK, "cut %lld/%d: key lost", (long long)cut, mode);
+            /* Only the padding missing: the record is complete and counts */
+            bool complete = len == sizeof(new_value) && memcmp(value, new_value, len) == 0;
+            CHECK(complete || (len == sizeof(old_value) && memcmp(value, old_value, len) == 0),
+                  "cut %lld/%d: neither old nor new value", (long long)cut, mode);
+            bool programmed = !complete && (cut > 0 || mode == FAKE_CUT_TORN);
+            CHECK(s_metrics.torn_records == (programmed ? 1u : 0u), "cut %lld/%d: %lu torn records",
+                  (long long)cut, mode, (unsigned long)s_metrics.torn_records);
+
+            /* Written after a torn record, the next record goes to a fresh sector */
+            uint32_t erases = s_metrics.sector_erases;
+            CHECK(log_store_set("volume", new_value, sizeof(new_value)) == ESP_OK, "set after cut");
+            CHECK(log_store_flush() == ESP_OK, "flush after cut");
+            CHECK(s_metrics.sector_erases == erases + (programmed ? 1u : 0u),
+                  "cut %lld/%d: head not sealed", (long long)cut, mode);
+            CHECK(log_store_reboot() == ESP_OK, "second mount");
+            len = sizeof(value);
+            CHECK(log_store_get("volume", value, &len) == ESP_OK && len == sizeof(new_value) &&
+                  memcmp(value, new_value, len) == 0, "cut %lld/%d: new value lost", (long long)cut, mode);
+        }
+    }
+    printf("torn record: %lld cut points x 2 modes ok\n", (long long)record_units);
+    return true;
+}
+
+/* Every unit of the flushes that compact a sector, each followed by full wrap-arounds */
+static bool test_interrupted_compaction(const unit_range_t *compactions, int count)
+{
+    int cuts = 0, released_seen = 0, in_erase = 0;
+    for (int i = 0; i < count && i < 3; i++) {
+        for (int mode = FAKE_CUT_CLEAN; mode <= FAKE_CUT_TORN; mode++) {
+            for (uint64_t cut = compactions[i].first_unit; cut < compactions[i].last_unit; cut++) {
+                fake_partition_stats_t stats;
+                int released = 0;
+                if (!cut_and_verify((int64_t)cut, mode, true, &stats, &released)) {
+                    return false;
+                }
+                cuts++;
+                released_seen += released > 0;
+                in_erase += stats.cut_op == FAKE_OP_ERASE;
+            }
+        }
+    }
+    CHECK(cuts > 0, "the workload never compacted");
+    printf("interrupted compaction: %d cuts in %d compacting flushes ok (%d in an erase)\n",
+           cuts, count < 3 ? count : 3, in_erase);
+    return true;
+}
+
+/* Every cut point of the whole workload */
+static bool test_power_loss_sweep(uint64_t total_units)
+{
+    int cuts = 0, in_write = 0, in_erase = 0, released_unerased = 0;
+    for (int mode = FAKE_CUT_CLEAN; mode <= FAKE_CUT_TORN; mode++) {
+        for (uint64_t cut = 0; cut < total_units; cut++) {
+            fake_partition_stats_t stats;
+            int released = 0;
+            if (!cut_and_verify((int64_t)cut, mode, cut % HEAVY_CHECK_EVERY == 0, &stats, &released)) {
+                return false;
+            }
+            cuts++;
+            in_write += stats.cut_op == FAKE_OP_WRITE;
+            in_erase += stats.cut_op == FAKE_OP_ERASE;
+            released_unerased += released > 0;
+        }
+    }
+    /* The sweep must have hit the states the store claims to survive */
+    CHECK(in_erase > 0, "no cut during an erase");
+    CHECK(released_unerased > 0, "no cut while a released sector awaited its erase");
+    printf("power-loss sweep: %d cuts ok (%d in a write, %d in an erase, "
+           "%d with a zeroed magic on an unerased sector)\n", cuts, in_write, in_erase, released_unerased);
+    return true;
+}
+
+int main(void)
+{
+    model_t model;
+    unit_range_t compactions[TEST_BATCHES];
+    int compaction_count = 0;
+
+    /* Reference run without a cut */
+    if (!run_workload(&model, -1, FAKE_CUT_CLEAN, compactions, &compaction_count)) {
+        return 1;
+    }
+    uint64_t total_units = units_done();
+    printf("workload: %d flushes, %llu flash units, %lu records, %lu erases, %lu compactions\n",
+           TEST_BATCHES, (unsigned long long)total_units, (unsigned long)s_metrics.records_written,
+           (unsigned long)s_metrics.sector_erases, (unsigned long)s_metrics.compactions);
+    if (compaction_count == 0 || s_metrics.sector_erases <= TEST_SECTORS) {
+        fprintf(stderr, "workload too small: it must wrap around the partition\n");
+        return 1;
+    }
+
+    test_torn_record();
+    test_interrupted_compaction(compactions, compaction_count);
+    test_power_loss_sweep(total_units);
+
+    if (s_failures) {
+        fprintf(stderr, "%d failure(s)\n", s_failures);
+        return 1;
+    }
+    printf("all log store power-loss tests passed\n");
+    return 0;
+}
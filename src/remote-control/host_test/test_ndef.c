@@ -0,0 +1,117 @@
+/*
+ * Tests of rfid/ndef.c with crafted tag contents.
+ *
+ * ndef.c is compiled into the test with size_t as wide as on the ESP32
+ * (32 bits), so record lengths that would wrap the bounds arithmetic there
+ * wrap here too. Every message is copied into a heap buffer of exactly its
+ * size; the test target is built with AddressSanitizer, so reading past the
+ * end of the tag data aborts the test.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_err.h"
+
+#define size_t uint32_t
+#include "rfid/ndef.c"
+#undef size_t
+
+#define URI_SIZE 64
+
+static int s_failures = 0;
+
+/* Decode tlv from a buffer of exactly len bytes */
+static esp_err_t decode(const uint8_t *tlv, size_t len, char *uri, size_t uri_size)
+{
+    uint8_t *copy = malloc(len);
+    memcpy(copy, tlv, len);
+    esp_err_t err = ndef_find_uri(copy, (uint32_t)len, uri, (uint32_t)uri_size);
+    free(copy);
+    return err;
+}
+
+static void expect(const char *name, const uint8_t *tlv, size_t len, esp_err_t expected, const char *expected_uri)
+{
+    char uri[URI_SIZE] = "";
+    esp_err_t err = decode(tlv, len, uri, sizeof(uri));
+
+    if (err != expected) {
+        fprintf(stderr, "%s: got %s, expected %s\n", name, esp_err_to_name(err), esp_err_to_name(expected));
+        s_failures++;
+    } else if (expected_uri && strcmp(uri, expected_uri) != 0) {
+        fprintf(stderr, "%s: got \"%s\", expected \"%s\"\n", name, uri, expected_uri);
+        s_failures++;
+    } else {
+        printf("%-28s %s\n", name, esp_err_to_name(err));
+    }
+}
+
+#define EXPECT(name, expected, expected_uri, ...) \
+    do { \
+        static const uint8_t tlv[] = { __VA_ARGS__ }; \
+        expect(name, tlv, sizeof(tlv), expected, expected_uri); \
+    } while (0)
+
+int main(void)
+{
+    /* Short record: MB ME SR TNF=1, type "U", payload code 0x04 + "a.de/x" */
+    EXPECT("short uri record", ESP_OK, "https://a.de/x",
+           0x03, 0x0B, 0xD1, 0x01, 0x07, 'U', 0x04, 'a', '.', 'd', 'e', '/', 'x', 0xFE);
+
+    /* Long record (4-byte length) of the same URI, after a null TLV */
+    EXPECT("long uri record", ESP_OK, "http://b.de",
+           0x00, 0x03, 0x0C, 0xC1, 0x01, 0x00, 0x00, 0x00, 0x05, 'U', 0x03, 'b', '.', 'd', 'e');
+
+    /* A 4-byte payload length that wraps type + id + payload to less than the message */
+    EXPECT("payload length 0xFFFFFFFF", ESP_ERR_INVALID_RESPONSE, NULL,
+           0x03, 0x0A, 0xC1, 0x01, 0xFF, 0xFF, 0xFF, 0xFF, 'U', 0x04, 'a', 'b');
+    EXPECT("payload length 0xFFFFFFFE", ESP_ERR_INVALID_RESPONSE, NULL,
+           0x03, 0x0A, 0xC1, 0x01, 0xFF, 0xFF, 0xFF, 0xFE, 'U', 0x04, 'a', 'b');
+    EXPECT("id + payload wrap", ESP_ERR_INVALID_RESPONSE, NULL,
+           0x03, 0x0C, 0xC9, 0x01, 0xFF, 0xFF, 0xFF, 0xF0, 0x10, 'U', 'i', 0x04, 'a', 'b');
+    EXPECT("type length too long", ESP_ERR_INVALID_RESPONSE, NULL,
+           0x03, 0x05, 0xD1, 0x20, 0x01, 'U', 0x04);
+    EXPECT("payload one byte too long", ESP_ERR_INVALID_RESPONSE, NULL,
+           0x03, 0x06, 0xD1, 0x01, 0x03, 'U', 0x04, 'a');
+    EXPECT("truncated record header", ESP_ERR_INVALID_RESPONSE, NULL,
+           0x03, 0x03, 0xC1, 0x01, 0x00);
+
+    EXPECT("tlv beyond the data", ESP_ERR_INVALID_SIZE, NULL,
+           0x03, 0x20, 0xD1, 0x01, 0x02, 'U', 0x04, 'a');
+    EXPECT("long tlv length cut", ESP_ERR_INVALID_SIZE, NULL,
+           0x03, 0xFF, 0x00);
+    EXPECT("no uri record", ESP_ERR_NOT_FOUND, NULL,
+           0x03, 0x07, 0xD1, 0x01, 0x03, 'T', 0x02, 'd', 'e', 0xFE);
+    EXPECT("terminator only", ESP_ERR_NOT_FOUND, NULL,
+           0xFE);
+    EXPECT("tel: prefix", ESP_ERR_NOT_SUPPORTED, NULL,
+           0x03, 0x07, 0xD1, 0x01, 0x03, 'U', 0x05, '1', '2');
+    EXPECT("control character", ESP_ERR_INVALID_RESPONSE, NULL,
+           0x03, 0x07, 0xD1, 0x01, 0x03, 'U', 0x04, 'a', 0x00);
+
+    /* The URI must fit including its NUL */
+    static const uint8_t fits[] = { 0x03, 0x07, 0xD1, 0x01, 0x03, 'U', 0x03, 'a', 'b' };
+    char uri[10];
+    esp_err_t err = ndef_find_uri(fits, sizeof(fits), uri, sizeof(uri));
+    if (err != ESP_OK || strcmp(uri, "http://ab") != 0) {
+        fprintf(stderr, "exact fit: %s\n", esp_err_to_name(err));
+        s_failures++;
+    }
+    err = ndef_find_uri(fits, sizeof(fits), uri, sizeof(uri) - 1);
+    if (err != ESP_ERR_NO_MEM) {
+        fprintf(stderr, "one byte short: %s\n", esp_err_to_name(err));
+        s_failures++;
+    }
+
+    if (s_failures) {
+        fprintf(stderr, "%d failure(s)\n", s_failures);
+        return 1;
+    }
+    printf("all NDEF tests passed\n");
+    return 0;
+}
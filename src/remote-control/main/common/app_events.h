@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_event.h"
 
 /**
@@ -80,9 +82,10 @@ typedef enum {
     
     /** Parental control time limit reached
      * 
-     * Reserved for parental control module
      * Event data: NULL
-     * Use case: Disable playback until limit resets
+     * Triggered: parental_control, when today's playtime budget runs out while playing
+     * Use case: Pause playback (music_assistant_controller), show a notice (display_controller),
+     *           blink the playback LED (led_controller)
      */
     APP_EVENT_PARENTAL_LIMIT_REACHED,
     
@@ -101,6 +104,24 @@ typedef enum {
      */
     APP_EVENT_ERROR,
     
+    /** Player state or now-playing information changed
+     * 
+     * Event data: app_now_playing_event_t* with title, state, volume and a position anchor
+     * Triggered: music_assistant_controller, after transport/volume commands (local
+     *            update, no request) and after reading the player state from the server
+     * Use case: Now-playing screen (display_controller), playback LED (led_controller)
+     */
+    APP_EVENT_NOW_PLAYING,
+    
+    /** Cover art of the current media item is known
+     * 
+     * Event data: app_cover_art_event_t* with a 1-bit thumbnail, or present = false
+     * Triggered: cover_art, after a flash lookup or a download for the media ID
+     *            of the loaded card
+     * Use case: Now-playing screen (display_controller)
+     */
+    APP_EVENT_COVER_ART,
+    
     /** Marker for event count (keep last)
      */
     APP_EVENTS_COUNT
@@ -113,3 +134,32 @@ typedef struct {
     int error_code;
     const char *error_message;
 } app_error_event_t;
+
+/** Longest title in APP_EVENT_NOW_PLAYING, in bytes (UTF-8) including the NUL */
+#define APP_NOW_PLAYING_TITLE_MAX 64
+
+/**
+ * @brief Now-playing event data structure
+ *
+ * The position is valid at anchor_us (esp_timer time) and advances in real
+ * time while playing, so receivers can animate it without asking again.
+ */
+typedef struct {
+    char title[APP_NOW_PLAYING_TITLE_MAX];  /* Empty if unknown */
+    bool playing;
+    int volume;             /* Percent, -1 if unknown */
+    float position;         /* Seconds at anchor_us, < 0 if unknown */
+    float duration;         /* Seconds, 0 if unknown (e.g. radio) */
+    int64_t anchor_us;
+} app_now_playing_event_t;
+
+/** Thumbnail size in APP_EVENT_COVER_ART: 32x32 pixels in four 8-row pages */
+#define APP_COVER_ART_BYTES 128
+
+/**
+ * @brief Cover art event data structure
+ */
+typedef struct {
+    bool present;                           /* false: no cover (yet), clear it */
+    uint8_t bitmap[APP_COVER_ART_BYTES];    /* Page-major, one byte per column of 8 rows, LSB on top */
+} app_cover_art_event_t;
@@ -39,4 +39,8 @@
 #define BOARD_BUTTON_PLAY_PAUSE_GPIO        GPIO_NUM_25
 #define BOARD_BUTTON_NEXT_TRACK_GPIO        GPIO_NUM_19
 
+/* ==================== Status LEDs (LEDC) ==================== */
+#define BOARD_LED_NETWORK_GPIO              26
+#define BOARD_LED_PLAYBACK_GPIO             32
+
 #endif /* BOARD_PINS_H */
@@ -18,12 +18,41 @@
 #define WIFI_CONNECT_MAX_RETRY          5
 #define WIFI_RECONNECT_DELAY_MS         1000
 #define HTTP_REQUEST_TIMEOUT_MS         5000
+#define HTTP_CONNECTION_POOL_SIZE       3       /* One kept-alive connection per controller lane, one for cover art */
+#define HTTP_KEEP_ALIVE_IDLE_MS         30000   /* Reconnect instead of reusing a connection idle this long */
+#define TEMPLATE_API_RETRY_MS           600000  /* Try /api/template again this long after a 400/401/403 */
+#define PLAYBACK_CLOCK_MAX_AGE_MS       300000  /* Re-read the position from the server after this long */
+#define NOW_PLAYING_SETTLE_MS           2000    /* Read the new title this long after play_media / next / previous */
+#define NOW_PLAYING_RESYNC_MS           60000   /* Re-read the player state this often while playing */
+#define PARENTAL_CHECKPOINT_MS          60000   /* Save the running session's playtime this often */
+#define PARENTAL_PAUSE_RETRY_MS         5000    /* Re-send the limit pause this often until a sync confirms it */
+#define LOG_STORE_MAX_KEYS              64      /* Keys held by the log store (all mirrored in RAM) */
+#define LOG_STORE_FLUSH_DELAY_MS        60000   /* Batch log store writes to flash over this window */
+#define LOG_STORE_RESERVE_SECTORS       2       /* Free sectors kept so compaction can always move records */
 #define DISPLAY_UPDATE_TIMEOUT_MS       100
+#define DISPLAY_MIN_FRAME_MS            100     /* Frame-rate cap: at most one redraw per this interval */
+#define DISPLAY_MARQUEE_STEP_MS         100     /* Scroll over-long lines by one step per this interval */
+#define DISPLAY_MARQUEE_STEP_PX         2       /* Pixels per scroll step */
+#define DISPLAY_MARQUEE_HOLD_MS         1500    /* Show the start of an over-long line this long before scrolling */
+#define TEXT_CACHE_SIZE                 8       /* Rendered strings kept for reuse (~450 bytes each) */
+#define TEXT_MARQUEE_GAP_PX             24      /* Blank space between repetitions of a scrolling line */
+#define RFID_NDEF_CACHE_SIZE            8       /* Cards whose NDEF URI (or its absence) is kept in RAM */
+#define RFID_NDEF_URI_MAX               128     /* Longest URI used as a media ID, including NUL */
+#define RFID_NDEF_READ_MAX              192     /* Bytes of NDEF data read from a card at most */
+#define MEDIA_METADATA_CACHE_SIZE       8       /* Media IDs whose title/artist are kept in RAM */
+#define MEDIA_METADATA_FLASH_MAX        32      /* Media IDs whose title/artist are kept in NVS */
+#define COVER_ART_DOWNLOAD_MAX          262144  /* Give up on cover pictures larger than this */
+#define STATUS_LED_PWM_FREQ_HZ          5000    /* LED PWM frequency for steady and fading levels */
+#define STATUS_LED_FADE_SEGMENT_MS      2000    /* Longest hardware fade; a new LED pattern waits at most this long */
+#define STANDBY_CARD_RECHECK_MS         3000    /* After a wake, the card found on the reader this soon is the one left there */
 
 /* ========== Display Messages ========== */
-#define DISPLAY_MSG_WAITING             "Warte auf", "Karte..."
-#define DISPLAY_MSG_CONNECTING_WIFI     "WLAN-Verbindung", "wird hergestellt..."
+#define DISPLAY_MSG_WAITING             "Warte auf", "Karte…"
+#define DISPLAY_MSG_CONNECTING_WIFI     "WLAN-Verbindung", "wird hergestellt…"
 #define DISPLAY_MSG_WIFI_CONNECTED      "WLAN-Verbindung", "erfolgreich"
 #define DISPLAY_MSG_WIFI_FAILED         "WLAN-Verbindung", "fehlgeschlagen"
+#define DISPLAY_MSG_SERVER_UNREACHABLE  "Musik-Server", "nicht erreichbar"
+#define DISPLAY_MSG_SERVER_REACHABLE    "Musik-Server", "wieder erreichbar"
+#define DISPLAY_MSG_PLAYTIME_OVER       "Musikzeit", "für heute vorbei"
 
 #endif /* APP_CONFIG_H */
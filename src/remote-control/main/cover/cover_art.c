@@ -0,0 +1,521 @@
+#include "cover_art.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "rom/tjpgd.h"
+#include "common/config.h"
+#include "common/app_events.h"
+#include "music_assistant/music_assistant_client.h"
+
+static const char *TAG = "COVER_ART";
+
+#define PARTITION_LABEL         "covers"
+#define SECTOR_SIZE             4096
+#define MAX_SLOTS               64
+#define SLOT_MAGIC              0x52564F43u     /* "COVR" */
+
+#define COVER_TASK_STACK_SIZE   6144
+#define COVER_TASK_PRIORITY     2
+
+/* Work area of the ROM TJpgDec: Huffman/quantization tables, input buffer and one MCU */
+#define JPEG_WORK_SIZE          3100
+#define JPEG_SKIP_CHUNK         64
+
+_Static_assert(COVER_ART_BYTES == APP_COVER_ART_BYTES, "event and cache thumbnails differ in size");
+_Static_assert(COVER_ART_SIZE % 8 == 0, "thumbnails are drawn in whole pages");
+
+/* One thumbnail per flash sector, so replacing one never touches another */
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;           /* Write order; seeds recency at boot */
+    uint32_t key_hash;
+    uint16_t key_len;       /* Without the terminating NUL */
+    uint16_t reserved;
+    uint32_t crc;           /* Over the fields above, the key and the bitmap */
+    char key[COVER_ART_KEY_MAX];
+    uint8_t bitmap[COVER_ART_BYTES];
+} cover_slot_t;
+
+_Static_assert(sizeof(cover_slot_t) <= SECTOR_SIZE, "a thumbnail must fit into one sector");
+
+typedef struct {
+    bool used;
+    uint32_t key_hash;
+    uint32_t last_use;      /* Recency clock value; the smallest is replaced first */
+} slot_index_t;
+
+typedef struct {
+    char media_id[COVER_ART_KEY_MAX];
+    char picture[MUSIC_ASSISTANT_PICTURE_MAX];
+} cover_request_t;
+
+/* What the cover task knows about the cover on screen */
+typedef enum {
+    COVER_SHOWN,            /* Thumbnail posted */
+    COVER_MISSING,          /* Not on flash; fetched as soon as a picture path arrives */
+    COVER_FAILED,           /* Fetch failed; not retried until another media ID is shown */
+} cover_state_t;
+
+/* Streaming decode state; the only memory a decode needs, whatever the picture size */
+typedef struct {
+    music_assistant_stream_t *stream;
+    uint32_t bytes;
+    uint32_t crop_x;        /* Square crop in scaled pixels */
+    uint32_t crop_y;
+    uint32_t crop_side;
+    uint32_t sum[COVER_ART_SIZE * COVER_ART_SIZE];      /* Luma per thumbnail pixel */
+    uint16_t count[COVER_ART_SIZE * COVER_ART_SIZE];
+    int16_t gray[COVER_ART_SIZE * COVER_ART_SIZE];      /* Averaged luma plus diffused error */
+    uint8_t work[JPEG_WORK_SIZE];
+} decode_context_t;
+
+static const esp_partition_t *s_partition = NULL;
+static QueueHandle_t s_queue = NULL;
+static TaskHandle_t s_task = NULL;
+
+/* Owned by the cover task */
+static slot_index_t s_index[MAX_SLOTS];
+static uint32_t s_slot_count = 0;
+static uint32_t s_use_clock = 0;
+static char s_current_key[COVER_ART_KEY_MAX] = "";
+static cover_state_t s_current_state = COVER_MISSING;
+
+static cover_art_metrics_t s_metrics;
+static portMUX_TYPE s_metrics_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* FNV-1a */
+static uint32_t key_hash(const char *key, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t slot_crc(const cover_slot_t *slot)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)slot, offsetof(cover_slot_t, crc));
+    crc = esp_rom_crc32_le(crc, (const uint8_t *)slot->key, slot->key_len);
+    return esp_rom_crc32_le(crc, slot->bitmap, sizeof(slot->bitmap));
+}
+
+static bool slot_valid(const cover_slot_t *slot)
+{
+    return slot->magic == SLOT_MAGIC && slot->key_len < COVER_ART_KEY_MAX && slot->crc == slot_crc(slot);
+}
+
+static void post_cover(const uint8_t *bitmap)
+{
+    app_cover_art_event_t event = { .present = bitmap != NULL };
+    if (bitmap) {
+        memcpy(event.bitmap, bitmap, sizeof(event.bitmap));
+    }
+    esp_err_t err = esp_event_post(APP_EVENTS, APP_EVENT_COVER_ART, &event, sizeof(event), 0);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to post cover art event: %s", esp_err_to_name(err));
+    }
+}
+
+/* Find key on flash and post its thumbnail; false on a miss */
+static bool load_cover(const char *key)
+{
+    size_t len = strlen(key);
+    uint32_t hash = key_hash(key, len);
+    int64_t start_us = esp_timer_get_time();
+    cover_slot_t slot;
+
+    for (uint32_t i = 0; i < s_slot_count; i++) {
+        if (!s_index[i].used || s_index[i].key_hash != hash) {
+            continue;
+        }
+        if (esp_partition_read(s_partition, (size_t)i * SECTOR_SIZE, &slot, sizeof(slot)) != ESP_OK) {
+            continue;
+        }
+        if (!slot_valid(&slot)) {
+            /* Worn or disturbed since boot: treat as free */
+            ESP_LOGW(TAG, "Slot %lu failed its CRC, dropped", (unsigned long)i);
+            s_index[i].used = false;
+            portENTER_CRITICAL(&s_metrics_lock);
+            s_metrics.slots_used--;
+            portEXIT_CRITICAL(&s_metrics_lock);
+            continue;
+        }
+        if (slot.key_len != len || memcmp(slot.key, key, len) != 0) {
+            continue;
+        }
+
+        s_index[i].last_use = ++s_use_clock;
+        uint32_t load_us = (uint32_t)(esp_timer_get_time() - start_us);
+        portENTER_CRITICAL(&s_metrics_lock);
+        s_metrics.last_load_us = load_us;
+        portEXIT_CRITICAL(&s_metrics_lock);
+
+        post_cover(slot.bitmap);
+        return true;
+    }
+    return false;
+}
+
+static esp_err_t store_cover(const char *key, const uint8_t *bitmap)
+{
+    uint32_t victim = 0;
+    bool evicting = true;
+    for (uint32_t i = 0; i < s_slot_count; i++) {
+        if (!s_index[i].used) {
+            victim = i;
+            evicting = false;
+            break;
+        }
+        if (s_index[i].last_use < s_index[victim].last_use) {
+            victim = i;
+        }
+    }
+
+    cover_slot_t slot = {
+        .magic = SLOT_MAGIC,
+        .seq = ++s_use_clock,
+        .key_len = (uint16_t)strlen(key),
+    };
+    memcpy(slot.key, key, slot.key_len);
+    memcpy(slot.bitmap, bitmap, sizeof(slot.bitmap));
+    slot.key_hash = key_hash(slot.key, slot.key_len);
+    slot.crc = slot_crc(&slot);
+
+    /* Forget the old thumbnail first: a write torn by power loss fails its CRC at boot */
+    s_index[victim].used = false;
+    esp_err_t err = esp_partition_erase_range(s_partition, (size_t)victim * SECTOR_SIZE, SECTOR_SIZE);
+    if (err == ESP_OK) {
+        err = esp_partition_write(s_partition, (size_t)victim * SECTOR_SIZE, &slot, sizeof(slot));
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store cover in slot %lu: %s", (unsigned long)victim, esp_err_to_name(err));
+        if (evicting) {
+            portENTER_CRITICAL(&s_metrics_lock);
+            s_metrics.slots_used--;
+            portEXIT_CRITICAL(&s_metrics_lock);
+        }
+        return err;
+    }
+
+    s_index[victim] = (slot_index_t){ .used = true, .key_hash = slot.key_hash, .last_use = slot.seq };
+    portENTER_CRITICAL(&s_metrics_lock);
+    if (evicting) {
+        s_metrics.evictions++;
+    } else {
+        s_metrics.slots_used++;
+    }
+    portEXIT_CRITICAL(&s_metrics_lock);
+    return ESP_OK;
+}
+
+/* TJpgDec input: pull the next bytes of the download, or skip them (buf == NULL) */
+static UINT jpeg_input(JDEC *jd, BYTE *buf, UINT len)
+{
+    decode_context_t *ctx = (decode_context_t *)jd->device;
+    uint8_t skip[JPEG_SKIP_CHUNK];
+    UINT done = 0;
+
+    while (done < len) {
+        if (ctx->bytes >= COVER_ART_DOWNLOAD_MAX) {
+            ESP_LOGW(TAG, "Picture larger than %d bytes, giving up", COVER_ART_DOWNLOAD_MAX);
+            break;
+        }
+        size_t chunk = len - done;
+        if (buf == NULL && chunk > sizeof(skip)) {
+            chunk = sizeof(skip);
+        }
+        int data_read = music_assistant_stream_read(ctx->stream, buf ? buf + done : skip, chunk);
+        if (data_read <= 0) {
+            break;
+        }
+        done += (UINT)data_read;
+        ctx->bytes += (uint32_t)data_read;
+    }
+    return done;
+}
+
+/* TJpgDec output: fold each decoded RGB888 block into the thumbnail's luma sums */
+static UINT jpeg_output(JDEC *jd, void *bitmap, JRECT *rect)
+{
+    decode_context_t *ctx = (decode_context_t *)jd->device;
+    const uint8_t *rgb = (const uint8_t *)bitmap;
+
+    for (uint32_t y = rect->top; y <= rect->bottom; y++) {
+        for (uint32_t x = rect->left; x <= rect->right; x++, rgb += 3) {
+            if (x < ctx->crop_x || y < ctx->crop_y ||
+                x >= ctx->crop_x + ctx->crop_side || y >= ctx->crop_y + ctx->crop_side) {
+                continue;
+            }
+            uint32_t tx = (x - ctx->crop_x) * COVER_ART_SIZE / ctx->crop_side;
+            uint32_t ty = (y - ctx->crop_y) * COVER_ART_SIZE / ctx->crop_side;
+            uint32_t i = ty * COVER_ART_SIZE + tx;
+            ctx->sum[i] += (77u * rgb[0] + 150u * rgb[1] + 29u * rgb[2]) >> 8;
+            ctx->count[i]++;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Average the luma sums, stretch them to the full range (covers are often
+ * dark or washed out, which leaves almost nothing after thresholding) and
+ * Floyd-Steinberg dither to a page-layout bitmap. Lit pixels are bright.
+ */
+static void dither(decode_context_t *ctx, uint8_t *bitmap)
+{
+    int16_t *gray = ctx->gray;
+    int lo = 255;
+    int hi = 0;
+
+    for (int i = 0; i < COVER_ART_SIZE * COVER_ART_SIZE; i++) {
+        gray[i] = ctx->count[i] ? (int16_t)(ctx->sum[i] / ctx->count[i]) : 0;
+        lo = gray[i] < lo ? gray[i] : lo;
+        hi = gray[i] > hi ? gray[i] : hi;
+    }
+    if (hi - lo >= 32) {
+        for (int i = 0; i < COVER_ART_SIZE * COVER_ART_SIZE; i++) {
+            gray[i] = (int16_t)((gray[i] - lo) * 255 / (hi - lo));
+        }
+    }
+
+    memset(bitmap, 0, COVER_ART_BYTES);
+    for (int y = 0; y < COVER_ART_SIZE; y++) {
+        for (int x = 0; x < COVER_ART_SIZE; x++) {
+            int16_t *px = &gray[y * COVER_ART_SIZE + x];
+            int value = *px;
+            int lit = value >= 128 ? 255 : 0;
+            int error = value - lit;
+            if (lit) {
+                bitmap[(y / 8) * COVER_ART_SIZE + x] |= (uint8_t)(1u << (y % 8));
+            }
+            if (x + 1 < COVER_ART_SIZE) {
+                px[1] += (int16_t)(error * 7 / 16);
+            }
+            if (y + 1 < COVER_ART_SIZE) {
+                if (x > 0) {
+                    px[COVER_ART_SIZE - 1] += (int16_t)(error * 3 / 16);
+                }
+                px[COVER_ART_SIZE] += (int16_t)(error * 5 / 16);
+                if (x + 1 < COVER_ART_SIZE) {
+                    px[COVER_ART_SIZE + 1] += (int16_t)(error / 16);
+                }
+            }
+        }
+    }
+}
+
+/* Download consumer: decode the picture while it streams in */
+static esp_err_t decode_picture(music_assistant_stream_t *stream, int content_length, void *arg)
+{
+    decode_context_t *ctx = (decode_context_t *)arg;
+    JDEC jd;
+
+    ctx->stream = stream;
+    JRESULT res = jd_prepare(&jd, jpeg_input, ctx->work, sizeof(ctx->work), ctx);
+    if (res != JDR_OK) {
+        /* PNG, progressive JPEG and the like end up here */
+        ESP_LOGW(TAG, "Picture not decodable (tjpgd error %d, %d bytes)", res, content_length);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    /* Largest reduction (1/1 .. 1/8) that still leaves a full thumbnail */
+    uint32_t side = jd.width < jd.height ? jd.width : jd.height;
+    uint8_t scale = 0;
+    while (scale < 3 && (side >> (scale + 1)) >= COVER_ART_SIZE) {
+        scale++;
+    }
+    uint32_t width = jd.width >> scale;
+    uint32_t height = jd.height >> scale;
+    ctx->crop_side = side >> scale;
+    if (ctx->crop_side == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ctx->crop_x = (width - ctx->crop_side) / 2;
+    ctx->crop_y = (height - ctx->crop_side) / 2;
+
+    res = jd_decomp(&jd, jpeg_output, scale);
+    if (res != JDR_OK) {
+        ESP_LOGW(TAG, "Decoding %ux%u picture failed (tjpgd error %d)", jd.width, jd.height, res);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Decoded %ux%u picture at 1/%d, %lu bytes",
+             jd.width, jd.height, 1 << scale, (unsigned long)ctx->bytes);
+    return ESP_OK;
+}
+
+/* Fetch, decode and store the picture of the cover on screen, then post it */
+static bool fetch_cover(const char *picture)
+{
+    decode_context_t *ctx = calloc(1, sizeof(*ctx));
+    if (ctx == NULL) {
+        ESP_LOGE(TAG, "No memory for decoding");
+        return false;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = music_assistant_fetch_picture(picture, decode_picture, ctx);
+    uint8_t bitmap[COVER_ART_BYTES];
+    if (err == ESP_OK) {
+        dither(ctx, bitmap);
+    }
+    uint32_t decode_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+
+    portENTER_CRITICAL(&s_metrics_lock);
+    s_metrics.downloads++;
+    s_metrics.download_bytes += ctx->bytes;
+    if (err == ESP_OK) {
+        s_metrics.last_decode_ms = decode_ms;
+        if (decode_ms > s_metrics.max_decode_ms) {
+            s_metrics.max_decode_ms = decode_ms;
+        }
+    } else {
+        s_metrics.decode_failures++;
+    }
+    portEXIT_CRITICAL(&s_metrics_lock);
+    free(ctx);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No cover for '%s': %s", s_current_key, esp_err_to_name(err));
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Cover for '%s' ready in %lu ms", s_current_key, (unsigned long)decode_ms);
+    post_cover(bitmap);
+    store_cover(s_current_key, bitmap);
+    return true;
+}
+
+static void handle_request(const cover_request_t *req)
+{
+    if (strcmp(req->media_id, s_current_key) != 0) {
+        memcpy(s_current_key, req->media_id, sizeof(s_current_key));
+        bool hit = load_cover(s_current_key);
+
+        portENTER_CRITICAL(&s_metrics_lock);
+        s_metrics.lookups++;
+        if (hit) {
+            s_metrics.hits++;
+        }
+        portEXIT_CRITICAL(&s_metrics_lock);
+
+        if (hit) {
+            s_current_state = COVER_SHOWN;
+            return;
+        }
+        /* Do not leave the previous item's cover up */
+        post_cover(NULL);
+        s_current_state = COVER_MISSING;
+    }
+
+    if (s_current_state == COVER_MISSING && req->picture[0] != '\0') {
+        s_current_state = fetch_cover(req->picture) ? COVER_SHOWN : COVER_FAILED;
+    }
+}
+
+static void cover_art_task(void *arg)
+{
+    (void)arg;
+    cover_request_t req;
+
+    while (1) {
+        if (xQueueReceive(s_queue, &req, portMAX_DELAY) == pdTRUE) {
+            handle_request(&req);
+        }
+    }
+}
+
+/* Rebuild the RAM index from the slot headers */
+static void index_slots(void)
+{
+    cover_slot_t slot;
+
+    for (uint32_t i = 0; i < s_slot_count; i++) {
+        if (esp_partition_read(s_partition, (size_t)i * SECTOR_SIZE, &slot, sizeof(slot)) != ESP_OK ||
+            !slot_valid(&slot)) {
+            continue;
+        }
+        s_index[i] = (slot_index_t){ .used = true, .key_hash = slot.key_hash, .last_use = slot.seq };
+        if (slot.seq > s_use_clock) {
+            s_use_clock = slot.seq;
+        }
+        s_metrics.slots_used++;
+    }
+}
+
+esp_err_t cover_art_init(void)
+{
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, PARTITION_LABEL);
+    if (s_partition == NULL) {
+        ESP_LOGE(TAG, "Partition '%s' not found", PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_slot_count = s_partition->size / SECTOR_SIZE;
+    if (s_slot_count > MAX_SLOTS) {
+        s_slot_count = MAX_SLOTS;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    index_slots();
+    s_metrics.slots = s_slot_count;
+
+    /* One-slot mailbox: only the latest cover matters */
+    s_queue = xQueueCreate(1, sizeof(cover_request_t));
+    if (s_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(cover_art_task, "cover_art", COVER_TASK_STACK_SIZE, NULL,
+                    COVER_TASK_PRIORITY, &s_task) != pdPASS) {
+        vQueueDelete(s_queue);
+        s_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "%lu of %lu cover(s) on flash, indexed in %lu us",
+             (unsigned long)s_metrics.slots_used, (unsigned long)s_slot_count,
+             (unsigned long)(esp_timer_get_time() - start_us));
+    return ESP_OK;
+}
+
+esp_err_t cover_art_show(const char *media_id, const char *picture)
+{
+    if (media_id == NULL || media_id[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    cover_request_t req = {0};
+    strncpy(req.media_id, media_id, sizeof(req.media_id) - 1);
+    if (picture) {
+        strncpy(req.picture, picture, sizeof(req.picture) - 1);
+    }
+    xQueueOverwrite(s_queue, &req);
+    return ESP_OK;
+}
+
+void cover_art_get_metrics(cover_art_metrics_t *metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_metrics_lock);
+    *metrics = s_metrics;
+    portEXIT_CRITICAL(&s_metrics_lock);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @file cover_art.h
+ * @brief Cover art thumbnails, cached on flash
+ *
+ * The picture of a media item is downloaded once from Home Assistant's
+ * entity_picture proxy, decoded while it streams in (baseline JPEG, ROM
+ * TJpgDec), cropped to a square, box-downscaled to COVER_ART_SIZE pixels
+ * and Floyd-Steinberg dithered to 1 bit. The result is stored on the
+ * "covers" data partition (see partitions.csv), one flash sector per
+ * thumbnail, keyed by media ID. Later requests for the same media ID are
+ * answered from flash without any network access.
+ *
+ * When the partition is full the least recently shown thumbnail is
+ * replaced. Recency is kept in RAM and seeded from the write order at boot,
+ * so showing a cover never costs a flash write.
+ *
+ * Lookups, downloads and decoding run in a low-priority cover task; results
+ * are posted as APP_EVENT_COVER_ART.
+ */
+
+/** Edge length of a thumbnail in pixels */
+#define COVER_ART_SIZE 32
+
+/** Thumbnail size in bytes: COVER_ART_SIZE / 8 pages of COVER_ART_SIZE columns, LSB on top */
+#define COVER_ART_BYTES (COVER_ART_SIZE * COVER_ART_SIZE / 8)
+
+/** Longest media ID used as a key, including the terminating NUL */
+#define COVER_ART_KEY_MAX 128
+
+typedef struct {
+    uint32_t slots;             /* Thumbnails the partition holds */
+    uint32_t slots_used;
+    uint32_t lookups;           /* Media IDs looked up (repeats of the shown one are not counted) */
+    uint32_t hits;              /* ... found on flash */
+    uint32_t downloads;         /* Pictures fetched after a miss */
+    uint32_t download_bytes;
+    uint32_t decode_failures;   /* Failed downloads and undecodable pictures */
+    uint32_t evictions;         /* Thumbnails replaced to make room */
+    uint32_t last_decode_ms;    /* Download, decode and dither of the last picture */
+    uint32_t max_decode_ms;
+    uint32_t last_load_us;      /* Flash read of the last hit */
+} cover_art_metrics_t;
+
+/**
+ * @brief Mount the partition, index its thumbnails and start the cover task
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the partition is missing,
+ *         ESP_ERR_NO_MEM if the task could not be created
+ */
+esp_err_t cover_art_init(void);
+
+/**
+ * @brief Show the cover of a media item
+ *
+ * Posts APP_EVENT_COVER_ART with the thumbnail if it is on flash. Otherwise
+ * a blank cover is posted and, if picture is given, the picture is fetched,
+ * stored and then posted. Asking again for the cover on screen costs
+ * nothing, so this can be called on every player state update.
+ *
+ * Returns immediately; the work is done by the cover task. Only the latest
+ * request is kept, so a burst of updates costs one lookup.
+ *
+ * @param media_id Key, e.g. the media ID of the card; cut to COVER_ART_KEY_MAX - 1 bytes
+ * @param picture  entity_picture path on the Home Assistant host, or NULL/empty if not known yet
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an empty media_id,
+ *         ESP_ERR_INVALID_STATE if cover_art_init() has not succeeded
+ */
+esp_err_t cover_art_show(const char *media_id, const char *picture);
+
+/**
+ * @brief Copy the cache and decode counters
+ */
+void cover_art_get_metrics(cover_art_metrics_t *metrics);
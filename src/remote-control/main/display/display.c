@@ -1,10 +1,319 @@
 #include "display.h"
+#include <stdio.h>
+#include <string.h>
 #include "board_pins.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/spi_master.h"
+#include "common/config.h"
+#include "text.h"
 
 static const char *TAG = "DISPLAY";
 
+#define DISPLAY_TASK_STACK_SIZE 4096
+#define DISPLAY_TASK_PRIORITY 4
+
+typedef enum {
+    DISPLAY_REQ_TEXT,
+    DISPLAY_REQ_CLEAR,
+    DISPLAY_REQ_NOW_PLAYING,
+} display_request_type_t;
+
+/* Each request describes a whole screen, so only the latest one matters */
+typedef struct {
+    display_request_type_t type;
+    uint32_t seq;                               /* Set by submit(); gaps are coalesced requests */
+    int64_t submitted_us;
+    union {
+        struct {
+            char line1[DISPLAY_LINE_MAX];
+            char line2[DISPLAY_LINE_MAX];
+        } text;                                 /* DISPLAY_REQ_TEXT */
+        display_now_playing_t now_playing;      /* DISPLAY_REQ_NOW_PLAYING */
+    };
+} display_request_t;
+
+/* Address command sent in front of every page range */
+#define PAGE_ADDRESS_BYTES 3
+
+/* Now-playing layout: status row, title, time, progress bar on the last page */
+#define NOW_PLAYING_TITLE_Y     20
+#define NOW_PLAYING_TIME_Y      40
+#define NOW_PLAYING_BAR_Y       56
+#define NOW_PLAYING_COVER_Y     16      /* Cover on pages 2-5, left of title and time */
+#define NOW_PLAYING_COVER_GAP   4
+
+static const uint8_t ICON_PLAY[] = { 0x7F, 0x3E, 0x1C, 0x08 };
+static const uint8_t ICON_PAUSE[] = { 0x7F, 0x7F, 0x00, 0x7F, 0x7F };
+
+/* Marquee position after a screen has been up for shown_ms; sets *next_ms to the next step */
+static uint32_t marquee_scroll(uint32_t shown_ms, uint32_t *next_ms)
+{
+    if (shown_ms < DISPLAY_MARQUEE_HOLD_MS) {
+        *next_ms = DISPLAY_MARQUEE_HOLD_MS - shown_ms;
+        return 0;
+    }
+    uint32_t moving_ms = shown_ms - DISPLAY_MARQUEE_HOLD_MS;
+    *next_ms = DISPLAY_MARQUEE_STEP_MS - moving_ms % DISPLAY_MARQUEE_STEP_MS;
+    return moving_ms / DISPLAY_MARQUEE_STEP_MS * DISPLAY_MARQUEE_STEP_PX;
+}
+
+static void format_time(char *buf, size_t size, uint32_t seconds)
+{
+    snprintf(buf, size, "%lu:%02lu", (unsigned long)(seconds / 60), (unsigned long)(seconds % 60));
+}
+
+static void draw_progress_bar(framebuffer_t *fb, int y, float fraction)
+{
+    uint8_t columns[FB_WIDTH];
+    int fill = 1 + (int)(fraction * (FB_WIDTH - 2));
+
+    for (int x = 0; x < FB_WIDTH; x++) {
+        bool edge = x == 0 || x == FB_WIDTH - 1;
+        columns[x] = (edge || x < fill) ? 0x7E : 0x42;
+    }
+    fb_blit(fb, 0, y, columns, FB_WIDTH);
+}
+
+/*
+ * Draw the now-playing screen. The position is extrapolated from the anchor
+ * in the request, so keeping the time and bar current costs no request; the
+ * next refresh is due when the displayed second changes.
+ */
+static uint32_t render_now_playing(framebuffer_t *fb, const display_now_playing_t *np,
+                                   int64_t now_us, uint32_t shown_ms)
+{
+    uint32_t refresh_ms = 0;
+    char buf[24];
+
+    if (np->playing) {
+        fb_blit(fb, 0, 0, ICON_PLAY, sizeof(ICON_PLAY));
+    } else {
+        fb_blit(fb, 0, 0, ICON_PAUSE, sizeof(ICON_PAUSE));
+    }
+    text_draw(fb, 8, 0, FB_WIDTH - 8, np->playing ? "Spielt" : "Pause", 0);
+    if (np->volume >= 0) {
+        snprintf(buf, sizeof(buf), "Vol %d%%", np->volume);
+        int width = text_width(buf);
+        text_draw(fb, FB_WIDTH - width, 0, width, buf, 0);
+    }
+
+    int text_x = 0;
+    if (np->has_cover) {
+        for (int page = 0; page < DISPLAY_COVER_SIZE / 8; page++) {
+            fb_blit(fb, 0, NOW_PLAYING_COVER_Y + page * 8,
+                    &np->cover[page * DISPLAY_COVER_SIZE], DISPLAY_COVER_SIZE);
+        }
+        text_x = DISPLAY_COVER_SIZE + NOW_PLAYING_COVER_GAP;
+    }
+
+    uint32_t marquee_ms = 0;
+    uint32_t scroll = marquee_scroll(shown_ms, &marquee_ms);
+    const char *title = np->title[0] != '\0' ? np->title : "…";
+    if (text_draw(fb, text_x, NOW_PLAYING_TITLE_Y, FB_WIDTH - text_x, title, scroll)) {
+        refresh_ms = marquee_ms;
+    }
+
+    if (np->position < 0.0f) {
+        text_draw(fb, text_x, NOW_PLAYING_TIME_Y, FB_WIDTH - text_x, "--:--", 0);
+        return refresh_ms;
+    }
+
+    int64_t position_ms = (int64_t)(np->position * 1000.0f);
+    if (np->playing) {
+        position_ms += (now_us - np->anchor_us) / 1000;
+    }
+    int64_t duration_ms = (int64_t)(np->duration * 1000.0f);
+    if (duration_ms > 0 && position_ms > duration_ms) {
+        position_ms = duration_ms;
+    }
+
+    format_time(buf, sizeof(buf), (uint32_t)(position_ms / 1000));
+    if (duration_ms > 0) {
+        size_t len = strlen(buf);
+        snprintf(buf + len, sizeof(buf) - len, " / ");
+        format_time(buf + len + 3, sizeof(buf) - len - 3, (uint32_t)(duration_ms / 1000));
+        draw_progress_bar(fb, NOW_PLAYING_BAR_Y, (float)position_ms / (float)duration_ms);
+    }
+    text_draw(fb, text_x, NOW_PLAYING_TIME_Y, FB_WIDTH - text_x, buf, 0);
+
+    if (np->playing && (duration_ms == 0 || position_ms < duration_ms)) {
+        uint32_t second_ms = 1000 - (uint32_t)(position_ms % 1000);
+        if (refresh_ms == 0 || second_ms < refresh_ms) {
+            refresh_ms = second_ms;
+        }
+    }
+    return refresh_ms;
+}
+
+/*
+ * Draw a screen that has been up for shown_ms. Returns the delay until it
+ * needs redrawing (marquee step, progress tick), or 0 if it is static.
+ */
+static uint32_t render(display_t *display, const display_request_t *req, int64_t now_us, uint32_t shown_ms)
+{
+    framebuffer_t *next = &display->next;
+    uint32_t refresh_ms = 0;
+
+    fb_clear(next);
+    switch (req->type) {
+        case DISPLAY_REQ_TEXT: {
+            uint32_t marquee_ms = 0;
+            uint32_t scroll = marquee_scroll(shown_ms, &marquee_ms);
+            bool scrolling = false;
+            text_draw(next, 0, 0, FB_WIDTH, "RFID SCANNER", 0);
+            scrolling |= text_draw(next, 0, 20, FB_WIDTH, req->text.line1, scroll);
+            scrolling |= text_draw(next, 0, 40, FB_WIDTH, req->text.line2, scroll);
+            refresh_ms = scrolling ? marquee_ms : 0;
+            break;
+        }
+        case DISPLAY_REQ_NOW_PLAYING:
+            refresh_ms = render_now_playing(next, &req->now_playing, now_us, shown_ms);
+            break;
+        case DISPLAY_REQ_CLEAR:
+        default:
+            break;
+    }
+    return refresh_ms;
+}
+
+/*
+ * Send only the column ranges that differ from the shadow buffer. The
+ * transfers are queued and run while the task goes back to waiting; the
+ * shadow buffer they read from is not touched before they have finished.
+ *
+ * Returns the number of bytes queued on the SPI bus.
+ */
+static uint32_t flush(display_t *display)
+{
+    fb_dirty_range_t ranges[FB_PAGES];
+
+    ssd1306_spi_wait(&display->panel);
+
+    if (display->shown_valid) {
+        fb_diff(&display->shown, &display->next, ranges);
+    } else {
+        /* Panel RAM content is unknown after reset: send everything once */
+        for (int page = 0; page < FB_PAGES; page++) {
+            ranges[page] = (fb_dirty_range_t){ .dirty = true, .first = 0, .last = FB_WIDTH - 1 };
+        }
+        display->shown_valid = true;
+    }
+    memcpy(&display->shown, &display->next, sizeof(display->shown));
+
+    uint32_t bytes = 0;
+    for (int page = 0; page < FB_PAGES; page++) {
+        if (!ranges[page].dirty) {
+            continue;
+        }
+        size_t len = ranges[page].last - ranges[page].first + 1;
+        esp_err_t err = ssd1306_spi_write(&display->panel, page, ranges[page].first,
+                                          &display->shown.pages[page][ranges[page].first], len);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Page %d write failed: %s", page, esp_err_to_name(err));
+            display->shown_valid = false;   /* Resend everything next frame */
+            continue;
+        }
+        bytes += PAGE_ADDRESS_BYTES + len;
+    }
+    return bytes;
+}
+
+static void display_task(void *arg)
+{
+    display_t *display = (display_t *)arg;
+    display_request_t req;
+    display_request_t incoming;
+    TickType_t last_frame = xTaskGetTickCount() - pdMS_TO_TICKS(DISPLAY_MIN_FRAME_MS);
+    int64_t shown_since_us = 0;
+    TickType_t wait = portMAX_DELAY;
+    uint32_t last_seq = 0;
+
+    while (1) {
+        /* A timeout means the current screen is due for a redraw (marquee, progress) */
+        bool is_new = xQueueReceive(display->queue, &incoming, wait) == pdTRUE;
+        if (is_new) {
+            req = incoming;
+        } else if (wait == portMAX_DELAY) {
+            continue;
+        }
+
+        /* Frame-rate cap: newer requests overwrite this one while we wait */
+        TickType_t elapsed = xTaskGetTickCount() - last_frame;
+        if (is_new && elapsed < pdMS_TO_TICKS(DISPLAY_MIN_FRAME_MS)) {
+            vTaskDelay(pdMS_TO_TICKS(DISPLAY_MIN_FRAME_MS) - elapsed);
+            display_request_t newer;
+            if (xQueueReceive(display->queue, &newer, 0) == pdTRUE) {
+                req = newer;
+            }
+        }
+
+        /* Every request between the last one drawn and this one was replaced unseen */
+        uint32_t skipped = 0;
+        if (is_new) {
+            skipped = req.seq > last_seq ? req.seq - last_seq - 1 : 0;
+            last_seq = req.seq;
+        }
+
+        int64_t started_us = esp_timer_get_time();
+        if (is_new) {
+            shown_since_us = started_us;
+        }
+        uint32_t refresh_ms = render(display, &req, started_us,
+                                     (uint32_t)((started_us - shown_since_us) / 1000));
+        int64_t rendered_us = esp_timer_get_time();
+        uint32_t bytes = flush(display);
+        int64_t finished_us = esp_timer_get_time();
+        last_frame = xTaskGetTickCount();
+        if (refresh_ms == 0) {
+            wait = portMAX_DELAY;
+        } else {
+            wait = pdMS_TO_TICKS(refresh_ms);
+            if (wait == 0) {
+                wait = 1;
+            }
+        }
+
+        uint32_t frame_us = (uint32_t)(finished_us - started_us);
+        uint32_t render_us = (uint32_t)(rendered_us - started_us);
+        uint32_t latency_ms = is_new ? (uint32_t)((finished_us - req.submitted_us) / 1000) : 0;
+        text_metrics_t text_metrics;
+        text_get_metrics(&text_metrics);
+
+        portENTER_CRITICAL(&display->lock);
+        display->metrics.frames++;
+        display->metrics.coalesced += skipped;
+        if (!is_new) {
+            display->metrics.refresh_frames++;
+        }
+        display->metrics.last_frame_us = frame_us;
+        display->metrics.last_render_us = render_us;
+        display->metrics.text_lookups = text_metrics.lookups;
+        display->metrics.text_cache_hits = text_metrics.hits;
+        display->metrics.last_frame_bytes = bytes;
+        display->metrics.bytes_sent += bytes;
+        if (bytes == 0) {
+            display->metrics.unchanged_frames++;
+        }
+        if (frame_us > display->metrics.max_frame_us) {
+            display->metrics.max_frame_us = frame_us;
+        }
+        if (latency_ms > display->metrics.max_latency_ms) {
+            display->metrics.max_latency_ms = latency_ms;
+        }
+        portEXIT_CRITICAL(&display->lock);
+    }
+}
+
+static void submit(display_t *display, display_request_t *req)
+{
+    portENTER_CRITICAL(&display->lock);
+    req->seq = ++display->metrics.requests;
+    portEXIT_CRITICAL(&display->lock);
+
+    xQueueOverwrite(display->queue, req);
+}
+
 esp_err_t display_init(display_t *display)
 {
     if (!display) {
@@ -28,32 +337,42 @@ esp_err_t display_init(display_t *display)
         return ret;
     }
 
-    ssd1306_config_t cfg = {
-        .bus = SSD1306_SPI,
-        .width = 128,
-        .height = 64,
-        .iface.spi = {
-            .host = BOARD_OLED_SPI_HOST,
-            .cs_gpio = BOARD_OLED_PIN_CS,
-            .dc_gpio = BOARD_OLED_PIN_DC,
-            .rst_gpio = BOARD_OLED_PIN_RST,
-            .clk_hz = BOARD_OLED_SPI_FREQ_HZ,
-        },
+    ssd1306_spi_config_t cfg = {
+        .host = BOARD_OLED_SPI_HOST,
+        .cs_gpio = BOARD_OLED_PIN_CS,
+        .dc_gpio = BOARD_OLED_PIN_DC,
+        .rst_gpio = BOARD_OLED_PIN_RST,
+        .clk_hz = BOARD_OLED_SPI_FREQ_HZ,
     };
 
-    ret = ssd1306_new_spi(&cfg, &display->handle);
+    ret = ssd1306_spi_init(&display->panel, &cfg);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "OLED init failed: %s", esp_err_to_name(ret));
         return ret;
     }
 
+    portMUX_INITIALIZE(&display->lock);
+    display->queue = xQueueCreate(1, sizeof(display_request_t));
+    if (display->queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create display queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(display_task, "display", DISPLAY_TASK_STACK_SIZE, display,
+                    DISPLAY_TASK_PRIORITY, &display->task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create display task");
+        vQueueDelete(display->queue);
+        display->queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
     ESP_LOGI(TAG, "Display initialized successfully");
     return ESP_OK;
 }
 
 void display_show(display_t *display, const char *line1, const char *line2)
 {
-    if (!display || !display->handle) {
+    if (!display || !display->queue) {
         ESP_LOGW(TAG, "Display not initialized");
         return;
     }
@@ -63,20 +382,48 @@ void display_show(display_t *display, const char *line1, const char *line2)
         return;
     }
 
-    ssd1306_clear(display->handle);
-    ssd1306_draw_text(display->handle, 0, 0, "RFID SCANNER", true);
-    ssd1306_draw_text(display->handle, 0, 20, (char *)line1, true);
-    ssd1306_draw_text(display->handle, 0, 40, (char *)line2, true);
-    ssd1306_display(display->handle);
+    display_request_t req = {
+        .type = DISPLAY_REQ_TEXT,
+        .submitted_us = esp_timer_get_time(),
+    };
+    text_copy(req.text.line1, sizeof(req.text.line1), line1);
+    text_copy(req.text.line2, sizeof(req.text.line2), line2);
+    submit(display, &req);
+}
+
+void display_show_now_playing(display_t *display, const display_now_playing_t *now_playing)
+{
+    if (!display || !display->queue || !now_playing) {
+        ESP_LOGW(TAG, "Display not initialized");
+        return;
+    }
+
+    display_request_t req = {
+        .type = DISPLAY_REQ_NOW_PLAYING,
+        .submitted_us = esp_timer_get_time(),
+        .now_playing = *now_playing,
+    };
+    text_copy(req.now_playing.title, sizeof(req.now_playing.title), now_playing->title);
+    submit(display, &req);
 }
 
 void display_clear(display_t *display)
 {
-    if (!display || !display->handle) {
+    if (!display || !display->queue) {
         ESP_LOGW(TAG, "Display not initialized");
         return;
     }
 
-    ssd1306_clear(display->handle);
-    ssd1306_display(display->handle);
+    display_request_t req = {
+        .type = DISPLAY_REQ_CLEAR,
+        .submitted_us = esp_timer_get_time(),
+    };
+    submit(display, &req);
+}
+
+void display_get_metrics(display_t *display, display_metrics_t *metrics)
+{
+    portENTER_CRITICAL(&display->lock);
+    *metrics = display->metrics;
+    portEXIT_CRITICAL(&display->lock);
 }
@@ -1,8 +1,15 @@
 #ifndef DISPLAY_H
 #define DISPLAY_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
-#include "ssd1306.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "framebuffer.h"
+#include "ssd1306_spi.h"
+#include "text.h"
 
 /**
  * @file display.h
@@ -10,14 +17,78 @@
  * 
  * This module encapsulates all SSD1306 display operations.
  * Initialization and low-level SPI configuration are hidden.
+ *
+ * The panel is owned by a display task: display_show() and display_clear()
+ * only post a render request and return. Requests go to a one-slot mailbox,
+ * so a burst of updates collapses to the latest screen, and the task redraws
+ * at most once every DISPLAY_MIN_FRAME_MS.
+ *
+ * Frames are drawn into a framebuffer and compared with a shadow copy of
+ * what the panel shows; only the changed column range of each 8-row page is
+ * sent, as queued DMA transfers the task does not wait for.
+ *
+ * Text is UTF-8 (German umlauts, ß) and rendered through the text cache.
+ * A line wider than the panel scrolls as a marquee after
+ * DISPLAY_MARQUEE_HOLD_MS; the task then redraws it every
+ * DISPLAY_MARQUEE_STEP_MS until the next request arrives. Screens that
+ * change by themselves (marquee, now-playing progress) are redrawn on the
+ * task's queue timeout, without any new request.
  */
 
+/** Longest text line in bytes (UTF-8), including the terminating NUL */
+#define DISPLAY_LINE_MAX TEXT_KEY_MAX
+
+/** Edge length of the cover thumbnail on the now-playing screen */
+#define DISPLAY_COVER_SIZE 32
+
+/** Cover thumbnail size in bytes, in framebuffer page layout */
+#define DISPLAY_COVER_BYTES (DISPLAY_COVER_SIZE * DISPLAY_COVER_SIZE / 8)
+
+typedef struct {
+    uint32_t requests;          /* display_show()/display_clear() calls */
+    uint32_t coalesced;         /* Requests replaced by a newer one before being drawn */
+    uint32_t frames;            /* Frames sent to the panel */
+    uint32_t refresh_frames;    /* Redraws of the same screen: marquee steps, progress ticks */
+    uint32_t unchanged_frames;  /* Frames identical to the panel content: nothing sent */
+    uint32_t last_render_us;    /* Time to draw the last frame into the framebuffer */
+    uint32_t last_frame_us;     /* Time to draw, diff and queue the last frame */
+    uint32_t max_frame_us;
+    uint32_t last_frame_bytes;  /* SPI bytes of the last frame (a full frame is 1048) */
+    uint32_t bytes_sent;
+    uint32_t text_lookups;      /* Strings drawn */
+    uint32_t text_cache_hits;   /* ... of which were already rendered */
+    uint32_t max_latency_ms;    /* Longest time from request to frame on the panel */
+} display_metrics_t;
+
+/**
+ * Content of the now-playing screen. The position is valid at anchor_us and
+ * is advanced locally while playing.
+ */
+typedef struct {
+    char title[DISPLAY_LINE_MAX];   /* UTF-8, scrolls if wider than the panel */
+    bool playing;
+    int volume;                     /* Percent, -1 to hide */
+    float position;                 /* Seconds at anchor_us, < 0 if unknown */
+    float duration;                 /* Seconds, 0 if unknown: no progress bar */
+    int64_t anchor_us;              /* esp_timer time */
+    bool has_cover;                 /* Title and time move right of the cover */
+    uint8_t cover[DISPLAY_COVER_BYTES];     /* Page-major, DISPLAY_COVER_SIZE columns per page */
+} display_now_playing_t;
+
+/* Must live in internal RAM: the shadow buffer is read by SPI DMA */
 typedef struct {
-    ssd1306_handle_t handle;
+    ssd1306_spi_t panel;
+    framebuffer_t shown;        /* What the panel shows (valid once shown_valid) */
+    framebuffer_t next;         /* Frame being drawn */
+    bool shown_valid;
+    QueueHandle_t queue;
+    TaskHandle_t task;
+    display_metrics_t metrics;
+    portMUX_TYPE lock;
 } display_t;
 
 /**
- * Initialize the OLED display on SPI2
+ * Initialize the OLED display on SPI2 and start its display task
  * 
  * @param display Pointer to display_t structure to initialize
  * @return ESP_OK on success, error code otherwise
@@ -31,13 +102,29 @@ esp_err_t display_init(display_t *display);
  * - Header: "RFID SCANNER"
  * - Line 1: First parameter
  * - Line 2: Second parameter
+ *
+ * Safe to call from any task, including event handlers: the text is copied
+ * and drawn later by the display task.
  * 
  * @param display Pointer to initialized display_t structure
- * @param line1 Text for first line (max 32 chars recommended)
- * @param line2 Text for second line (max 32 chars recommended)
+ * @param line1 UTF-8 text for first line, cut to DISPLAY_LINE_MAX - 1 bytes; scrolls if wider than the panel
+ * @param line2 UTF-8 text for second line, same rules as line1
  */
 void display_show(display_t *display, const char *line1, const char *line2);
 
+/**
+ * Show the now-playing screen: play state, volume, cover, title, time and a
+ * progress bar
+ *
+ * While playing, the display task redraws the time and bar about once a
+ * second from the position anchor; only those pages are sent. Replaced by
+ * the next display_show()/display_show_now_playing() call.
+ *
+ * @param display Pointer to initialized display_t structure
+ * @param now_playing Screen content; copied
+ */
+void display_show_now_playing(display_t *display, const display_now_playing_t *now_playing);
+
 /**
  * Clear the display completely
  * 
@@ -45,4 +132,12 @@ void display_show(display_t *display, const char *line1, const char *line2);
  */
 void display_clear(display_t *display);
 
+/**
+ * Copy the render counters of the display task
+ *
+ * @param display Pointer to initialized display_t structure
+ * @param metrics Destination
+ */
+void display_get_metrics(display_t *display, display_metrics_t *metrics);
+
 #endif /* DISPLAY_H */
@@ -1,16 +1,26 @@
 #include "display_controller.h"
 #include <stdbool.h>
+#include <string.h>
 #include "esp_event.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "common/config.h"
+#include "common/app_events.h"
+#include "music_assistant/music_assistant_client.h"
 
 static const char *TAG = "DISPLAY_CONTROLLER";
 
+_Static_assert(DISPLAY_COVER_BYTES == APP_COVER_ART_BYTES, "cover thumbnails differ in size");
+
 static display_t *s_display = NULL;
 static bool s_handlers_registered = false;
 
+/* Both arrive as events on the default loop; the screen combines the latest of each */
+static display_now_playing_t s_now_playing;
+static bool s_now_playing_shown = false;
+static app_cover_art_event_t s_cover;
+
 static void display_wifi_event_handler(void *arg,
 									   esp_event_base_t event_base,
 									   int32_t event_id,
@@ -21,21 +31,84 @@ static void display_wifi_event_handler(void *arg,
 	}
 
 	if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+		s_now_playing_shown = false;
 		display_show(s_display, DISPLAY_MSG_CONNECTING_WIFI);
 		return;
 	}
 
 	if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+		s_now_playing_shown = false;
 		display_show(s_display, DISPLAY_MSG_WIFI_FAILED);
 		return;
 	}
 
 	if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+		s_now_playing_shown = false;
 		display_show(s_display, DISPLAY_MSG_WIFI_CONNECTED);
 		return;
 	}
 }
 
+static void display_app_event_handler(void *arg,
+									  esp_event_base_t event_base,
+									  int32_t event_id,
+									  void *event_data)
+{
+	if (!s_display || event_base != APP_EVENTS) {
+		return;
+	}
+
+	if (event_id == APP_EVENT_PARENTAL_LIMIT_REACHED) {
+		s_now_playing_shown = false;
+		display_show(s_display, DISPLAY_MSG_PLAYTIME_OVER);
+		return;
+	}
+
+	if (event_id == APP_EVENT_NOW_PLAYING && event_data) {
+		const app_now_playing_event_t *event = (const app_now_playing_event_t *)event_data;
+		s_now_playing = (display_now_playing_t){
+			.playing = event->playing,
+			.volume = event->volume,
+			.position = event->position,
+			.duration = event->duration,
+			.anchor_us = event->anchor_us,
+			.has_cover = s_cover.present,
+		};
+		text_copy(s_now_playing.title, sizeof(s_now_playing.title), event->title);
+		memcpy(s_now_playing.cover, s_cover.bitmap, sizeof(s_now_playing.cover));
+		s_now_playing_shown = true;
+		display_show_now_playing(s_display, &s_now_playing);
+		return;
+	}
+
+	if (event_id == APP_EVENT_COVER_ART && event_data) {
+		s_cover = *(const app_cover_art_event_t *)event_data;
+		if (s_now_playing_shown) {
+			/* The position anchor is still valid, so the screen can be redrawn as is */
+			s_now_playing.has_cover = s_cover.present;
+			memcpy(s_now_playing.cover, s_cover.bitmap, sizeof(s_now_playing.cover));
+			display_show_now_playing(s_display, &s_now_playing);
+		}
+		return;
+	}
+
+	if (event_id != APP_EVENT_ERROR || !event_data) {
+		return;
+	}
+
+	const app_error_event_t *error = (const app_error_event_t *)event_data;
+	ESP_LOGI(TAG, "Error event: %s (0x%x)", error->error_message ? error->error_message : "", error->error_code);
+
+	/* Only the states a child can act on are shown; half-open probing stays silent */
+	if (error->error_code == ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_OPEN) {
+		s_now_playing_shown = false;
+		display_show(s_display, DISPLAY_MSG_SERVER_UNREACHABLE);
+	} else if (error->error_code == ESP_OK) {
+		s_now_playing_shown = false;
+		display_show(s_display, DISPLAY_MSG_SERVER_REACHABLE);
+	}
+}
+
 esp_err_t display_controller_init(display_t *display)
 {
 	if (!display) {
@@ -65,6 +138,26 @@ esp_err_t display_controller_init(display_t *display)
                                                         NULL,
                                                         &instance_got_ip));
 
+    ESP_ERROR_CHECK(esp_event_handler_register(APP_EVENTS,
+                                               APP_EVENT_ERROR,
+                                               &display_app_event_handler,
+                                               NULL));
+
+    ESP_ERROR_CHECK(esp_event_handler_register(APP_EVENTS,
+                                               APP_EVENT_PARENTAL_LIMIT_REACHED,
+                                               &display_app_event_handler,
+                                               NULL));
+
+    ESP_ERROR_CHECK(esp_event_handler_register(APP_EVENTS,
+                                               APP_EVENT_NOW_PLAYING,
+                                               &display_app_event_handler,
+                                               NULL));
+
+    ESP_ERROR_CHECK(esp_event_handler_register(APP_EVENTS,
+                                               APP_EVENT_COVER_ART,
+                                               &display_app_event_handler,
+                                               NULL));
+
 	s_handlers_registered = true;
 	ESP_LOGI(TAG, "Display controller initialized");
 	return ESP_OK;
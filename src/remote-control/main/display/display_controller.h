@@ -6,6 +6,7 @@
 
 /**
  * Controls the display by subscribing to WiFi connection events and updating the display accordingly.
+ * APP_EVENT_NOW_PLAYING switches to the now-playing screen.
  */
 
 /**
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @file font.h
+ * @brief 5x7 bitmap font used by the text renderer
+ *
+ * Covers printable ASCII plus the Latin-1 letters our titles and messages
+ * need (German umlauts and ß, é, °) and the ellipsis. Glyph data is const
+ * and stays in flash.
+ */
+
+#define FONT_FIRST_CHAR     0x20
+#define FONT_GLYPH_COUNT    95
+#define FONT_GLYPH_WIDTH    5
+#define FONT_GLYPH_HEIGHT   8       /* 7 rows + 1 row of descender space */
+#define FONT_ADVANCE        (FONT_GLYPH_WIDTH + 1)
+
+extern const uint8_t font_5x7[FONT_GLYPH_COUNT][FONT_GLYPH_WIDTH];
+
+/**
+ * @brief Column bytes of a Unicode code point; code points without a glyph map to '?'
+ */
+const uint8_t *font_glyph(uint32_t codepoint);
@@ -0,0 +1,66 @@
+#include "framebuffer.h"
+
+#include <string.h>
+
+void fb_clear(framebuffer_t *fb)
+{
+    memset(fb->pages, 0, sizeof(fb->pages));
+}
+
+void fb_blit(framebuffer_t *fb, int x, int y, const uint8_t *columns, int count)
+{
+    if (y <= -8 || y >= FB_HEIGHT) {
+        return;
+    }
+    if (x < 0) {
+        columns -= x;
+        count += x;
+        x = 0;
+    }
+    if (count > FB_WIDTH - x) {
+        count = FB_WIDTH - x;
+    }
+
+    int page = y >> 3;      /* Arithmetic shift: -1 for y in -7..-1 */
+    int shift = y & 7;
+    uint8_t *upper = page >= 0 ? &fb->pages[page][x] : NULL;
+    uint8_t *lower = (shift != 0 && page + 1 < FB_PAGES) ? &fb->pages[page + 1][x] : NULL;
+
+    for (int i = 0; i < count; i++) {
+        if (upper) {
+            upper[i] |= (uint8_t)(columns[i] << shift);
+        }
+        if (lower) {
+            lower[i] |= (uint8_t)(columns[i] >> (8 - shift));
+        }
+    }
+}
+
+uint32_t fb_diff(const framebuffer_t *shown, const framebuffer_t *next, fb_dirty_range_t ranges[FB_PAGES])
+{
+    uint32_t bytes = 0;
+
+    for (int page = 0; page < FB_PAGES; page++) {
+        const uint8_t *a = shown->pages[page];
+        const uint8_t *b = next->pages[page];
+        int first = 0;
+        int last = FB_WIDTH - 1;
+
+        while (first < FB_WIDTH && a[first] == b[first]) {
+            first++;
+        }
+        if (first == FB_WIDTH) {
+            ranges[page].dirty = false;
+            continue;
+        }
+        while (a[last] == b[last]) {
+            last--;
+        }
+
+        ranges[page].dirty = true;
+        ranges[page].first = (uint8_t)first;
+        ranges[page].last = (uint8_t)last;
+        bytes += (uint32_t)(last - first + 1);
+    }
+    return bytes;
+}
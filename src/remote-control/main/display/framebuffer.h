@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @file framebuffer.h
+ * @brief 128x64 monochrome framebuffer in SSD1306 page layout
+ *
+ * The buffer is organised like the panel's RAM: FB_PAGES pages of FB_WIDTH
+ * column bytes, bit 0 of each byte being the top row of the page. This lets
+ * a dirty column range be sent to the panel without any conversion.
+ *
+ * Plain C with no ESP-IDF dependencies.
+ */
+
+#define FB_WIDTH    128
+#define FB_HEIGHT   64
+#define FB_PAGES    (FB_HEIGHT / 8)
+
+typedef struct {
+    uint8_t pages[FB_PAGES][FB_WIDTH];
+} framebuffer_t;
+
+/** Columns first..last (inclusive) of one page differ from what is shown */
+typedef struct {
+    bool dirty;
+    uint8_t first;
+    uint8_t last;
+} fb_dirty_range_t;
+
+/**
+ * @brief Clear all pixels
+ */
+void fb_clear(framebuffer_t *fb);
+
+/**
+ * @brief OR a run of 8 px column bytes into the buffer, top-left corner at (x, y)
+ *
+ * y need not be a multiple of 8; columns straddling two pages are split.
+ * Anything outside the buffer is clipped.
+ */
+void fb_blit(framebuffer_t *fb, int x, int y, const uint8_t *columns, int count);
+
+/**
+ * @brief Compare two frames page by page
+ *
+ * @param shown  Frame currently on the panel
+ * @param next   Frame to show
+ * @param ranges Per page, the column range that has to be sent
+ * @return Column bytes covered by the dirty ranges, 0 if the frames are identical
+ */
+uint32_t fb_diff(const framebuffer_t *shown, const framebuffer_t *next, fb_dirty_range_t ranges[FB_PAGES]);
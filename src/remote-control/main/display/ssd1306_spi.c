@@ -0,0 +1,151 @@
+#include "ssd1306_spi.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "driver/gpio.h"
+
+static const char *TAG = "SSD1306";
+
+#define RESET_PULSE_MS 10
+
+/* 128x64, internal charge pump, page addressing, segment/COM remapped so (0,0) is top left */
+static const uint8_t INIT_SEQUENCE[] = {
+    0xAE,           /* Display off */
+    0xD5, 0x80,     /* Clock divide ratio / oscillator frequency */
+    0xA8, 0x3F,     /* Multiplex ratio: 64 rows */
+    0xD3, 0x00,     /* Display offset */
+    0x40,           /* Start line 0 */
+    0x8D, 0x14,     /* Charge pump on */
+    0x20, 0x02,     /* Page addressing mode */
+    0xA1,           /* Segment remap */
+    0xC8,           /* COM scan direction remapped */
+    0xDA, 0x12,     /* COM pins: alternative configuration */
+    0x81, 0xCF,     /* Contrast */
+    0xD9, 0xF1,     /* Pre-charge period */
+    0xDB, 0x40,     /* VCOMH deselect level */
+    0xA4,           /* Display follows RAM */
+    0xA6,           /* Normal (not inverted) */
+    0xAF,           /* Display on */
+};
+
+/* Runs in the SPI ISR right before a transaction starts */
+static void IRAM_ATTR set_dc_level(spi_transaction_t *t)
+{
+    const ssd1306_spi_dc_t *dc = (const ssd1306_spi_dc_t *)t->user;
+    gpio_set_level(dc->gpio, dc->level);
+}
+
+esp_err_t ssd1306_spi_init(ssd1306_spi_t *panel, const ssd1306_spi_config_t *config)
+{
+    memset(panel, 0, sizeof(*panel));
+    panel->dc_command = (ssd1306_spi_dc_t){ .gpio = config->dc_gpio, .level = 0 };
+    panel->dc_data = (ssd1306_spi_dc_t){ .gpio = config->dc_gpio, .level = 1 };
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << config->dc_gpio) | (1ULL << config->rst_gpio),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    esp_err_t ret = gpio_config(&io_conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "GPIO config failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    spi_device_interface_config_t devcfg = {
+        .mode = 0,
+        .clock_speed_hz = config->clk_hz,
+        .spics_io_num = config->cs_gpio,
+        .queue_size = SSD1306_SPI_QUEUE_SIZE,
+        .pre_cb = set_dc_level,
+    };
+    ret = spi_bus_add_device(config->host, &devcfg, &panel->device);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Adding SPI device failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    gpio_set_level(config->rst_gpio, 0);
+    vTaskDelay(pdMS_TO_TICKS(RESET_PULSE_MS));
+    gpio_set_level(config->rst_gpio, 1);
+    vTaskDelay(pdMS_TO_TICKS(RESET_PULSE_MS));
+
+    /* Copied to the stack: the constant lives in flash, which DMA cannot read */
+    uint8_t sequence[sizeof(INIT_SEQUENCE)];
+    memcpy(sequence, INIT_SEQUENCE, sizeof(sequence));
+
+    spi_transaction_t t = {
+        .length = sizeof(sequence) * 8,
+        .tx_buffer = sequence,
+        .user = &panel->dc_command,
+    };
+    ret = spi_device_polling_transmit(panel->device, &t);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Init sequence failed: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+esp_err_t ssd1306_spi_write(ssd1306_spi_t *panel, int page, int column, const uint8_t *data, size_t len)
+{
+    if (page < 0 || page >= FB_PAGES || column < 0 || len == 0 || column + len > FB_WIDTH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (panel->in_flight + 2 > SSD1306_SPI_QUEUE_SIZE) {
+        esp_err_t ret = ssd1306_spi_wait(panel);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    spi_transaction_t *address = &panel->trans[panel->in_flight];
+    spi_transaction_t *pixels = &panel->trans[panel->in_flight + 1];
+
+    *address = (spi_transaction_t){
+        .flags = SPI_TRANS_USE_TXDATA,
+        .length = 3 * 8,
+        .user = &panel->dc_command,
+    };
+    address->tx_data[0] = (uint8_t)(0xB0 | page);           /* Page start */
+    address->tx_data[1] = (uint8_t)(column & 0x0F);         /* Column, low nibble */
+    address->tx_data[2] = (uint8_t)(0x10 | (column >> 4));  /* Column, high nibble */
+
+    *pixels = (spi_transaction_t){
+        .length = len * 8,
+        .tx_buffer = data,
+        .user = &panel->dc_data,
+    };
+
+    esp_err_t ret = spi_device_queue_trans(panel->device, address, portMAX_DELAY);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    panel->in_flight++;
+
+    ret = spi_device_queue_trans(panel->device, pixels, portMAX_DELAY);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    panel->in_flight++;
+    return ESP_OK;
+}
+
+esp_err_t ssd1306_spi_wait(ssd1306_spi_t *panel)
+{
+    while (panel->in_flight > 0) {
+        spi_transaction_t *done;
+        esp_err_t ret = spi_device_get_trans_result(panel->device, &done, portMAX_DELAY);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Transfer failed: %s", esp_err_to_name(ret));
+            return ret;
+        }
+        panel->in_flight--;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/spi_master.h"
+#include "framebuffer.h"
+
+/**
+ * @file ssd1306_spi.h
+ * @brief Minimal SSD1306 driver that writes page ranges with queued DMA transfers
+ *
+ * The panel runs in page addressing mode, so any column range of one 8-row
+ * page can be written with a three-byte address command followed by the
+ * pixel data. Writes are queued on the SPI device and return immediately;
+ * ssd1306_spi_wait() collects the finished transfers. Data buffers must stay
+ * untouched until then and must be DMA-capable (internal RAM, not flash).
+ *
+ * Not thread-safe: the display task is the only caller.
+ */
+
+/** Two transactions (address command + data) per page */
+#define SSD1306_SPI_QUEUE_SIZE (2 * FB_PAGES)
+
+typedef struct {
+    spi_host_device_t host;
+    int cs_gpio;
+    int dc_gpio;
+    int rst_gpio;
+    int clk_hz;
+} ssd1306_spi_config_t;
+
+/* Level of the D/C pin for a transaction, applied in the pre-transfer callback */
+typedef struct {
+    int gpio;
+    int level;
+} ssd1306_spi_dc_t;
+
+typedef struct {
+    spi_device_handle_t device;
+    ssd1306_spi_dc_t dc_command;
+    ssd1306_spi_dc_t dc_data;
+    spi_transaction_t trans[SSD1306_SPI_QUEUE_SIZE];
+    int in_flight;
+} ssd1306_spi_t;
+
+/**
+ * @brief Reset the panel, add it to an initialized SPI bus and switch it on
+ *
+ * @return ESP_OK, or the error of the SPI/GPIO call that failed
+ */
+esp_err_t ssd1306_spi_init(ssd1306_spi_t *panel, const ssd1306_spi_config_t *config);
+
+/**
+ * @brief Queue a write of len column bytes to one page, starting at column
+ *
+ * Waits for earlier transfers only if the device queue is full.
+ */
+esp_err_t ssd1306_spi_write(ssd1306_spi_t *panel, int page, int column, const uint8_t *data, size_t len);
+
+/**
+ * @brief Wait until all queued writes have been sent
+ */
+esp_err_t ssd1306_spi_wait(ssd1306_spi_t *panel);
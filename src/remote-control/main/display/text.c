@@ -0,0 +1,173 @@
+#include "text.h"
+
+#include <string.h>
+
+#include "font.h"
+#include "common/config.h"
+
+typedef struct {
+    bool used;
+    uint32_t hash;
+    uint32_t last_use;
+    char key[TEXT_KEY_MAX];
+    uint8_t len;
+    uint16_t width;
+    uint8_t columns[TEXT_MAX_WIDTH];
+} text_strip_t;
+
+static text_strip_t s_cache[TEXT_CACHE_SIZE];
+static uint32_t s_use_counter = 0;
+static text_metrics_t s_metrics;
+
+/* FNV-1a over the bytes that make up the key */
+static uint32_t hash_key(const char *key, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Length of the key for text: at most TEXT_KEY_MAX - 1 bytes, cut on a character boundary */
+static size_t key_length(const char *text, size_t size)
+{
+    size_t len = strnlen(text, size - 1);
+    if (text[len] != '\0') {
+        /* Cut before the sequence that did not fit */
+        while (len > 0 && ((uint8_t)text[len] & 0xC0) == 0x80) {
+            len--;
+        }
+    }
+    return len;
+}
+
+/* Decode one UTF-8 sequence; malformed input yields '?' and skips one byte */
+static uint32_t next_codepoint(const char **text)
+{
+    const uint8_t *p = (const uint8_t *)*text;
+    uint32_t codepoint;
+    int extra;
+
+    if (p[0] < 0x80) {
+        *text += 1;
+        return p[0];
+    } else if ((p[0] & 0xE0) == 0xC0) {
+        codepoint = p[0] & 0x1F;
+        extra = 1;
+    } else if ((p[0] & 0xF0) == 0xE0) {
+        codepoint = p[0] & 0x0F;
+        extra = 2;
+    } else if ((p[0] & 0xF8) == 0xF0) {
+        codepoint = p[0] & 0x07;
+        extra = 3;
+    } else {
+        *text += 1;
+        return '?';
+    }
+
+    for (int i = 1; i <= extra; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            *text += 1;
+            return '?';
+        }
+        codepoint = (codepoint << 6) | (p[i] & 0x3F);
+    }
+    *text += 1 + extra;
+    return codepoint;
+}
+
+static void rasterise(text_strip_t *strip)
+{
+    const char *p = strip->key;
+    int x = 0;
+
+    memset(strip->columns, 0, sizeof(strip->columns));
+    while (*p != '\0' && x + FONT_GLYPH_WIDTH <= TEXT_MAX_WIDTH) {
+        memcpy(&strip->columns[x], font_glyph(next_codepoint(&p)), FONT_GLYPH_WIDTH);
+        x += FONT_ADVANCE;
+    }
+    /* No spacing column after the last glyph */
+    strip->width = (uint16_t)(x > 0 ? x - 1 : 0);
+}
+
+void text_copy(char *dest, size_t size, const char *text)
+{
+    size_t len = key_length(text, size);
+    memcpy(dest, text, len);
+    dest[len] = '\0';
+}
+
+static const text_strip_t *lookup(const char *text)
+{
+    size_t len = key_length(text, TEXT_KEY_MAX);
+    uint32_t hash = hash_key(text, len);
+
+    s_metrics.lookups++;
+    s_use_counter++;
+
+    text_strip_t *victim = &s_cache[0];
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        text_strip_t *strip = &s_cache[i];
+        if (strip->used && strip->hash == hash && strip->len == len && memcmp(strip->key, text, len) == 0) {
+            strip->last_use = s_use_counter;
+            s_metrics.hits++;
+            return strip;
+        }
+        if (!strip->used || (victim->used && strip->last_use < victim->last_use)) {
+            victim = strip;
+        }
+    }
+
+    victim->used = true;
+    victim->hash = hash;
+    victim->last_use = s_use_counter;
+    victim->len = (uint8_t)len;
+    memcpy(victim->key, text, len);
+    victim->key[len] = '\0';
+    rasterise(victim);
+    return victim;
+}
+
+int text_width(const char *text)
+{
+    return lookup(text)->width;
+}
+
+bool text_draw(framebuffer_t *fb, int x, int y, int width, const char *text, uint32_t scroll)
+{
+    const text_strip_t *strip = lookup(text);
+
+    if (strip->width <= width) {
+        fb_blit(fb, x, y, strip->columns, strip->width);
+        return false;
+    }
+
+    /* Marquee: strip, gap, strip again; draw the window starting at offset */
+    int period = strip->width + TEXT_MARQUEE_GAP_PX;
+    int offset = (int)(scroll % (uint32_t)period);
+    int drawn = 0;
+
+    while (drawn < width) {
+        if (offset < strip->width) {
+            int count = strip->width - offset;
+            if (count > width - drawn) {
+                count = width - drawn;
+            }
+            fb_blit(fb, x + drawn, y, &strip->columns[offset], count);
+            drawn += count;
+            offset += count;
+        } else {
+            /* Inside the gap: nothing to draw, skip to the next repetition */
+            drawn += period - offset;
+            offset = 0;
+        }
+    }
+    return true;
+}
+
+void text_get_metrics(text_metrics_t *metrics)
+{
+    *metrics = s_metrics;
+}
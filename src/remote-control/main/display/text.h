@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "framebuffer.h"
+
+/**
+ * @file text.h
+ * @brief UTF-8 text rendering with a cache of pre-rendered strings
+ *
+ * A string is rasterised once into a one-page (8 px high) strip of column
+ * bytes and kept in a small LRU cache keyed by its content. Drawing it
+ * again, e.g. every frame of a scrolling title, is then a plain column
+ * blit into the framebuffer.
+ *
+ * Text wider than its area scrolls as a marquee: the strip is drawn shifted
+ * left by the scroll offset, followed by a gap and the start of the text
+ * again, so the scroll position can grow without bound.
+ *
+ * Plain C with no ESP-IDF dependencies. Not thread-safe: only the display
+ * task renders text.
+ */
+
+/** Longest cached string in bytes, including the terminating NUL; longer text is cut */
+#define TEXT_KEY_MAX 64
+
+/** Widest rendered string in pixels; text beyond it is cut */
+#define TEXT_MAX_WIDTH 384
+
+typedef struct {
+    uint32_t lookups;       /* Strings requested */
+    uint32_t hits;          /* Served from the cache without rasterising */
+} text_metrics_t;
+
+/**
+ * @brief Width of a string in pixels
+ */
+int text_width(const char *text);
+
+/**
+ * @brief Draw text into the area x..x+width-1 of the 8 px row starting at y
+ *
+ * Text that fits is drawn left-aligned and scroll is ignored. Wider text is
+ * drawn shifted left by scroll pixels, wrapping around after
+ * TEXT_MARQUEE_GAP_PX of blank columns.
+ *
+ * @return true if the text is wider than the area (i.e. it scrolls)
+ */
+bool text_draw(framebuffer_t *fb, int x, int y, int width, const char *text, uint32_t scroll);
+
+/**
+ * @brief Copy a UTF-8 string, cutting it without splitting a multi-byte sequence
+ *
+ * @param size Size of dest, at least 1
+ */
+void text_copy(char *dest, size_t size, const char *text);
+
+/**
+ * @brief Copy the cache counters
+ */
+void text_get_metrics(text_metrics_t *metrics);
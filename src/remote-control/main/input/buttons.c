@@ -7,6 +7,8 @@
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_err.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
 
 #include <stdint.h>
@@ -30,7 +32,19 @@ static const button_pin_map_t s_button_pin_map[] = {
     { BOARD_BUTTON_NEXT_TRACK_GPIO,     BUTTON_EVENT_ID_NEXT_TRACK_PRESSED     },
 };
 
+#define BUTTON_COUNT (sizeof(s_button_pin_map) / sizeof(s_button_pin_map[0]))
+
+typedef struct {
+    int pin;
+    TimerHandle_t debounce_timer;
+    volatile int64_t press_start_us;    /* First low level of this press; 0 = none */
+} button_t;
+
 static esp_event_loop_handle_t s_button_loop = NULL;
+static button_t s_buttons[BUTTON_COUNT];
+static size_t s_button_count = 0;
+static buttons_metrics_t s_metrics;
+static portMUX_TYPE s_metrics_lock = portMUX_INITIALIZER_UNLOCKED;
 
 static bool get_button_event_id_for_pin(int pin, buttons_event_id_t *out_event_id)
 {
@@ -79,12 +93,36 @@ static void button_event_log_handler(void *arg, esp_event_base_t base, int32_t i
     ESP_LOGI(TAG, "Event: %s (id=%" PRId32 "), pin=%d", event_id_to_name(event_id), id, pin);
 }
 
+static void record_press_latency(button_t *button)
+{
+    int64_t start_us = button->press_start_us;
+    if (start_us == 0) {
+        return;
+    }
+    uint32_t latency_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+    portENTER_CRITICAL(&s_metrics_lock);
+    s_metrics.presses++;
+    s_metrics.last_latency_us = latency_us;
+    if (latency_us > s_metrics.max_latency_us) {
+        s_metrics.max_latency_us = latency_us;
+    }
+    portEXIT_CRITICAL(&s_metrics_lock);
+}
+
 static void debounce_timer_cb(TimerHandle_t xTimer)
 {
-    int pinNumber = (int)(intptr_t)pvTimerGetTimerID(xTimer);
+    button_t *button = (button_t *)pvTimerGetTimerID(xTimer);
+    int pinNumber = button->pin;
 
     // Pull-up + active-low button: pressed only if still LOW after debounce
-    if (gpio_get_level(pinNumber) == 0 && s_button_loop != NULL) {
+    bool pressed = gpio_get_level(pinNumber) == 0;
+    if (pressed) {
+        record_press_latency(button);
+    }
+    button->press_start_us = 0;
+
+    if (pressed && s_button_loop != NULL) {
         buttons_event_id_t event_id;
         if (!get_button_event_id_for_pin(pinNumber, &event_id)) {
             ESP_LOGW(TAG, "No event mapping found for GPIO %d", pinNumber);
@@ -112,9 +150,17 @@ static void debounce_timer_cb(TimerHandle_t xTimer)
 
 static void IRAM_ATTR gpio_interrupt_handler(void *args)
 {
-    TimerHandle_t debounce_timer = (TimerHandle_t)args;
+    button_t *button = (button_t *)args;
+    bool pressed = gpio_get_level(button->pin) == 0;
+
+    /* Light-sleep GPIO wake needs level interrupts: wait for the opposite level next */
+    gpio_set_intr_type(button->pin, pressed ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+    if (pressed && button->press_start_us == 0) {
+        button->press_start_us = esp_timer_get_time();
+    }
+
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    xTimerResetFromISR(debounce_timer, &xHigherPriorityTaskWoken);
+    xTimerResetFromISR(button->debounce_timer, &xHigherPriorityTaskWoken);
     if (xHigherPriorityTaskWoken) {
         portYIELD_FROM_ISR();
     }
@@ -145,11 +191,12 @@ esp_err_t buttons_init(void)
     ));
 
     ESP_ERROR_CHECK(gpio_install_isr_service(0));
+    ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
 
     ESP_LOGI(TAG, "Buttons module initialized successfully");
 
     // Register all buttons declared in the pin->event map
-    for (size_t i = 0; i < (sizeof(s_button_pin_map) / sizeof(s_button_pin_map[0])); i++) {
+    for (size_t i = 0; i < BUTTON_COUNT; i++) {
         ESP_ERROR_CHECK(buttons_register(s_button_pin_map[i].pin));
     }
 
@@ -182,29 +229,49 @@ esp_err_t buttons_register(int pinNumber)
         ESP_LOGE(TAG, "buttons_init() must be called before buttons_register()");
         return ESP_ERR_INVALID_STATE;
     }
+    if (s_button_count >= BUTTON_COUNT) {
+        ESP_LOGE(TAG, "No slot left for GPIO %d", pinNumber);
+        return ESP_ERR_NO_MEM;
+    }
 
     gpio_config_t io_conf_pullup_enabled = {
         .pin_bit_mask = (1ULL << pinNumber),
         .mode = GPIO_MODE_INPUT,
         .pull_up_en = GPIO_PULLUP_ENABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_NEGEDGE
+        .intr_type = GPIO_INTR_LOW_LEVEL
     };
     ESP_ERROR_CHECK(gpio_config(&io_conf_pullup_enabled));
+    // A press ends light sleep; the interrupt then follows the level (see the ISR)
+    ESP_ERROR_CHECK(gpio_wakeup_enable(pinNumber, GPIO_INTR_LOW_LEVEL));
 
-    TimerHandle_t debounce_timer = xTimerCreate(
+    button_t *button = &s_buttons[s_button_count];
+    button->pin = pinNumber;
+    button->press_start_us = 0;
+    button->debounce_timer = xTimerCreate(
         "btn_dbnc",
         pdMS_TO_TICKS(DEBOUNCE_MS),
         pdFALSE,
-        (void *)(intptr_t)pinNumber,
+        (void *)button,
         debounce_timer_cb
     );
-    if (debounce_timer == NULL) {
+    if (button->debounce_timer == NULL) {
         ESP_LOGE(TAG, "Failed to create debounce timer for GPIO %d", pinNumber);
         return ESP_FAIL;
     }
+    s_button_count++;
 
-    ESP_ERROR_CHECK(gpio_isr_handler_add(pinNumber, gpio_interrupt_handler, (void *)debounce_timer));
+    ESP_ERROR_CHECK(gpio_isr_handler_add(pinNumber, gpio_interrupt_handler, (void *)button));
     ESP_LOGI(TAG, "Button %d registered", pinNumber);
     return ESP_OK;
 }
+
+void buttons_get_metrics(buttons_metrics_t *metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_metrics_lock);
+    *metrics = s_metrics;
+    portEXIT_CRITICAL(&s_metrics_lock);
+}
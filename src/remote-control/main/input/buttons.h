@@ -19,9 +19,25 @@ typedef struct {
 	buttons_event_id_t button_id;
 } buttons_event_data_t;
 
+typedef struct {
+	uint32_t presses;			/* Debounced presses */
+	uint32_t last_latency_us;	/* First low level seen to event posted */
+	uint32_t max_latency_us;
+} buttons_metrics_t;
+
 /**
  * @file buttons.h
  * @brief Button handling module
+ *
+ * Buttons are active low with a 50 ms debounce. They are also light-sleep
+ * wake sources, which on the ESP32 only works with level interrupts, so the
+ * interrupt is re-armed for the opposite level on every change instead of
+ * using edge interrupts.
+ *
+ * The press latency in buttons_get_metrics() runs from the interrupt that
+ * first saw the button low to the posted event: the debounce time plus the
+ * delay of the timer task, which light sleep must not stretch noticeably.
+ * The wake from light sleep itself happens before the interrupt runs.
  */
 esp_err_t buttons_init(void);
 
@@ -29,4 +45,9 @@ esp_err_t buttons_register(int pinNumber);
 
 esp_err_t buttons_subscribe(int32_t event_id, esp_event_handler_t handler, void *handler_arg);
 
+/**
+ * @brief Copy the press counters and latencies
+ */
+void buttons_get_metrics(buttons_metrics_t *metrics);
+
 #endif /* BUTTONS_H */
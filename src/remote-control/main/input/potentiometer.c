@@ -1,11 +1,14 @@
 #include "potentiometer.h"
 #include "board_pins.h"
 #include "esp_log.h"
+#include "esp_pm.h"
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
 #include "esp_adc/adc_oneshot.h"
-#include "music_assistant/music_assistant_client.h"
+#include "music_assistant/music_assistant_controller.h"
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "POTENTIOMETER";
@@ -29,9 +32,28 @@ static int s_current_volume = 0;
 static TickType_t s_last_update_time = 0;
 static TickType_t s_last_change_time = 0;
 
+/* Fast sampling until this tick count */
+static TickType_t s_active_until = 0;
+
 /* Task handle */
 static TaskHandle_t s_potentiometer_task_handle = NULL;
 
+#if CONFIG_PM_ENABLE
+/* ADC conversions need a stable APB clock */
+static esp_pm_lock_handle_t s_pm_lock = NULL;
+#endif
+
+static esp_err_t read_adc(int *raw_value) {
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_acquire(s_pm_lock);
+#endif
+    esp_err_t err = adc_oneshot_read(s_adc_handle, BOARD_POTENTIOMETER_ADC_CHANNEL, raw_value);
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_release(s_pm_lock);
+#endif
+    return err;
+}
+
 /**
  * @brief Add a new ADC sample to the moving average filter
  * 
@@ -85,10 +107,10 @@ static void send_volume_update(int volume, int raw_adc, int smoothed_adc) {
     ESP_LOGI(TAG, "Volume update: raw=%d, smoothed=%d, volume=%d%%", 
              raw_adc, smoothed_adc, volume);
     
-    /* Send volume to Music Assistant */
-    esp_err_t err = music_assistant_set_volume(volume);
+    /* Hand the level to the controller's volume lane; never blocks on the network */
+    esp_err_t err = music_assistant_controller_set_volume(volume);
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to send volume to Music Assistant: %s", esp_err_to_name(err));
+        ESP_LOGW(TAG, "Failed to queue volume for Music Assistant: %s", esp_err_to_name(err));
     }
     
     s_last_logged_volume = volume;
@@ -102,20 +124,30 @@ static void send_volume_update(int volume, int raw_adc, int smoothed_adc) {
  * - Rate limiting: Max 1 update per POTENTIOMETER_MIN_UPDATE_INTERVAL_MS
  * - Settling detection: Waits for value to stabilize before sending final update
  * - Immediate response: First change is sent immediately (if rate limit allows)
+ * - Adaptive sampling: POTENTIOMETER_SAMPLE_INTERVAL_MS while the knob moves or
+ *   a value is pending, POTENTIOMETER_IDLE_SAMPLE_INTERVAL_MS at rest
  */
 static void potentiometer_task(void *pvParameters) {
     ESP_LOGI(TAG, "Potentiometer task started");
     
     /* Initialize with current logged volume to prevent boot-time update */
     int last_volume = s_last_logged_volume;
+    int last_smoothed = -1;
+    const int movement_threshold = ADC_MAX_VALUE * POTENTIOMETER_HYSTERESIS_PERCENT / 100;
     
     while (1) {
         int raw_adc = 0;
-        esp_err_t err = adc_oneshot_read(s_adc_handle, BOARD_POTENTIOMETER_ADC_CHANNEL, &raw_adc);
+        esp_err_t err = read_adc(&raw_adc);
         
         if (err == ESP_OK) {
+            /* A reading away from the average means the knob moves: sample fast for a while */
+            if (last_smoothed == -1 || abs(raw_adc - last_smoothed) > movement_threshold) {
+                s_active_until = xTaskGetTickCount() + pdMS_TO_TICKS(POTENTIOMETER_ACTIVE_HOLD_MS);
+            }
+
             /* Apply moving average filter */
             int smoothed_adc = moving_average_filter(raw_adc);
+            last_smoothed = smoothed_adc;
             
             /* Map to volume percentage */
             int volume = map_adc_to_volume(smoothed_adc);
@@ -159,7 +191,9 @@ static void potentiometer_task(void *pvParameters) {
         }
         
         /* Wait before next sample */
-        vTaskDelay(pdMS_TO_TICKS(POTENTIOMETER_SAMPLE_INTERVAL_MS));
+        bool active = s_pending_volume != -1 || (int32_t)(s_active_until - xTaskGetTickCount()) > 0;
+        vTaskDelay(pdMS_TO_TICKS(active ? POTENTIOMETER_SAMPLE_INTERVAL_MS
+                                        : POTENTIOMETER_IDLE_SAMPLE_INTERVAL_MS));
     }
 }
 
@@ -194,9 +228,17 @@ esp_err_t potentiometer_init(void) {
         return err;
     }
     
+#if CONFIG_PM_ENABLE
+    err = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "pot_adc", &s_pm_lock);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create PM lock: %s", esp_err_to_name(err));
+        return err;
+    }
+#endif
+    
     /* Read initial potentiometer position to prevent boot update */
     int initial_adc = 0;
-    err = adc_oneshot_read(s_adc_handle, BOARD_POTENTIOMETER_ADC_CHANNEL, &initial_adc);
+    err = read_adc(&initial_adc);
     if (err == ESP_OK) {
         /* Pre-fill the moving average buffer with initial reading */
         for (int i = 0; i < POTENTIOMETER_MOVING_AVG_SIZE; i++) {
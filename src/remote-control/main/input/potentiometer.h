@@ -29,14 +29,17 @@
 #define POTENTIOMETER_MIN_UPDATE_INTERVAL_MS 500   /* Minimum time between updates */
 #define POTENTIOMETER_SETTLING_TIME_MS 400         /* Wait for value to stabilize */
 
-/* Sampling rate */
+/* Sampling rate: fast while the knob moves, slower at rest so the chip can light-sleep */
 #define POTENTIOMETER_SAMPLE_INTERVAL_MS 100
+#define POTENTIOMETER_IDLE_SAMPLE_INTERVAL_MS 300
+#define POTENTIOMETER_ACTIVE_HOLD_MS 1000          /* Fast sampling after the last movement */
 
 /**
  * @brief Initialize the potentiometer module
  * 
  * Sets up ADC1 with 12-bit resolution and 11dB attenuation,
- * creates the ADC reading task that polls every 100ms.
+ * creates the ADC reading task that polls every 100ms while the knob
+ * moves and every 300ms at rest. Each read holds an APB frequency PM lock.
  * 
  * @return ESP_OK on success, error code otherwise
  */
@@ -0,0 +1,141 @@
+#include "led_controller.h"
+#include <stdbool.h>
+#include "esp_event.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "common/app_events.h"
+#include "music_assistant/music_assistant_client.h"
+#include "status_led.h"
+
+static const char *TAG = "LED_CONTROLLER";
+
+#define LED_DIM_PERCENT             10
+#define LED_PROGRESS_PERCENT        60
+#define LED_BREATHE_PERCENT         40
+
+static const status_led_pattern_t PATTERN_CONNECTING = { STATUS_LED_BREATHE, LED_BREATHE_PERCENT, 0, 2000 };
+static const status_led_pattern_t PATTERN_WIFI_LOST = { STATUS_LED_BLINK, 100, 0, 500 };
+static const status_led_pattern_t PATTERN_SERVER_LOST = { STATUS_LED_BLINK, 100, 0, 1000 };
+static const status_led_pattern_t PATTERN_ONLINE = { STATUS_LED_ON, LED_DIM_PERCENT, 0, 0 };
+static const status_led_pattern_t PATTERN_STREAMING = { STATUS_LED_BREATHE, LED_BREATHE_PERCENT, 0, 3000 };
+static const status_led_pattern_t PATTERN_PAUSED = { STATUS_LED_ON, LED_DIM_PERCENT, 0, 0 };
+static const status_led_pattern_t PATTERN_PLAYTIME_OVER = { STATUS_LED_BLINK, 100, 0, 500 };
+
+static bool s_handlers_registered = false;
+
+/* Handlers run on the default event loop task only */
+static bool s_playtime_over = false;
+
+static void led_wifi_event_handler(void *arg,
+                                   esp_event_base_t event_base,
+                                   int32_t event_id,
+                                   void *event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        status_led_set(STATUS_LED_NETWORK, &PATTERN_CONNECTING);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        status_led_set(STATUS_LED_NETWORK, &PATTERN_WIFI_LOST);
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        status_led_set(STATUS_LED_NETWORK, &PATTERN_ONLINE);
+    }
+}
+
+/* Brighten from the current position to the end of the track, in one go */
+static void show_now_playing(const app_now_playing_event_t *event)
+{
+    if (!event->playing) {
+        /* The pause that follows the playtime limit keeps the notice blinking */
+        status_led_set(STATUS_LED_PLAYBACK, s_playtime_over ? &PATTERN_PLAYTIME_OVER : &PATTERN_PAUSED);
+        return;
+    }
+    s_playtime_over = false;
+    if (event->duration <= 0 || event->position < 0) {
+        status_led_set(STATUS_LED_PLAYBACK, &PATTERN_STREAMING);
+        return;
+    }
+
+    float position = event->position + (float)(esp_timer_get_time() - event->anchor_us) / 1000000.0f;
+    if (position > event->duration) {
+        position = event->duration;
+    }
+    status_led_pattern_t pattern = {
+        .effect = STATUS_LED_PROGRESS,
+        .brightness = LED_PROGRESS_PERCENT,
+        .start = (uint8_t)(LED_PROGRESS_PERCENT * position / event->duration),
+        .period_ms = (uint32_t)((event->duration - position) * 1000.0f),
+    };
+    status_led_set(STATUS_LED_PLAYBACK, &pattern);
+}
+
+static void led_app_event_handler(void *arg,
+                                  esp_event_base_t event_base,
+                                  int32_t event_id,
+                                  void *event_data)
+{
+    if (event_base != APP_EVENTS) {
+        return;
+    }
+
+    if (event_id == APP_EVENT_PARENTAL_LIMIT_REACHED) {
+        s_playtime_over = true;
+        status_led_set(STATUS_LED_PLAYBACK, &PATTERN_PLAYTIME_OVER);
+        return;
+    }
+
+    if (event_id == APP_EVENT_NOW_PLAYING && event_data) {
+        show_now_playing((const app_now_playing_event_t *)event_data);
+        return;
+    }
+
+    if (event_id == APP_EVENT_ERROR && event_data) {
+        const app_error_event_t *error = (const app_error_event_t *)event_data;
+        if (error->error_code == ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_OPEN) {
+            status_led_set(STATUS_LED_NETWORK, &PATTERN_SERVER_LOST);
+        } else if (error->error_code == ESP_OK) {
+            status_led_set(STATUS_LED_NETWORK, &PATTERN_ONLINE);
+        }
+    }
+}
+
+esp_err_t led_controller_init(void)
+{
+    if (s_handlers_registered) {
+        return ESP_OK;
+    }
+
+    esp_event_handler_instance_t instance_any_id;
+    esp_event_handler_instance_t instance_got_ip;
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
+                                                        ESP_EVENT_ANY_ID,
+                                                        &led_wifi_event_handler,
+                                                        NULL,
+                                                        &instance_any_id));
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
+                                                        IP_EVENT_STA_GOT_IP,
+                                                        &led_wifi_event_handler,
+                                                        NULL,
+                                                        &instance_got_ip));
+
+    ESP_ERROR_CHECK(esp_event_handler_register(APP_EVENTS,
+                                               APP_EVENT_ERROR,
+                                               &led_app_event_handler,
+                                               NULL));
+
+    ESP_ERROR_CHECK(esp_event_handler_register(APP_EVENTS,
+                                               APP_EVENT_PARENTAL_LIMIT_REACHED,
+                                               &led_app_event_handler,
+                                               NULL));
+
+    ESP_ERROR_CHECK(esp_event_handler_register(APP_EVENTS,
+                                               APP_EVENT_NOW_PLAYING,
+                                               &led_app_event_handler,
+                                               NULL));
+
+    s_handlers_registered = true;
+    ESP_LOGI(TAG, "LED controller initialized");
+    return ESP_OK;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "esp_err.h"
+
+/**
+ * Drives the status LEDs from WiFi, server and playback events:
+ * - Network LED: breathing while connecting, blinking while WiFi is lost
+ *   (fast) or Music Assistant is unreachable (slow), dim steady when all is
+ *   well.
+ * - Playback LED: brightening over the track while playing (breathing for
+ *   streams without a duration), dim steady while paused, fast blinking
+ *   once the daily playtime is over.
+ *
+ * Every pattern is handed to the LEDC hardware (status_led.h); nothing here
+ * runs while an animation plays.
+ */
+
+/**
+ * @brief Register the event handlers
+ *
+ * status_led_init() must have been called.
+ *
+ * @return ESP_OK on success, ESP_ERR_* on failure
+ */
+esp_err_t led_controller_init(void);
@@ -0,0 +1,413 @@
+#include "status_led.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/ledc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "board_pins.h"
+#include "common/config.h"
+
+static const char *TAG = "STATUS_LED";
+
+#define LED_TASK_STACK_SIZE     2560
+#define LED_TASK_PRIORITY       3
+
+/*
+ * Both timers run from RC_FAST (about 8 MHz), the one LEDC clock that keeps
+ * running in light sleep, so the LEDs keep blinking and fading while the
+ * chip sleeps. At STATUS_LED_PWM_FREQ_HZ that leaves 10 bits of duty.
+ */
+#define LED_SPEED_MODE          LEDC_LOW_SPEED_MODE
+#define LED_CLK_CFG             LEDC_USE_RC_FAST_CLK
+#define LED_CLK_HZ              8500000
+#define LED_PWM_RESOLUTION      LEDC_TIMER_10_BIT
+#define LED_DUTY_MAX            ((1u << 10) - 1)
+#define LEDC_DIVIDER_MAX        1023
+
+#define BLINK_FREQ_MAX_HZ       100
+
+/* Task notification bits: one "fade ended" and one "new pattern" bit per LED */
+#define FADE_END_BIT(led)       (1u << (led))
+#define FADE_OVERDUE_US         50000   /* A fade-end interrupt this late never comes: end the fade in the task */
+#define PATTERN_BIT(led)        (1u << (8 + (led)))
+
+typedef enum {
+    TIMER_UNCONFIGURED = 0,
+    TIMER_PWM,              /* STATUS_LED_PWM_FREQ_HZ, for levels and fades */
+    TIMER_BLINK,            /* Blink frequency, low duty resolution */
+} timer_mode_t;
+
+/*
+ * The ESP32 LEDC cannot change a channel's duty while a fade runs, so a new
+ * pattern is applied by the task once the running fade segment has ended.
+ * Fades are therefore cut into segments of at most STATUS_LED_FADE_SEGMENT_MS.
+ *
+ * The fade-end interrupt cannot end light sleep, so the task also wakes on a
+ * timeout at the expected end of the earliest running fade.
+ */
+typedef struct {
+    int gpio;
+    ledc_channel_t channel;
+    ledc_timer_t timer;
+    timer_mode_t timer_mode;
+    uint32_t blink_hz;
+    status_led_pattern_t pattern;       /* Running; owned by the task */
+    bool fading;
+    int64_t fade_end_us;                /* Expected end of the running fade */
+    bool rising;                        /* BREATHE: direction of the running fade */
+    uint32_t progress_target;           /* PROGRESS: duty at the end of the ramp */
+    uint32_t progress_remaining_ms;     /* PROGRESS: ramp time after the running segment */
+    status_led_pattern_t requested;     /* Latest status_led_set(); guarded by s_lock */
+    bool has_request;
+} led_state_t;
+
+static led_state_t s_leds[STATUS_LED_COUNT] = {
+    [STATUS_LED_NETWORK] = {
+        .gpio = BOARD_LED_NETWORK_GPIO,
+        .channel = LEDC_CHANNEL_0,
+        .timer = LEDC_TIMER_0,
+    },
+    [STATUS_LED_PLAYBACK] = {
+        .gpio = BOARD_LED_PLAYBACK_GPIO,
+        .channel = LEDC_CHANNEL_1,
+        .timer = LEDC_TIMER_1,
+    },
+};
+
+static TaskHandle_t s_task = NULL;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static status_led_metrics_t s_metrics;
+
+/* Perceived brightness is roughly quadratic in duty */
+static uint32_t percent_to_duty(uint8_t percent)
+{
+    if (percent > 100) {
+        percent = 100;
+    }
+    return LED_DUTY_MAX * percent * percent / 10000;
+}
+
+static bool same_pattern(const status_led_pattern_t *a, const status_led_pattern_t *b)
+{
+    return a->effect == b->effect && a->brightness == b->brightness &&
+           a->start == b->start && a->period_ms == b->period_ms;
+}
+
+/* Lowest duty resolution whose clock divider fits; the 50 % duty is then the blink */
+static uint32_t blink_resolution(uint32_t hz)
+{
+    uint32_t bits = 1;
+    while (LED_CLK_HZ / (hz << bits) > LEDC_DIVIDER_MAX) {
+        bits++;
+    }
+    return bits;
+}
+
+static esp_err_t configure_timer(led_state_t *led, timer_mode_t mode, uint32_t blink_hz)
+{
+    if (led->timer_mode == mode && (mode != TIMER_BLINK || led->blink_hz == blink_hz)) {
+        return ESP_OK;
+    }
+
+    ledc_timer_config_t timer = {
+        .speed_mode = LED_SPEED_MODE,
+        .timer_num = led->timer,
+    };
+    if (mode == TIMER_BLINK) {
+        timer.duty_resolution = (ledc_timer_bit_t)blink_resolution(blink_hz);
+        timer.freq_hz = blink_hz;
+    } else {
+        timer.duty_resolution = LED_PWM_RESOLUTION;
+        timer.freq_hz = STATUS_LED_PWM_FREQ_HZ;
+    }
+    timer.clk_cfg = LED_CLK_CFG;
+
+    esp_err_t err = ledc_timer_config(&timer);
+    if (err == ESP_OK) {
+        led->timer_mode = mode;
+        led->blink_hz = blink_hz;
+    }
+    return err;
+}
+
+static void set_duty(led_state_t *led, uint32_t duty)
+{
+    ledc_set_duty(LED_SPEED_MODE, led->channel, duty);
+    ledc_update_duty(LED_SPEED_MODE, led->channel);
+}
+
+/* Start a hardware fade; the fade-end interrupt wakes the task when it is done */
+static void start_fade(led_state_t *led, uint32_t duty, uint32_t duration_ms)
+{
+    if (duration_ms == 0 || duty == ledc_get_duty(LED_SPEED_MODE, led->channel)) {
+        /* Nothing to fade: no fade-end interrupt would follow */
+        set_duty(led, duty);
+        return;
+    }
+    if (ledc_set_fade_with_time(LED_SPEED_MODE, led->channel, duty, (int)duration_ms) == ESP_OK &&
+        ledc_fade_start(LED_SPEED_MODE, led->channel, LEDC_FADE_NO_WAIT) == ESP_OK) {
+        led->fading = true;
+        led->fade_end_us = esp_timer_get_time() + (int64_t)duration_ms * 1000;
+    } else {
+        set_duty(led, duty);
+    }
+}
+
+/* Next part of a PROGRESS ramp: the same slope, at most one segment long */
+static void continue_progress(led_state_t *led)
+{
+    while (led->progress_remaining_ms > 0 && !led->fading) {
+        uint32_t segment_ms = led->progress_remaining_ms;
+        if (segment_ms > STATUS_LED_FADE_SEGMENT_MS) {
+            segment_ms = STATUS_LED_FADE_SEGMENT_MS;
+        }
+        int64_t current = ledc_get_duty(LED_SPEED_MODE, led->channel);
+        int64_t delta = (int64_t)led->progress_target - current;
+        uint32_t duty = (uint32_t)(current + delta * segment_ms / led->progress_remaining_ms);
+        led->progress_remaining_ms -= segment_ms;
+        start_fade(led, duty, segment_ms);
+    }
+}
+
+/* Start the pattern the task has just taken over into led->pattern */
+static void apply_pattern(led_state_t *led, const status_led_pattern_t *pattern)
+{
+    led->progress_remaining_ms = 0;
+
+    if (pattern->effect == STATUS_LED_BLINK) {
+        uint32_t hz = (1000 + pattern->period_ms / 2) / pattern->period_ms;
+        hz = hz < 1 ? 1 : (hz > BLINK_FREQ_MAX_HZ ? BLINK_FREQ_MAX_HZ : hz);
+        if (configure_timer(led, TIMER_BLINK, hz) == ESP_OK) {
+            set_duty(led, 1u << (blink_resolution(hz) - 1));
+        }
+        return;
+    }
+
+    if (configure_timer(led, TIMER_PWM, 0) != ESP_OK) {
+        return;
+    }
+    switch (pattern->effect) {
+        case STATUS_LED_ON:
+            set_duty(led, percent_to_duty(pattern->brightness));
+            break;
+        case STATUS_LED_BREATHE:
+            set_duty(led, 0);
+            led->rising = true;
+            start_fade(led, percent_to_duty(pattern->brightness), pattern->period_ms / 2);
+            break;
+        case STATUS_LED_PROGRESS:
+            set_duty(led, percent_to_duty(pattern->start));
+            led->progress_target = percent_to_duty(pattern->brightness);
+            led->progress_remaining_ms = pattern->period_ms;
+            continue_progress(led);
+            break;
+        case STATUS_LED_OFF:
+        default:
+            set_duty(led, 0);
+            break;
+    }
+}
+
+/* A fade segment ended: reverse a breath or continue a ramp */
+static void continue_animation(led_state_t *led)
+{
+    if (led->pattern.effect == STATUS_LED_BREATHE) {
+        led->rising = !led->rising;
+        start_fade(led, led->rising ? percent_to_duty(led->pattern.brightness) : 0, led->pattern.period_ms / 2);
+    } else if (led->pattern.effect == STATUS_LED_PROGRESS) {
+        continue_progress(led);
+    }
+}
+
+static IRAM_ATTR bool fade_end_isr(const ledc_cb_param_t *param, void *user_arg)
+{
+    BaseType_t woken = pdFALSE;
+    if (param->event == LEDC_FADE_END_EVT) {
+        xTaskNotifyFromISR(s_task, FADE_END_BIT((uint32_t)(uintptr_t)user_arg), eSetBits, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+/*
+ * Until the earliest running fade should have ended, so light sleep ends in
+ * time for it; for a fade already past its end, until it counts as overdue
+ */
+static TickType_t fade_wait_ticks(void)
+{
+    int64_t now_us = esp_timer_get_time();
+    int64_t earliest_us = INT64_MAX;
+    for (int i = 0; i < STATUS_LED_COUNT; i++) {
+        if (!s_leds[i].fading) {
+            continue;
+        }
+        int64_t deadline_us = s_leds[i].fade_end_us;
+        if (deadline_us <= now_us) {
+            deadline_us += FADE_OVERDUE_US;
+        }
+        if (deadline_us < earliest_us) {
+            earliest_us = deadline_us;
+        }
+    }
+    if (earliest_us == INT64_MAX) {
+        return portMAX_DELAY;
+    }
+    int64_t left_us = earliest_us - now_us;
+    return left_us > 0 ? pdMS_TO_TICKS((uint32_t)((left_us + 999) / 1000)) + 1 : 0;
+}
+
+/* Fades whose end interrupt is overdue (e.g. lost around light sleep), as fade-end bits */
+static uint32_t overdue_fade_bits(void)
+{
+    int64_t now_us = esp_timer_get_time();
+    uint32_t bits = 0;
+    for (int i = 0; i < STATUS_LED_COUNT; i++) {
+        if (s_leds[i].fading && now_us - s_leds[i].fade_end_us >= FADE_OVERDUE_US) {
+            bits |= FADE_END_BIT(i);
+        }
+    }
+    return bits;
+}
+
+static void status_led_task(void *arg)
+{
+    (void)arg;
+    uint32_t bits = 0;
+
+    while (1) {
+        /* On a timeout the pending fade-end interrupt normally runs right after the wake */
+        if (xTaskNotifyWait(0, UINT32_MAX, &bits, fade_wait_ticks()) != pdTRUE) {
+            bits = overdue_fade_bits();
+            if (bits == 0) {
+                continue;
+            }
+            ESP_LOGW(TAG, "Fade end interrupt missing, ending the fade");
+        }
+
+        for (int i = 0; i < STATUS_LED_COUNT; i++) {
+            led_state_t *led = &s_leds[i];
+            if (bits & FADE_END_BIT(i)) {
+                led->fading = false;
+            }
+
+            status_led_pattern_t pattern;
+            bool has_request = false;
+            if (!led->fading) {
+                portENTER_CRITICAL(&s_lock);
+                has_request = led->has_request;
+                pattern = led->requested;
+                if (has_request) {
+                    led->pattern = pattern;
+                    led->has_request = false;
+                }
+                portEXIT_CRITICAL(&s_lock);
+            }
+
+            if (has_request) {
+                apply_pattern(led, &pattern);
+            } else if (bits & FADE_END_BIT(i)) {
+                portENTER_CRITICAL(&s_lock);
+                s_metrics.wakeups++;
+                portEXIT_CRITICAL(&s_lock);
+                continue_animation(led);
+            }
+        }
+    }
+}
+
+esp_err_t status_led_init(void)
+{
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = ledc_fade_func_install(0);
+    for (int i = 0; i < STATUS_LED_COUNT && err == ESP_OK; i++) {
+        led_state_t *led = &s_leds[i];
+        err = configure_timer(led, TIMER_PWM, 0);
+        if (err != ESP_OK) {
+            break;
+        }
+
+        ledc_channel_config_t channel = {
+            .gpio_num = led->gpio,
+            .speed_mode = LED_SPEED_MODE,
+            .channel = led->channel,
+            .intr_type = LEDC_INTR_DISABLE,
+            .timer_sel = led->timer,
+            .duty = 0,
+            .hpoint = 0,
+            .sleep_mode = LEDC_SLEEP_MODE_KEEP_ALIVE,
+        };
+        err = ledc_channel_config(&channel);
+        if (err == ESP_OK) {
+            ledc_cbs_t callbacks = { .fade_cb = fade_end_isr };
+            err = ledc_cb_register(LED_SPEED_MODE, led->channel, &callbacks, (void *)(uintptr_t)i);
+        }
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure LEDC: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    /* No fade runs before the first pattern, so no interrupt can precede the task */
+    BaseType_t ret = xTaskCreate(status_led_task, "status_led", LED_TASK_STACK_SIZE, NULL,
+                                 LED_TASK_PRIORITY, &s_task);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create LED task");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Status LEDs on GPIO %d and %d", BOARD_LED_NETWORK_GPIO, BOARD_LED_PLAYBACK_GPIO);
+    return ESP_OK;
+}
+
+esp_err_t status_led_set(status_led_id_t led, const status_led_pattern_t *pattern)
+{
+    if (led >= STATUS_LED_COUNT || pattern == NULL || pattern->brightness > 100 || pattern->start > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((pattern->effect == STATUS_LED_BLINK || pattern->effect == STATUS_LED_BREATHE) && pattern->period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    status_led_pattern_t requested = *pattern;
+    if (requested.effect == STATUS_LED_BREATHE && requested.period_ms > 2 * STATUS_LED_FADE_SEGMENT_MS) {
+        /* Each half breath is one fade, and fades are kept short enough to be replaced promptly */
+        requested.period_ms = 2 * STATUS_LED_FADE_SEGMENT_MS;
+    }
+
+    led_state_t *state = &s_leds[led];
+    bool changed;
+    portENTER_CRITICAL(&s_lock);
+    const status_led_pattern_t *latest = state->has_request ? &state->requested : &state->pattern;
+    changed = !same_pattern(latest, &requested);
+    if (changed) {
+        state->requested = requested;
+        state->has_request = true;
+        s_metrics.patterns++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (changed) {
+        xTaskNotify(s_task, PATTERN_BIT(led), eSetBits);
+    }
+    return ESP_OK;
+}
+
+void status_led_get_metrics(status_led_metrics_t *metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *metrics = s_metrics;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @file status_led.h
+ * @brief Status LEDs animated by the LEDC peripheral
+ *
+ * Each LED is described by a pattern (effect, brightness, period) and then
+ * left to the hardware:
+ * - STATUS_LED_ON is a fixed duty; no CPU involvement.
+ * - STATUS_LED_BLINK runs the LED's LEDC timer at the blink frequency with
+ *   50 % duty, so the PWM itself is the blink; no CPU involvement.
+ * - STATUS_LED_BREATHE is a hardware fade up and a fade down; only the
+ *   reversal at each end is started from a small task woken by the
+ *   fade-end interrupt, i.e. two wakeups per breath instead of one per
+ *   frame.
+ * - STATUS_LED_PROGRESS is a hardware fade cut into segments of
+ *   STATUS_LED_FADE_SEGMENT_MS, one wakeup per segment.
+ *
+ * The ESP32 LEDC cannot change a duty while a fade runs, so a new pattern
+ * takes effect at the end of the running fade segment, i.e. within
+ * STATUS_LED_FADE_SEGMENT_MS.
+ *
+ * The LEDC runs from RC_FAST and stays on in light sleep, so patterns keep
+ * running while the chip sleeps; only the task wakeups end a light sleep.
+ *
+ * The wakeup counter in status_led_get_metrics() is the task-level CPU cost
+ * of all animations.
+ */
+
+typedef enum {
+    STATUS_LED_NETWORK = 0,     /* WiFi and Music Assistant reachability */
+    STATUS_LED_PLAYBACK,        /* Player state, track progress, playtime limit */
+    STATUS_LED_COUNT,
+} status_led_id_t;
+
+typedef enum {
+    STATUS_LED_OFF = 0,
+    STATUS_LED_ON,          /* Constant at brightness */
+    STATUS_LED_BLINK,       /* Full on / off, period rounded to whole Hz (1-100 Hz) */
+    STATUS_LED_BREATHE,     /* Fade 0 -> brightness -> 0 over period_ms, repeated */
+    STATUS_LED_PROGRESS,    /* Fade start -> brightness over period_ms, then hold */
+} status_led_effect_t;
+
+typedef struct {
+    status_led_effect_t effect;
+    uint8_t brightness;     /* Percent; for BLINK the LED is fully on while lit */
+    uint8_t start;          /* PROGRESS: level in percent at the beginning of the ramp */
+    uint32_t period_ms;     /* BLINK/BREATHE: one cycle; PROGRESS: ramp duration */
+} status_led_pattern_t;
+
+typedef struct {
+    uint32_t patterns;      /* status_led_set() calls that changed a pattern */
+    uint32_t wakeups;       /* Task wakeups to continue a breath or a ramp */
+} status_led_metrics_t;
+
+/**
+ * @brief Configure the LEDC timers and channels and start the fade task
+ *
+ * All LEDs start off.
+ *
+ * @return ESP_OK on success, ESP_ERR_* from the LEDC driver otherwise
+ */
+esp_err_t status_led_init(void);
+
+/**
+ * @brief Switch an LED to a new pattern
+ *
+ * Setting the pattern the LED already runs does nothing, so callers can
+ * re-apply their state freely. Safe to call from any task.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an unknown LED or an out-of-range
+ *         pattern, ESP_ERR_INVALID_STATE before status_led_init()
+ */
+esp_err_t status_led_set(status_led_id_t led, const status_led_pattern_t *pattern);
+
+/**
+ * @brief Copy the animation counters
+ */
+void status_led_get_metrics(status_led_metrics_t *metrics);
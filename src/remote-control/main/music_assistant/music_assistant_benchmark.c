@@ -0,0 +1,193 @@
+#include "music_assistant_benchmark.h"
+
+#include "sdkconfig.h"
+
+#if CONFIG_MUSIC_ASSISTANT_BENCHMARK
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "common/config.h"
+#include "music_assistant_connection.h"
+#include "music_assistant_controller.h"
+
+static const char *TAG = "MA_BENCHMARK";
+
+#define BENCHMARK_TASK_STACK_SIZE       4096
+#define BENCHMARK_TASK_PRIORITY         3
+#define BENCHMARK_START_DELAY_MS        5000    /* Let the reconnect state sync finish first */
+#define BENCHMARK_POLL_MS               20
+#define BENCHMARK_VOLUME_INTERVAL_MS    50      /* A knob being turned */
+#define BENCHMARK_ROUND_TIMEOUT_MS      60000
+#define BENCHMARK_RECONNECTS            10
+#define BENCHMARK_ACQUIRE_TIMEOUT_MS    5000
+
+/* Order of music_assistant_controller_get_metrics() */
+enum { LANE_TRANSPORT = 0, LANE_VOLUME, LANE_COUNT };
+
+static bool s_started = false;
+
+static void run_round(const char *name, bool with_volume)
+{
+    music_assistant_lane_metrics_t before[LANE_COUNT];
+    music_assistant_lane_metrics_t after[LANE_COUNT];
+    const uint32_t count = CONFIG_MUSIC_ASSISTANT_BENCHMARK_COMMANDS;
+
+    music_assistant_controller_get_metrics(before, LANE_COUNT);
+    int64_t start_us = esp_timer_get_time();
+
+    /* Seek + play: two ordered requests per transport command */
+    for (uint32_t i = 0; i < count; i++) {
+        music_assistant_controller_resume(0.0f);
+    }
+
+    int volume = 0;
+    bool done = false;
+    while (!done && esp_timer_get_time() - start_us < (int64_t)BENCHMARK_ROUND_TIMEOUT_MS * 1000) {
+        if (with_volume) {
+            music_assistant_controller_set_volume(volume);
+            volume = (volume + 7) % 100;
+        }
+        vTaskDelay(pdMS_TO_TICKS(with_volume ? BENCHMARK_VOLUME_INTERVAL_MS : BENCHMARK_POLL_MS));
+
+        music_assistant_controller_get_metrics(after, LANE_COUNT);
+        bool transport_done = after[LANE_TRANSPORT].executed - before[LANE_TRANSPORT].executed >= count;
+        /* The volume lane is idle once every level was either sent or replaced */
+        bool volume_idle = after[LANE_VOLUME].submitted ==
+                           after[LANE_VOLUME].executed + after[LANE_VOLUME].superseded;
+        done = transport_done && volume_idle;
+    }
+
+    uint32_t wall_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    uint32_t transport = after[LANE_TRANSPORT].executed - before[LANE_TRANSPORT].executed;
+    uint32_t volumes = after[LANE_VOLUME].executed - before[LANE_VOLUME].executed;
+    uint32_t superseded = after[LANE_VOLUME].superseded - before[LANE_VOLUME].superseded;
+    uint32_t failed = (after[LANE_TRANSPORT].failed - before[LANE_TRANSPORT].failed) +
+                      (after[LANE_VOLUME].failed - before[LANE_VOLUME].failed);
+    uint32_t busy_ms = (after[LANE_TRANSPORT].busy_ms - before[LANE_TRANSPORT].busy_ms) +
+                       (after[LANE_VOLUME].busy_ms - before[LANE_VOLUME].busy_ms);
+
+    if (!done) {
+        ESP_LOGW(TAG, "%s: timed out after %lu ms", name, (unsigned long)wall_ms);
+    }
+    /* Busy time over wall time above 1 is work the lanes did in parallel */
+    ESP_LOGI(TAG, "%s: %lu transport + %lu volume commands (%lu superseded, %lu failed) in %lu ms: "
+             "%.1f commands/s, lanes busy %lu ms (%.2fx overlap)",
+             name, (unsigned long)transport, (unsigned long)volumes, (unsigned long)superseded,
+             (unsigned long)failed, (unsigned long)wall_ms,
+             wall_ms > 0 ? (transport + volumes) * 1000.0f / (float)wall_ms : 0.0f,
+             (unsigned long)busy_ms, wall_ms > 0 ? (float)busy_ms / (float)wall_ms : 0.0f);
+}
+
+/* Closes the connection after every state read, so each read pays for a new
+ * connect. Against an https host the reconnects present the session ticket of
+ * the previous connection; the first connect of the slot is the full handshake
+ * they are compared with. Run the mock server with --no-tickets to measure
+ * full handshakes only. */
+static void run_handshake_round(void)
+{
+    const char *host = CONFIG_MUSIC_ASSISTANT_HOST;
+    char *url = NULL;
+    if (asprintf(&url, "%s%s/api/states/%s", strncmp(host, "http", 4) == 0 ? "" : "http://",
+                 host, CONFIG_MEDIA_PLAYER_ENTITY_ID) < 0) {
+        ESP_LOGE(TAG, "Out of memory");
+        return;
+    }
+
+    uint32_t measured = 0, failed = 0, total_ms = 0, min_ms = UINT32_MAX, max_ms = 0;
+    uint32_t full_ms = 0;
+    bool tls = false;
+    for (int i = 0; i < BENCHMARK_RECONNECTS; i++) {
+        music_assistant_connection_t *connection =
+            music_assistant_connection_acquire(url, HTTP_METHOD_GET, BENCHMARK_ACQUIRE_TIMEOUT_MS);
+        if (connection == NULL) {
+            failed++;
+            continue;
+        }
+        /* A socket still open from an earlier request is only closed, not timed */
+        bool fresh = !connection->connected;
+        int64_t start_us = esp_timer_get_time();
+        esp_err_t err = music_assistant_connection_open(connection, 0);
+        uint32_t connect_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+        if (err == ESP_OK) {
+            /* Read the response: TLS 1.3 servers send the session ticket after the handshake */
+            esp_http_client_fetch_headers(connection->handle);
+            esp_http_client_flush_response(connection->handle, NULL);
+            if (fresh && connection->metrics.connects > 1) {
+                measured++;
+                total_ms += connect_ms;
+                min_ms = connect_ms < min_ms ? connect_ms : min_ms;
+                max_ms = connect_ms > max_ms ? connect_ms : max_ms;
+                full_ms = connection->metrics.full_connect_ms;
+                tls = connection->metrics.tls;
+            }
+        } else {
+            failed++;
+        }
+        music_assistant_connection_release(connection, false);
+    }
+    free(url);
+
+    if (measured == 0) {
+        ESP_LOGW(TAG, "Reconnects: none measured (%lu failed)", (unsigned long)failed);
+        return;
+    }
+    ESP_LOGI(TAG, "Reconnects (%s): %lu in avg %lu ms (min %lu, max %lu, %lu failed); "
+             "first connect of the connection (full handshake) %lu ms",
+             tls ? "TLS, session ticket offered" : "plain TCP", (unsigned long)measured,
+             (unsigned long)(total_ms / measured), (unsigned long)min_ms, (unsigned long)max_ms,
+             (unsigned long)failed, (unsigned long)full_ms);
+}
+
+static void benchmark_task(void *arg)
+{
+    (void)arg;
+    vTaskDelay(pdMS_TO_TICKS(BENCHMARK_START_DELAY_MS));
+
+    ESP_LOGI(TAG, "Sending %d transport commands per round", CONFIG_MUSIC_ASSISTANT_BENCHMARK_COMMANDS);
+    run_round("transport only", false);
+    run_round("transport + volume", true);
+    run_handshake_round();
+
+    music_assistant_lane_metrics_t lanes[LANE_COUNT];
+    size_t count = music_assistant_controller_get_metrics(lanes, LANE_COUNT);
+    for (size_t i = 0; i < count; i++) {
+        ESP_LOGI(TAG, "%s lane: max wait %lu ms since boot", lanes[i].lane, (unsigned long)lanes[i].max_wait_ms);
+    }
+    vTaskDelete(NULL);
+}
+
+static void benchmark_ip_event_handler(void *arg, esp_event_base_t event_base,
+                                       int32_t event_id, void *event_data)
+{
+    if (s_started) {
+        return;
+    }
+    s_started = true;
+    if (xTaskCreate(benchmark_task, "ma_bench", BENCHMARK_TASK_STACK_SIZE, NULL,
+                    BENCHMARK_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create benchmark task");
+    }
+}
+
+esp_err_t music_assistant_benchmark_init(void)
+{
+    ESP_LOGW(TAG, "Benchmark enabled: commands will be sent to %s", CONFIG_MUSIC_ASSISTANT_HOST);
+    return esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, benchmark_ip_event_handler, NULL);
+}
+
+#else
+
+esp_err_t music_assistant_benchmark_init(void)
+{
+    return ESP_OK;
+}
+
+#endif /* CONFIG_MUSIC_ASSISTANT_BENCHMARK */
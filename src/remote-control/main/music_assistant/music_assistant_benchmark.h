@@ -0,0 +1,25 @@
+#pragma once
+
+#include "esp_err.h"
+
+/**
+ * @file music_assistant_benchmark.h
+ * @brief On-device throughput measurement of the controller lanes
+ *
+ * With CONFIG_MUSIC_ASSISTANT_BENCHMARK, a one-shot task runs shortly after
+ * the first IP address and logs how many commands per second the controller
+ * gets through, transport commands alone and together with a stream of
+ * volume changes. Meant to run against tools/mock_ha_server.py, which adds a
+ * fixed latency to every response: the commands really change the player.
+ *
+ * Without the option this compiles to nothing.
+ */
+
+/**
+ * @brief Register for the first IP address; the benchmark starts after it
+ *
+ * Call after music_assistant_controller_init().
+ *
+ * @return ESP_OK on success (also when the benchmark is disabled), ESP_ERR_* on failure
+ */
+esp_err_t music_assistant_benchmark_init(void);
@@ -2,189 +2,511 @@
 #include "esp_http_client.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
 #include "common/config.h"
+#include "music_assistant_endpoint.h"
+#include "music_assistant_connection.h"
+#include "music_assistant_gzip.h"
+#include "music_assistant_playback_clock.h"
 
 static const char *TAG = "MUSIC_ASSISTANT_CLIENT";
 
 #define MAX_HTTP_RESPONSE_BUFFER 512
-
-static esp_err_t music_assistant_post_service(const char *service_path, const char *payload)
+#define MAX_REQUEST_VALUE_LENGTH 16
+#define STATE_BUFFER_SIZE 2048      /* State document incl. attributes; longer ones are truncated */
+#define GZIP_READ_CHUNK_SIZE 256    /* Compressed bytes read from the socket per inflate step */
+#define TEMPLATE_BUFFER_SIZE 96     /* "<position>|<updated epoch>|<state>" */
+
+/*
+ * Jinja template rendered by Home Assistant's /api/template endpoint. It
+ * projects the state document onto the fields a position query needs, with
+ * the update time already converted to a Unix epoch: "123.4|1772292069.01|playing".
+ * %s is replaced by CONFIG_MEDIA_PLAYER_ENTITY_ID (three times).
+ */
+#define POSITION_TEMPLATE_BODY \
+    "{\"template\":\"" \
+    "{{ state_attr('%s','media_position') | float(-1) }}|" \
+    "{{ as_timestamp(state_attr('%s','media_position_updated_at'), 0) }}|" \
+    "{{ states('%s') }}\"}"
+
+/* One entry per Home Assistant service call issued by this client */
+typedef enum {
+    MA_REQUEST_PLAY_MEDIA = 0,
+    MA_REQUEST_PREVIOUS_TRACK,
+    MA_REQUEST_PLAY_PAUSE,
+    MA_REQUEST_PLAY,
+    MA_REQUEST_PAUSE,
+    MA_REQUEST_NEXT_TRACK,
+    MA_REQUEST_VOLUME_SET,
+    MA_REQUEST_VOLUME_UP,
+    MA_REQUEST_VOLUME_DOWN,
+    MA_REQUEST_MEDIA_SEEK,
+    MA_REQUEST_COUNT,
+} ma_request_id_t;
+
+/**
+ * Static description of a request. The JSON body is split around the single
+ * variable field: body_prefix may contain one %s which is replaced by
+ * CONFIG_DEVICE_ID when the request is prepared. Only idempotent requests
+ * are retried, and only if the server did not get them or answered with a
+ * 5xx; a request that ran into its timeout may still be executing.
+ */
+typedef struct {
+    const char *service_path;
+    const char *body_prefix;
+    const char *body_suffix;
+    bool idempotent;
+} ma_request_def_t;
+
+static const ma_request_def_t s_request_defs[MA_REQUEST_COUNT] = {
+    [MA_REQUEST_PLAY_MEDIA] = {
+        "music_assistant/play_media",
+        "{\"device_id\":\"%s\",\"media_id\":\"", "\",\"enqueue\":\"replace\"}",
+        true
+    },
+    [MA_REQUEST_PREVIOUS_TRACK] = { "media_player/media_previous_track", "{\"device_id\":\"%s\"}", "", false },
+    [MA_REQUEST_PLAY_PAUSE]     = { "media_player/media_play_pause",     "{\"device_id\":\"%s\"}", "", false },
+    [MA_REQUEST_PLAY]           = { "media_player/media_play",           "{\"device_id\":\"%s\"}", "", true },
+    [MA_REQUEST_PAUSE]          = { "media_player/media_pause",          "{\"device_id\":\"%s\"}", "", true },
+    [MA_REQUEST_NEXT_TRACK]     = { "media_player/media_next_track",     "{\"device_id\":\"%s\"}", "", false },
+    /* Home Assistant/Music Assistant expects volume as a 0.0-1.0 float */
+    [MA_REQUEST_VOLUME_SET]     = { "media_player/volume_set", "{\"entity_id\":\"all\",\"volume_level\":", "}", true },
+    [MA_REQUEST_VOLUME_UP]      = { "media_player/volume_up",   "{\"device_id\":\"%s\"}", "", false },
+    [MA_REQUEST_VOLUME_DOWN]    = { "media_player/volume_down", "{\"device_id\":\"%s\"}", "", false },
+    /* seek_position is an absolute position for Home Assistant's media_seek */
+    [MA_REQUEST_MEDIA_SEEK]     = { "media_player/media_seek", "{\"device_id\":\"%s\",\"seek_position\":", "}", true },
+};
+
+/* Request template built once in music_assistant_client_init() */
+typedef struct {
+    char *url;
+    char *body_prefix;
+    size_t body_prefix_len;
+    size_t body_suffix_len;
+    music_assistant_endpoint_t endpoint;
+} ma_prepared_request_t;
+
+static ma_prepared_request_t s_requests[MA_REQUEST_COUNT];
+static char *s_auth_header = NULL;
+static char *s_state_url = NULL;
+static music_assistant_endpoint_t s_state_endpoint;
+static char *s_template_url = NULL;
+static char *s_template_body = NULL;
+static music_assistant_endpoint_t s_template_endpoint;
+static char *s_base_url = NULL;                 /* scheme://host[:port], prefix of picture paths */
+static music_assistant_endpoint_t s_picture_endpoint;
+static bool s_template_unsupported = false;     /* Server has no /api/template (404/405); use the state document */
+static volatile uint32_t s_template_refused_ms = 0; /* Uptime of the last 400/401/403 from /api/template, 0 = none */
+static bool s_initialized = false;
+static music_assistant_state_metrics_t s_state_metrics;
+static portMUX_TYPE s_state_metrics_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void music_assistant_release_requests(void)
 {
-    const char *host_cfg = CONFIG_MUSIC_ASSISTANT_HOST;
-    const char *api_key = CONFIG_MUSIC_ASSISTANT_API_KEY;
-
-    if (service_path == NULL || payload == NULL) {
-        ESP_LOGE(TAG, "service_path/payload is NULL");
-        return ESP_ERR_INVALID_ARG;
+    for (int i = 0; i < MA_REQUEST_COUNT; i++) {
+        free(s_requests[i].url);
+        free(s_requests[i].body_prefix);
     }
+    memset(s_requests, 0, sizeof(s_requests));
+    free(s_auth_header);
+    s_auth_header = NULL;
+    free(s_state_url);
+    s_state_url = NULL;
+    free(s_template_url);
+    s_template_url = NULL;
+    free(s_template_body);
+    s_template_body = NULL;
+    free(s_base_url);
+    s_base_url = NULL;
+    music_assistant_connection_pool_deinit();
+}
 
-    if (host_cfg == NULL || strlen(host_cfg) == 0) {
-        ESP_LOGW(TAG, "MUSIC_ASSISTANT_HOST not set in menuconfig");
-        return ESP_FAIL;
+static esp_err_t music_assistant_prepare_requests(const char *host_cfg, const char *device_id, const char *api_key)
+{
+    /* Decide on the scheme once instead of per call */
+    const char *scheme = (strncmp(host_cfg, "http", 4) == 0) ? "" : "http://";
+
+    for (int i = 0; i < MA_REQUEST_COUNT; i++) {
+        const ma_request_def_t *def = &s_request_defs[i];
+        ma_prepared_request_t *req = &s_requests[i];
+
+        if (asprintf(&req->url, "%s%s/api/services/%s", scheme, host_cfg, def->service_path) < 0 ||
+            asprintf(&req->body_prefix, def->body_prefix, device_id) < 0) {
+            req->url = NULL;
+            req->body_prefix = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+        req->body_prefix_len = strlen(req->body_prefix);
+        req->body_suffix_len = strlen(def->body_suffix);
+        music_assistant_endpoint_init(&req->endpoint, def->service_path,
+                                      CONFIG_MUSIC_ASSISTANT_SERVICE_TIMEOUT_MIN_MS);
     }
+    music_assistant_endpoint_init(&s_state_endpoint, "states", CONFIG_MUSIC_ASSISTANT_TIMEOUT_MIN_MS);
 
-    char url[320];
-    if (strncmp(host_cfg, "http", 4) == 0) {
-        snprintf(url, sizeof(url), "%s/api/services/%s", host_cfg, service_path);
-    } else {
-        snprintf(url, sizeof(url), "http://%s/api/services/%s", host_cfg, service_path);
+    if (asprintf(&s_state_url, "%s%s/api/states/%s", scheme, host_cfg, CONFIG_MEDIA_PLAYER_ENTITY_ID) < 0) {
+        s_state_url = NULL;
+        return ESP_ERR_NO_MEM;
     }
 
-    // Buffer to capture response body
-    char *response_buffer = malloc(MAX_HTTP_RESPONSE_BUFFER);
-    if (!response_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate response buffer");
+    music_assistant_endpoint_init(&s_picture_endpoint, "picture", CONFIG_MUSIC_ASSISTANT_TIMEOUT_MIN_MS);
+    if (asprintf(&s_base_url, "%s%s", scheme, host_cfg) < 0) {
+        s_base_url = NULL;
         return ESP_ERR_NO_MEM;
     }
-    memset(response_buffer, 0, MAX_HTTP_RESPONSE_BUFFER);
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .method = HTTP_METHOD_POST,
-        .timeout_ms = HTTP_REQUEST_TIMEOUT_MS,
-        .buffer_size = MAX_HTTP_RESPONSE_BUFFER,
-        .user_data = response_buffer,
-    };
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to init HTTP client");
-        free(response_buffer);
-        return ESP_FAIL;
+    music_assistant_endpoint_init(&s_template_endpoint, "template", CONFIG_MUSIC_ASSISTANT_TIMEOUT_MIN_MS);
+    if (asprintf(&s_template_url, "%s%s/api/template", scheme, host_cfg) < 0) {
+        s_template_url = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    if (asprintf(&s_template_body, POSITION_TEMPLATE_BODY, CONFIG_MEDIA_PLAYER_ENTITY_ID,
+                 CONFIG_MEDIA_PLAYER_ENTITY_ID, CONFIG_MEDIA_PLAYER_ENTITY_ID) < 0) {
+        s_template_body = NULL;
+        return ESP_ERR_NO_MEM;
     }
 
-    char auth_header[256] = {0};
     if (api_key && strlen(api_key) > 0) {
-        snprintf(auth_header, sizeof(auth_header), "Bearer %s", api_key);
-        esp_http_client_set_header(client, "Authorization", auth_header);
+        if (asprintf(&s_auth_header, "Bearer %s", api_key) < 0) {
+            s_auth_header = NULL;
+            return ESP_ERR_NO_MEM;
+        }
     } else {
         ESP_LOGW(TAG, "MUSIC_ASSISTANT_API_KEY not set; proceeding without Authorization header");
     }
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, payload, strlen(payload));
 
-    // Log the request details
-    ESP_LOGI(TAG, "POST %s", url);
-    ESP_LOGI(TAG, "Payload: %s", payload);
+    return music_assistant_connection_pool_init(s_state_url, s_auth_header);
+}
+
+static esp_err_t music_assistant_write_all(esp_http_client_handle_t client, const char *data, size_t len)
+{
+    while (len > 0) {
+        int written = esp_http_client_write(client, data, (int)len);
+        if (written <= 0) {
+            return ESP_FAIL;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Account a request that got no response. Only failures that actually used up
+ * the timeout back the endpoint off; fast failures (connection refused, no
+ * route) say nothing about the round-trip time.
+ *
+ * Returns true if the request timed out.
+ */
+static bool music_assistant_note_failure(music_assistant_endpoint_t *endpoint, int64_t sent_us, int timeout_ms)
+{
+    if (esp_timer_get_time() - sent_us >= (int64_t)timeout_ms * 1000) {
+        music_assistant_endpoint_on_timeout(endpoint);
+        return true;
+    }
+    return false;
+}
 
-    esp_err_t err = esp_http_client_perform(client);
+/**
+ * Execute a prepared request once. Only the variable field is supplied per
+ * call; URL, headers and the static parts of the body come from the template
+ * and are streamed to the socket without assembling the payload in a buffer.
+ *
+ * out_status receives the HTTP status, or 0 if no response was received.
+ * out_timed_out is set if the request was sent but not answered within the
+ * timeout, i.e. the server may still be carrying it out.
+ */
+static esp_err_t music_assistant_execute_once(ma_request_id_t id, const char *value, int *out_status,
+                                              bool *out_timed_out)
+{
+    *out_status = 0;
+    *out_timed_out = false;
+
+    int64_t start_us = esp_timer_get_time();
+    const ma_request_def_t *def = &s_request_defs[id];
+    ma_prepared_request_t *req = &s_requests[id];
+    size_t value_len = value ? strlen(value) : 0;
+    int content_length = (int)(req->body_prefix_len + value_len + req->body_suffix_len);
+    int timeout_ms = music_assistant_endpoint_timeout_ms(&req->endpoint);
+
+    music_assistant_connection_t *connection = music_assistant_connection_acquire(req->url, HTTP_METHOD_POST, timeout_ms);
+    if (!connection) {
+        ESP_LOGE(TAG, "No HTTP connection available");
+        return ESP_FAIL;
+    }
+    esp_http_client_handle_t client = connection->handle;
+
+    ESP_LOGI(TAG, "POST %s", req->url);
+    ESP_LOGD(TAG, "Payload: %s%s%s", req->body_prefix, value ? value : "", def->body_suffix);
+
+    int64_t prepared_us = esp_timer_get_time();
+
+    esp_err_t err = music_assistant_connection_open(connection, content_length);
+    if (err == ESP_OK) {
+        err = music_assistant_write_all(client, req->body_prefix, req->body_prefix_len);
+    }
+    if (err == ESP_OK && value_len > 0) {
+        err = music_assistant_write_all(client, value, value_len);
+    }
+    if (err == ESP_OK && req->body_suffix_len > 0) {
+        err = music_assistant_write_all(client, def->body_suffix, req->body_suffix_len);
+    }
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP POST request failed for service '%s': %s", service_path, esp_err_to_name(err));
-        esp_http_client_cleanup(client);
-        free(response_buffer);
+        ESP_LOGE(TAG, "HTTP POST request failed for service '%s': %s", def->service_path, esp_err_to_name(err));
+        music_assistant_note_failure(&req->endpoint, prepared_us, timeout_ms);
+        music_assistant_connection_release(connection, false);
         return ESP_FAIL;
     }
 
+    int64_t response_length = esp_http_client_fetch_headers(client);
     int status = esp_http_client_get_status_code(client);
-    int content_length = esp_http_client_get_content_length(client);
-    
-    // Read response body
-    int data_read = esp_http_client_read_response(client, response_buffer, MAX_HTTP_RESPONSE_BUFFER - 1);
-    if (data_read >= 0) {
-        response_buffer[data_read] = '\0';
+    if (response_length < 0 && status <= 0) {
+        ESP_LOGE(TAG, "No response for service '%s' within %d ms", def->service_path, timeout_ms);
+        *out_timed_out = music_assistant_note_failure(&req->endpoint, prepared_us, timeout_ms);
+        music_assistant_connection_release(connection, false);
+        return ESP_FAIL;
     }
+    music_assistant_endpoint_on_response(&req->endpoint, esp_timer_get_time() - prepared_us);
+    *out_status = status;
 
-    ESP_LOGI(TAG, "Service '%s' completed, status=%d, len=%d", service_path, status, content_length);
+    ESP_LOGI(TAG, "Service '%s' completed, status=%d, len=%lld", def->service_path, status, (long long)response_length);
+    ESP_LOGD(TAG, "Request prepared in %lld us, round trip %lld us",
+             (long long)(prepared_us - start_us), (long long)(esp_timer_get_time() - prepared_us));
 
-    // Log response body on error
     if (status < 200 || status >= 300) {
-        ESP_LOGE(TAG, "HTTP %d Error Response: %s", status, response_buffer);
-        esp_http_client_cleanup(client);
-        free(response_buffer);
+        /* Only allocate a body buffer on the error path */
+        char *response_buffer = calloc(1, MAX_HTTP_RESPONSE_BUFFER);
+        if (response_buffer) {
+            int data_read = esp_http_client_read_response(client, response_buffer, MAX_HTTP_RESPONSE_BUFFER - 1);
+            if (data_read >= 0) {
+                response_buffer[data_read] = '\0';
+            }
+            ESP_LOGE(TAG, "HTTP %d Error Response: %s", status, response_buffer);
+            free(response_buffer);
+        } else {
+            ESP_LOGE(TAG, "HTTP %d Error Response", status);
+        }
+        /* Drain what is left so the connection can carry the next request */
+        bool drained = esp_http_client_flush_response(client, NULL) == ESP_OK;
+        music_assistant_connection_release(connection, drained);
         return ESP_FAIL;
     }
 
-    // Log success response for debugging
-    if (data_read > 0) {
-        ESP_LOGD(TAG, "Response body: %s", response_buffer);
-    }
-
-    esp_http_client_cleanup(client);
-    free(response_buffer);
+    bool drained = esp_http_client_flush_response(client, NULL) == ESP_OK;
+    music_assistant_connection_release(connection, drained);
     return ESP_OK;
 }
 
-static esp_err_t music_assistant_send_player_command(const char *command)
+static bool music_assistant_is_retryable(int status)
 {
-    const char *device_id = CONFIG_DEVICE_ID;
+    /* No response at all or a server-side error; 4xx will not get better */
+    return status <= 0 || status >= 500;
+}
 
-    if (command == NULL || strlen(command) == 0) {
-        return ESP_ERR_INVALID_ARG;
+static uint32_t music_assistant_retry_delay_ms(int retry)
+{
+    /* Full jitter: uniform in [0, base * 2^retry] so parallel callers spread out */
+    uint32_t cap_ms = (uint32_t)CONFIG_MUSIC_ASSISTANT_RETRY_BASE_DELAY_MS << retry;
+    return esp_random() % (cap_ms + 1);
+}
+
+/* Move the local playback clock along with a command the player accepted */
+static void music_assistant_update_playback_clock(ma_request_id_t id, const char *value)
+{
+    switch (id) {
+        case MA_REQUEST_PLAY_MEDIA:
+        case MA_REQUEST_PREVIOUS_TRACK:
+        case MA_REQUEST_NEXT_TRACK:
+            music_assistant_playback_clock_set_position(0.0f, true);
+            break;
+        case MA_REQUEST_PLAY:
+            music_assistant_playback_clock_set_playing(true);
+            break;
+        case MA_REQUEST_PAUSE:
+            music_assistant_playback_clock_set_playing(false);
+            break;
+        case MA_REQUEST_PLAY_PAUSE:
+            /* Toggle: the resulting state is not known here */
+            music_assistant_playback_clock_invalidate();
+            break;
+        case MA_REQUEST_MEDIA_SEEK:
+            music_assistant_playback_clock_seek(strtof(value, NULL));
+            break;
+        default:
+            break;
     }
+}
+
+/**
+ * Execute a prepared request through the endpoint's circuit breaker, retrying
+ * idempotent requests up to CONFIG_MUSIC_ASSISTANT_RETRY_MAX times. A request
+ * that timed out is not retried: Home Assistant answers a service call only
+ * after executing it, so a slow play_media would otherwise be run twice.
+ */
+static esp_err_t music_assistant_execute(ma_request_id_t id, const char *value)
+{
+    if (!s_initialized) {
+        ESP_LOGW(TAG, "Client not initialized (is MUSIC_ASSISTANT_HOST set in menuconfig?)");
+        return ESP_FAIL;
+    }
+
+    const ma_request_def_t *def = &s_request_defs[id];
+    ma_prepared_request_t *req = &s_requests[id];
+    int max_attempts = def->idempotent ? 1 + CONFIG_MUSIC_ASSISTANT_RETRY_MAX : 1;
+    esp_err_t err = ESP_FAIL;
+
+    for (int attempt = 0; attempt < max_attempts; attempt++) {
+        if (attempt > 0) {
+            uint32_t delay_ms = music_assistant_retry_delay_ms(attempt - 1);
+            ESP_LOGW(TAG, "Retrying service '%s' in %lu ms (attempt %d/%d)",
+                     def->service_path, (unsigned long)delay_ms, attempt + 1, max_attempts);
+            vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        }
+
+        err = music_assistant_endpoint_acquire(&req->endpoint);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Service '%s' rejected, circuit breaker open", def->service_path);
+            return err;
+        }
 
-    char payload[256];
-    snprintf(payload, sizeof(payload),
-             "{\"device_id\":\"%s\",\"command\":\"%s\"}",
-             device_id, command);
+        int status = 0;
+        bool timed_out = false;
+        err = music_assistant_execute_once(id, value, &status, &timed_out);
+        if (music_assistant_is_retryable(status)) {
+            music_assistant_endpoint_on_failure(&req->endpoint);
+        } else {
+            music_assistant_endpoint_on_success(&req->endpoint);
+        }
+
+        if (err == ESP_OK || !music_assistant_is_retryable(status)) {
+            break;
+        }
+        if (timed_out) {
+            ESP_LOGW(TAG, "Service '%s' not retried: it may still be executing", def->service_path);
+            break;
+        }
+    }
 
-    return music_assistant_post_service("music_assistant/player_command", payload);
+    if (err == ESP_OK) {
+        music_assistant_update_playback_clock(id, value);
+    }
+    return err;
 }
 
-static esp_err_t music_assistant_call_media_player_service(const char *service_name)
+esp_err_t music_assistant_client_init(void)
 {
+    const char *host_cfg = CONFIG_MUSIC_ASSISTANT_HOST;
+    const char *api_key = CONFIG_MUSIC_ASSISTANT_API_KEY;
+    /* A literal from config.h: an empty ID is a build error, not a boot loop on ESP_ERROR_CHECK */
+    _Static_assert(sizeof(CONFIG_DEVICE_ID) > 1, "CONFIG_DEVICE_ID in common/config.h must not be empty");
     const char *device_id = CONFIG_DEVICE_ID;
 
-    if (service_name == NULL || strlen(service_name) == 0) {
-        return ESP_ERR_INVALID_ARG;
+    if (s_initialized) {
+        return ESP_OK;
     }
 
-    if (device_id == NULL || strlen(device_id) == 0) {
-        ESP_LOGE(TAG, "DEVICE_ID not set");
-        return ESP_ERR_INVALID_STATE;
+    if (host_cfg == NULL || strlen(host_cfg) == 0) {
+        /* Not fatal: the panel still works offline, every call will fail fast */
+        ESP_LOGW(TAG, "MUSIC_ASSISTANT_HOST not set in menuconfig");
+        return ESP_OK;
     }
 
-    char service_path[96];
-    snprintf(service_path, sizeof(service_path), "media_player/%s", service_name);
-
-    char payload[256];
-    snprintf(payload, sizeof(payload),
-             "{\"device_id\":\"%s\"}",
-             device_id);
+    esp_err_t err = music_assistant_prepare_requests(host_cfg, device_id, api_key);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to prepare request templates: %s", esp_err_to_name(err));
+        music_assistant_release_requests();
+        return err;
+    }
 
-    return music_assistant_post_service(service_path, payload);
+    s_initialized = true;
+    ESP_LOGI(TAG, "Music Assistant client initialized (%d prepared requests)", MA_REQUEST_COUNT);
+    return ESP_OK;
 }
 
-esp_err_t music_assistant_client_init(void)
+/*
+ * Escape a string for use inside a JSON string literal. Returns NULL in
+ * *escaped if nothing needs escaping (the usual case), so the caller can
+ * send the original.
+ */
+static esp_err_t music_assistant_json_escape(const char *text, char **escaped)
 {
-    ESP_LOGI(TAG, "Music Assistant client initialized");
+    size_t extra = 0;
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++) {
+        extra += (*c == '"' || *c == '\\') ? 1 : (*c < 0x20 ? 5 : 0);
+    }
+    *escaped = NULL;
+    if (extra == 0) {
+        return ESP_OK;
+    }
+
+    char *out = malloc(strlen(text) + extra + 1);
+    if (out == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    char *o = out;
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            *o++ = '\\';
+            *o++ = (char)*c;
+        } else if (*c < 0x20) {
+            o += sprintf(o, "\\u%04x", *c);
+        } else {
+            *o++ = (char)*c;
+        }
+    }
+    *o = '\0';
+    *escaped = out;
     return ESP_OK;
 }
 
 esp_err_t music_assistant_play_media(const char *media_id)
 {
-    const char *device_id = CONFIG_DEVICE_ID;
-
     if (!media_id) {
         ESP_LOGE(TAG, "media_id is NULL");
         return ESP_ERR_INVALID_ARG;
     }
 
-    /* Construct JSON payload */
-    char payload[512];
-    snprintf(payload, sizeof(payload),
-             "{\"device_id\":\"%s\",\"media_id\":\"%s\",\"enqueue\":\"replace\"}",
-             device_id, media_id);
-
-    return music_assistant_post_service("music_assistant/play_media", payload);
+    /* Media IDs come from cards: never let one end the JSON string early */
+    char *escaped = NULL;
+    esp_err_t err = music_assistant_json_escape(media_id, &escaped);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = music_assistant_execute(MA_REQUEST_PLAY_MEDIA, escaped ? escaped : media_id);
+    free(escaped);
+    return err;
 }
 
 esp_err_t music_assistant_previous_track(void)
 {
-    return music_assistant_call_media_player_service("media_previous_track");
+    return music_assistant_execute(MA_REQUEST_PREVIOUS_TRACK, NULL);
 }
 
 esp_err_t music_assistant_play_pause(void)
 {
-    return music_assistant_call_media_player_service("media_play_pause");
+    return music_assistant_execute(MA_REQUEST_PLAY_PAUSE, NULL);
+}
+
+esp_err_t music_assistant_play(void)
+{
+    return music_assistant_execute(MA_REQUEST_PLAY, NULL);
+}
+
+esp_err_t music_assistant_pause(void)
+{
+    return music_assistant_execute(MA_REQUEST_PAUSE, NULL);
 }
 
 esp_err_t music_assistant_next_track(void)
 {
-    return music_assistant_call_media_player_service("media_next_track");
+    return music_assistant_execute(MA_REQUEST_NEXT_TRACK, NULL);
 }
 
 esp_err_t music_assistant_set_volume(int volume_level)
@@ -195,252 +517,763 @@ esp_err_t music_assistant_set_volume(int volume_level)
         return ESP_ERR_INVALID_ARG;
     }
 
-    /* Convert 0-100 to 0.0-1.0 float as Home Assistant/Music Assistant expects */
-    float volume_float = volume_level / 100.0f;
-
-    char payload[256];
-    snprintf(payload, sizeof(payload),
-             "{\"entity_id\":\"all\",\"volume_level\":%.2f}", volume_float);
+    char value[MAX_REQUEST_VALUE_LENGTH];
+    snprintf(value, sizeof(value), "%.2f", volume_level / 100.0f);
 
-    return music_assistant_post_service("media_player/volume_set", payload);
+    return music_assistant_execute(MA_REQUEST_VOLUME_SET, value);
 }
 
 esp_err_t music_assistant_volume_up(void)
 {
-    const char *device_id = CONFIG_DEVICE_ID;
-
-    if (device_id == NULL || strlen(device_id) == 0) {
-        ESP_LOGE(TAG, "DEVICE_ID not set");
-        return ESP_ERR_INVALID_STATE;
-    }
-
-    char payload[256];
-    snprintf(payload, sizeof(payload),
-             "{\"device_id\":\"%s\"}",
-             device_id);
-
-    return music_assistant_post_service("media_player/volume_up", payload);
+    return music_assistant_execute(MA_REQUEST_VOLUME_UP, NULL);
 }
 
 esp_err_t music_assistant_volume_down(void)
 {
-    const char *device_id = CONFIG_DEVICE_ID;
-
-    if (device_id == NULL || strlen(device_id) == 0) {
-        ESP_LOGE(TAG, "DEVICE_ID not set");
-        return ESP_ERR_INVALID_STATE;
-    }
-
-    char payload[256];
-    snprintf(payload, sizeof(payload),
-             "{\"device_id\":\"%s\"}",
-             device_id);
-
-    return music_assistant_post_service("media_player/volume_down", payload);
+    return music_assistant_execute(MA_REQUEST_VOLUME_DOWN, NULL);
 }
 
 esp_err_t music_assistant_seek_forward(int seconds)
 {
-    const char *device_id = CONFIG_DEVICE_ID;
-
-    if (device_id == NULL || strlen(device_id) == 0) {
-        ESP_LOGE(TAG, "DEVICE_ID not set");
-        return ESP_ERR_INVALID_STATE;
-    }
-
     if (seconds <= 0) {
         seconds = 10;
     }
 
-    char payload[256];
-    snprintf(payload, sizeof(payload),
-             "{\"device_id\":\"%s\",\"seek_position\":%d}",
-             device_id, seconds);
-
-    return music_assistant_post_service("media_player/media_seek", payload);
+    /* media_seek takes an absolute position */
+    float position = 0.0f;
+    esp_err_t err = music_assistant_estimate_media_position(&position);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return music_assistant_seek_to_position(position + (float)seconds);
 }
 
 esp_err_t music_assistant_seek_backward(int seconds)
 {
-    const char *device_id = CONFIG_DEVICE_ID;
-
-    if (device_id == NULL || strlen(device_id) == 0) {
-        ESP_LOGE(TAG, "DEVICE_ID not set");
-        return ESP_ERR_INVALID_STATE;
-    }
-
     if (seconds <= 0) {
         seconds = 10;
     }
 
-    char payload[256];
-    snprintf(payload, sizeof(payload),
-             "{\"device_id\":\"%s\",\"seek_position\":-%d}",
-             device_id, seconds);
+    float position = 0.0f;
+    esp_err_t err = music_assistant_estimate_media_position(&position);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return music_assistant_seek_to_position(position - (float)seconds);
+}
 
-    return music_assistant_post_service("media_player/media_seek", payload);
+static void music_assistant_account_body(music_assistant_body_metrics_t *metrics,
+                                         int wire_bytes, int document_bytes, int64_t body_us)
+{
+    portENTER_CRITICAL(&s_state_metrics_lock);
+    metrics->responses++;
+    metrics->wire_bytes += (uint32_t)wire_bytes;
+    metrics->document_bytes += (uint32_t)document_bytes;
+    metrics->body_us += (uint64_t)body_us;
+    portEXIT_CRITICAL(&s_state_metrics_lock);
 }
-esp_err_t music_assistant_get_media_position(float *position)
+
+/* Read an uncompressed body; the body may arrive in several segments */
+static int music_assistant_read_identity(esp_http_client_handle_t client, char *buffer, int size)
 {
-    const char *host_cfg = CONFIG_MUSIC_ASSISTANT_HOST;
-    const char *api_key = CONFIG_MUSIC_ASSISTANT_API_KEY;
-    const char *entity_id = CONFIG_MEDIA_PLAYER_ENTITY_ID;
+    int data_read = 0;
+    while (data_read < size - 1) {
+        int chunk = esp_http_client_read(client, buffer + data_read, size - 1 - data_read);
+        if (chunk <= 0) {
+            break;
+        }
+        data_read += chunk;
+    }
+    buffer[data_read] = '\0';
+    return data_read;
+}
 
-    if (position == NULL) {
-        ESP_LOGE(TAG, "position pointer is NULL");
-        return ESP_ERR_INVALID_ARG;
+/* Inflate a gzip body chunk by chunk into buffer; returns the document length or -1 */
+static int music_assistant_read_gzip(esp_http_client_handle_t client, char *buffer, int size, int *wire_bytes)
+{
+    uint8_t chunk[GZIP_READ_CHUNK_SIZE];
+    *wire_bytes = 0;
+
+    music_assistant_gzip_t *gzip = music_assistant_gzip_create(buffer, size);
+    if (gzip == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate gzip decoder");
+        return -1;
     }
 
-    if (host_cfg == NULL || strlen(host_cfg) == 0) {
-        ESP_LOGW(TAG, "MUSIC_ASSISTANT_HOST not set in menuconfig");
-        return ESP_FAIL;
+    int result = 0;
+    while (!music_assistant_gzip_done(gzip)) {
+        int len = esp_http_client_read(client, (char *)chunk, sizeof(chunk));
+        if (len <= 0) {
+            break;
+        }
+        *wire_bytes += len;
+        if (music_assistant_gzip_feed(gzip, chunk, (size_t)len) != ESP_OK) {
+            ESP_LOGE(TAG, "Corrupt gzip body after %d bytes", *wire_bytes);
+            result = -1;
+            break;
+        }
+    }
+    if (result == 0) {
+        result = (int)music_assistant_gzip_output_len(gzip);
     }
+    music_assistant_gzip_destroy(gzip);
+    return result;
+}
 
-    if (entity_id == NULL || strlen(entity_id) == 0) {
-        ESP_LOGE(TAG, "CONFIG_MEDIA_PLAYER_ENTITY_ID not set");
-        return ESP_ERR_INVALID_STATE;
+/* A read query whose response body is returned to the caller */
+typedef struct {
+    const char *name;                       /* For logs */
+    const char *url;
+    music_assistant_endpoint_t *endpoint;
+    const char *body;                       /* POST body, or NULL for GET */
+    size_t body_len;
+    int buffer_size;                        /* Longer responses are truncated */
+    bool accept_gzip;
+    music_assistant_body_metrics_t *identity_metrics;   /* Where uncompressed bodies are counted */
+} ma_query_t;
+
+/**
+ * Run a query. On HTTP 2xx *out_document is a NUL-terminated heap buffer the
+ * caller must free. out_status receives the HTTP status, or 0 if no response
+ * was received.
+ */
+static esp_err_t music_assistant_query(const ma_query_t *query, char **out_document, int *out_status)
+{
+    *out_document = NULL;
+    *out_status = 0;
+
+    if (!s_initialized) {
+        ESP_LOGW(TAG, "Client not initialized (is MUSIC_ASSISTANT_HOST set in menuconfig?)");
+        return ESP_FAIL;
     }
 
-    char url[320];
-    if (strncmp(host_cfg, "http", 4) == 0) {
-        snprintf(url, sizeof(url), "%s/api/states/%s", host_cfg, entity_id);
-    } else {
-        snprintf(url, sizeof(url), "http://%s/api/states/%s", host_cfg, entity_id);
+    music_assistant_endpoint_t *endpoint = query->endpoint;
+    esp_err_t err = music_assistant_endpoint_acquire(endpoint);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "%s query rejected, circuit breaker open", query->name);
+        return err;
     }
 
-    // Allocate larger buffer for state response (can be quite large with all attributes)
-    const int STATE_BUFFER_SIZE = 2048;
-    char *response_buffer = malloc(STATE_BUFFER_SIZE);
+    char *response_buffer = calloc(1, query->buffer_size);
     if (!response_buffer) {
         ESP_LOGE(TAG, "Failed to allocate response buffer");
+        music_assistant_endpoint_on_failure(endpoint);
         return ESP_ERR_NO_MEM;
     }
-    memset(response_buffer, 0, STATE_BUFFER_SIZE);
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .method = HTTP_METHOD_GET,
-        .timeout_ms = HTTP_REQUEST_TIMEOUT_MS,
-        .buffer_size = STATE_BUFFER_SIZE,
-        .user_data = response_buffer,
-    };
+    int timeout_ms = music_assistant_endpoint_timeout_ms(endpoint);
+    esp_http_client_method_t method = query->body ? HTTP_METHOD_POST : HTTP_METHOD_GET;
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to init HTTP client");
+    music_assistant_connection_t *connection = music_assistant_connection_acquire(query->url, method, timeout_ms);
+    if (!connection) {
+        ESP_LOGE(TAG, "No HTTP connection available");
+        music_assistant_endpoint_on_failure(endpoint);
         free(response_buffer);
         return ESP_FAIL;
     }
-
-    char auth_header[256] = {0};
-    if (api_key && strlen(api_key) > 0) {
-        snprintf(auth_header, sizeof(auth_header), "Bearer %s", api_key);
-        esp_http_client_set_header(client, "Authorization", auth_header);
+    esp_http_client_handle_t client = connection->handle;
+    if (query->accept_gzip) {
+        /* Only requests for large, repetitive JSON ask for compression */
+        esp_http_client_set_header(client, "Accept-Encoding", "gzip");
     }
 
-    esp_err_t err = esp_http_client_open(client, 0);
+    int64_t sent_us = esp_timer_get_time();
+    err = music_assistant_connection_open(connection, (int)query->body_len);
+    if (err == ESP_OK && query->body) {
+        err = music_assistant_write_all(client, query->body, query->body_len);
+    }
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
+        ESP_LOGE(TAG, "%s query failed: %s", query->name, esp_err_to_name(err));
+        music_assistant_note_failure(endpoint, sent_us, timeout_ms);
+        music_assistant_endpoint_on_failure(endpoint);
+        if (query->accept_gzip) {
+            esp_http_client_delete_header(client, "Accept-Encoding");
+        }
+        music_assistant_connection_release(connection, false);
         free(response_buffer);
         return ESP_FAIL;
     }
 
     int content_length = esp_http_client_fetch_headers(client);
     int status = esp_http_client_get_status_code(client);
-    
+    if (content_length < 0 && status <= 0) {
+        music_assistant_note_failure(endpoint, sent_us, timeout_ms);
+    } else {
+        music_assistant_endpoint_on_response(endpoint, esp_timer_get_time() - sent_us);
+    }
+    if (music_assistant_is_retryable(status)) {
+        music_assistant_endpoint_on_failure(endpoint);
+    } else {
+        music_assistant_endpoint_on_success(endpoint);
+    }
+    *out_status = status;
+
     int data_read = 0;
-    if (status >= 200 && status < 300 && content_length > 0) {
-        data_read = esp_http_client_read(client, response_buffer, STATE_BUFFER_SIZE - 1);
-        if (data_read >= 0) {
-            response_buffer[data_read] = '\0';
+    if (status >= 200 && status < 300) {
+        int64_t body_start_us = esp_timer_get_time();
+        if (connection->gzip_response) {
+            int wire_bytes = 0;
+            data_read = music_assistant_read_gzip(client, response_buffer, query->buffer_size, &wire_bytes);
+            if (data_read >= 0) {
+                music_assistant_account_body(&s_state_metrics.gzip, wire_bytes, data_read,
+                                             esp_timer_get_time() - body_start_us);
+                ESP_LOGD(TAG, "Inflated %d -> %d bytes", wire_bytes, data_read);
+            }
+        } else {
+            data_read = music_assistant_read_identity(client, response_buffer, query->buffer_size);
+            music_assistant_account_body(query->identity_metrics, data_read, data_read,
+                                         esp_timer_get_time() - body_start_us);
         }
     }
 
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
+    if (query->accept_gzip) {
+        esp_http_client_delete_header(client, "Accept-Encoding");
+    }
+    /* Keep the connection only if nothing of the response is left unread */
+    bool drained = status > 0 && esp_http_client_flush_response(client, NULL) == ESP_OK;
+    music_assistant_connection_release(connection, drained);
 
-    if (status < 200 || status >= 300) {
-        ESP_LOGE(TAG, "HTTP %d Error getting state", status);
+    if (status < 200 || status >= 300 || data_read < 0) {
+        ESP_LOGE(TAG, "HTTP %d Error in %s query", status, query->name);
         free(response_buffer);
         return ESP_FAIL;
     }
 
-    // Log response for debugging
-    ESP_LOGI(TAG, "State response (%d bytes): %s", data_read, response_buffer);
+    ESP_LOGD(TAG, "%s response (%d bytes): %s", query->name, data_read, response_buffer);
+    *out_document = response_buffer;
+    return ESP_OK;
+}
+
+/**
+ * GET the player entity's state document. On success *out_document is a
+ * NUL-terminated heap buffer the caller must free.
+ */
+static esp_err_t music_assistant_fetch_state(char **out_document)
+{
+    const ma_query_t query = {
+        .name = "state",
+        .url = s_state_url,
+        .endpoint = &s_state_endpoint,
+        .buffer_size = STATE_BUFFER_SIZE,
+        .identity_metrics = &s_state_metrics.identity,
+#if CONFIG_MUSIC_ASSISTANT_STATE_GZIP
+        .accept_gzip = true,
+#endif
+    };
+    int status = 0;
+    return music_assistant_query(&query, out_document, &status);
+}
+
+/**
+ * Position query via /api/template: tens of bytes instead of the state
+ * document, and the timestamp arrives as an epoch, so no date parsing.
+ * Returns ESP_ERR_NOT_SUPPORTED if the server refuses the template API.
+ */
+static esp_err_t music_assistant_get_media_position_template(float *position)
+{
+    const ma_query_t query = {
+        .name = "template",
+        .url = s_template_url,
+        .endpoint = &s_template_endpoint,
+        .body = s_template_body,
+        .body_len = strlen(s_template_body),
+        .buffer_size = TEMPLATE_BUFFER_SIZE,
+        .identity_metrics = &s_state_metrics.template_query,
+    };
+
+    char *response = NULL;
+    int status = 0;
+    esp_err_t err = music_assistant_query(&query, &response, &status);
+    if (err != ESP_OK) {
+        if (status == 404 || status == 405) {
+            /* Older server: the template API does not exist */
+            ESP_LOGW(TAG, "Template API unavailable (HTTP %d), using the full state document", status);
+            s_template_unsupported = true;
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        if (status == 400 || status == 401 || status == 403) {
+            /* Token without admin rights, or a rejected render: may change, so try again later */
+            ESP_LOGW(TAG, "Template API refused (HTTP %d), using the full state document for %d s",
+                     status, TEMPLATE_API_RETRY_MS / 1000);
+            uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+            s_template_refused_ms = now_ms != 0 ? now_ms : 1;
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        return err;
+    }
+
+    char *cursor = response;
+    float base_position = strtof(cursor, &cursor);
+    double updated_epoch = (*cursor == '|') ? strtod(cursor + 1, &cursor) : 0.0;
+    const char *state = (*cursor == '|') ? cursor + 1 : "";
+
+    if (base_position < 0.0f) {
+        ESP_LOGW(TAG, "media_position not available (state '%s')", state);
+        free(response);
+        return ESP_FAIL;
+    }
+
+    /* The playback clock accounts for the time since the update if the wall clock is synced */
+    music_assistant_playback_clock_seed(base_position, updated_epoch, strcmp(state, "playing") == 0);
+    if (music_assistant_playback_clock_get_position(position) != ESP_OK) {
+        *position = base_position;
+    }
+
+    ESP_LOGI(TAG, "Base position: %.1fs (%s), current position: %.1fs", base_position, state, *position);
+    free(response);
+    return ESP_OK;
+}
 
+/* Days since 1970-01-01 of a proleptic Gregorian date (H. Hinnant's days_from_civil) */
+static int64_t days_from_civil(int year, int month, int day)
+{
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t year_of_era = year - era * 400;
+    int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+/*
+ * Parse an ISO 8601 timestamp as Home Assistant writes it,
+ * "2026-02-28T15:21:09.014396+00:00", into Unix time. The arithmetic is done
+ * in UTC, independent of TZ (mktime() would read it as local time); the
+ * fraction and the UTC offset (+hh:mm, -hh:mm or Z) are honoured.
+ */
+static esp_err_t music_assistant_parse_timestamp(const char *text, double *epoch)
+{
+    int year, month, day, hour, minute, second, consumed = 0;
+    if (sscanf(text, "%4d-%2d-%2dT%2d:%2d:%2d%n", &year, &month, &day, &hour, &minute, &second, &consumed) != 6 ||
+        month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const char *cursor = text + consumed;
+
+    double fraction = 0.0;
+    if (*cursor == '.') {
+        double scale = 0.1;
+        for (cursor++; *cursor >= '0' && *cursor <= '9'; cursor++) {
+            fraction += (*cursor - '0') * scale;
+            scale /= 10.0;
+        }
+    }
+
+    int offset_s = 0;
+    if (*cursor == '+' || *cursor == '-') {
+        int offset_hours, offset_minutes;
+        if (sscanf(cursor + 1, "%2d:%2d", &offset_hours, &offset_minutes) != 2) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        offset_s = (offset_hours * 60 + offset_minutes) * 60 * (*cursor == '-' ? -1 : 1);
+    } else if (*cursor != 'Z' && *cursor != '"' && *cursor != '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t seconds = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    /* The local time is ahead of UTC by the offset */
+    *epoch = (double)(seconds - offset_s) + fraction;
+    return ESP_OK;
+}
+
+/* Seed the playback clock from media_position(_updated_at) in a state document */
+static esp_err_t music_assistant_seed_clock_from_state(const char *response_buffer, float *position)
+{
     // Parse JSON to extract media_position and media_position_updated_at
-    char *pos_str = strstr(response_buffer, "\"media_position\":");
-    char *updated_str = strstr(response_buffer, "\"media_position_updated_at\":\"");
-    
+    const char *pos_str = strstr(response_buffer, "\"media_position\":");
+    const char *updated_str = strstr(response_buffer, "\"media_position_updated_at\":\"");
+
     if (!pos_str) {
         ESP_LOGW(TAG, "media_position not found in response");
-        free(response_buffer);
         return ESP_FAIL;
     }
-    
+
     // Parse base position
     pos_str += strlen("\"media_position\":");
     float base_position = atof(pos_str);
-    
+    bool playing = strstr(response_buffer, "\"state\":\"playing\"") != NULL;
+    double updated_epoch = 0.0;
+
     // If we have the updated_at timestamp, calculate actual current position
     if (updated_str) {
         updated_str += strlen("\"media_position_updated_at\":\"");
-        
-        // Parse ISO 8601 timestamp: "2026-02-28T15:21:09.014396+00:00"
-        struct tm timeinfo = {0};
-        char timestamp_str[64];
-        sscanf(updated_str, "%63[^\"]", timestamp_str);
-        
-        // Parse the timestamp (ignoring microseconds and timezone for simplicity)
-        if (strptime(timestamp_str, "%Y-%m-%dT%H:%M:%S", &timeinfo) != NULL) {
-            time_t updated_time = mktime(&timeinfo);
-            
-            // Get current time
-            struct timeval now;
-            gettimeofday(&now, NULL);
-            time_t current_time = now.tv_sec;
-            
-            // Calculate elapsed time since the position was updated
-            double elapsed = difftime(current_time, updated_time);
-            
-            // Calculate actual current position
-            *position = base_position + (float)elapsed;
-            
-            ESP_LOGI(TAG, "Base position: %.1fs, elapsed: %.1fs, current position: %.1fs", 
-                     base_position, elapsed, *position);
-        } else {
-            // Fallback to base position if timestamp parsing fails
+
+        if (music_assistant_parse_timestamp(updated_str, &updated_epoch) != ESP_OK) {
+            updated_epoch = 0.0;
             ESP_LOGW(TAG, "Failed to parse timestamp, using base position: %.1fs", base_position);
-            *position = base_position;
         }
     } else {
-        // No timestamp available, use base position
         ESP_LOGI(TAG, "No timestamp found, using base position: %.1fs", base_position);
+    }
+
+    // The playback clock accounts for the time since the update if the wall clock is synced
+    music_assistant_playback_clock_seed(base_position, updated_epoch, playing);
+    if (music_assistant_playback_clock_get_position(position) != ESP_OK) {
         *position = base_position;
     }
-    
-    free(response_buffer);
+    ESP_LOGI(TAG, "Base position: %.1fs, current position: %.1fs", base_position, *position);
     return ESP_OK;
 }
 
-esp_err_t music_assistant_seek_to_position(float position)
+/* Position query from the full state document, for servers without the template API */
+static esp_err_t music_assistant_get_media_position_state(float *position)
 {
-    const char *device_id = CONFIG_DEVICE_ID;
+    char *response_buffer = NULL;
+    esp_err_t err = music_assistant_fetch_state(&response_buffer);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = music_assistant_seed_clock_from_state(response_buffer, position);
+    free(response_buffer);
+    return err;
+}
+
+esp_err_t music_assistant_get_media_position(float *position)
+{
+    if (position == NULL) {
+        ESP_LOGE(TAG, "position pointer is NULL");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t refused_ms = s_template_refused_ms;
+    bool template_refused = refused_ms != 0 &&
+                            (uint32_t)(esp_timer_get_time() / 1000) - refused_ms < TEMPLATE_API_RETRY_MS;
+    if (!s_template_unsupported && !template_refused) {
+        esp_err_t err = music_assistant_get_media_position_template(position);
+        if (err != ESP_ERR_NOT_SUPPORTED) {
+            return err;
+        }
+    }
+    return music_assistant_get_media_position_state(position);
+}
+
+esp_err_t music_assistant_estimate_media_position(float *position)
+{
+    if (position == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (music_assistant_playback_clock_get_position(position) == ESP_OK) {
+        return ESP_OK;
+    }
+    /* Clock not seeded (or stale): one network read seeds it */
+    return music_assistant_get_media_position(position);
+}
 
-    if (device_id == NULL || strlen(device_id) == 0) {
-        ESP_LOGE(TAG, "DEVICE_ID not set");
-        return ESP_ERR_INVALID_STATE;
+void music_assistant_client_get_playback_clock_metrics(music_assistant_playback_clock_metrics_t *metrics)
+{
+    if (metrics != NULL) {
+        music_assistant_playback_clock_get_metrics(metrics);
     }
+}
 
+esp_err_t music_assistant_seek_to_position(float position)
+{
     if (position < 0) {
         position = 0;
     }
 
-    char payload[256];
-    snprintf(payload, sizeof(payload),
-             "{\"device_id\":\"%s\",\"seek_position\":%.1f}",
-             device_id, position);
+    char value[MAX_REQUEST_VALUE_LENGTH];
+    snprintf(value, sizeof(value), "%.1f", position);
+
+    return music_assistant_execute(MA_REQUEST_MEDIA_SEEK, value);
+}
+
+size_t music_assistant_client_get_metrics(music_assistant_endpoint_metrics_t *metrics, size_t max_count)
+{
+    size_t count = 0;
+
+    if (metrics == NULL || !s_initialized) {
+        return 0;
+    }
+
+    for (int i = 0; i < MA_REQUEST_COUNT && count < max_count; i++) {
+        music_assistant_endpoint_get_metrics(&s_requests[i].endpoint, &metrics[count++]);
+    }
+    if (count < max_count) {
+        music_assistant_endpoint_get_metrics(&s_state_endpoint, &metrics[count++]);
+    }
+    if (count < max_count) {
+        music_assistant_endpoint_get_metrics(&s_template_endpoint, &metrics[count++]);
+    }
+    if (count < max_count) {
+        music_assistant_endpoint_get_metrics(&s_picture_endpoint, &metrics[count++]);
+    }
 
-    return music_assistant_post_service("media_player/media_seek", payload);
-}
\ No newline at end of file
+    return count;
+}
+
+/* Read the entity state from a state document and move the playback clock along */
+static esp_err_t music_assistant_parse_player_state(const char *document, music_assistant_player_state_t *state)
+{
+    /* The entity's own "state" key precedes "attributes" in Home Assistant's state document */
+    const char *state_str = strstr(document, "\"state\":\"");
+    if (state_str == NULL) {
+        ESP_LOGW(TAG, "state not found in response");
+        return ESP_FAIL;
+    }
+    state_str += strlen("\"state\":\"");
+
+    if (strncmp(state_str, "playing\"", strlen("playing\"")) == 0) {
+        *state = MUSIC_ASSISTANT_PLAYER_STATE_PLAYING;
+    } else if (strncmp(state_str, "unavailable\"", strlen("unavailable\"")) == 0 ||
+               strncmp(state_str, "unknown\"", strlen("unknown\"")) == 0) {
+        *state = MUSIC_ASSISTANT_PLAYER_STATE_UNKNOWN;
+    } else {
+        /* paused, idle, on, off, buffering: not playing */
+        *state = MUSIC_ASSISTANT_PLAYER_STATE_PAUSED;
+    }
+
+    if (*state != MUSIC_ASSISTANT_PLAYER_STATE_UNKNOWN) {
+        music_assistant_playback_clock_set_playing(*state == MUSIC_ASSISTANT_PLAYER_STATE_PLAYING);
+    }
+
+    ESP_LOGI(TAG, "Player state: %.*s", (int)strcspn(state_str, "\""), state_str);
+    return ESP_OK;
+}
+
+esp_err_t music_assistant_get_player_state(music_assistant_player_state_t *state)
+{
+    if (state == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char *document = NULL;
+    esp_err_t err = music_assistant_fetch_state(&document);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = music_assistant_parse_player_state(document, state);
+    free(document);
+    return err;
+}
+
+/* Append a code point to out as UTF-8; returns false if it does not fit */
+static bool music_assistant_put_utf8(char **out, const char *end, uint32_t codepoint)
+{
+    char bytes[3];
+    int len;
+
+    if (codepoint < 0x80) {
+        bytes[0] = (char)codepoint;
+        len = 1;
+    } else if (codepoint < 0x800) {
+        bytes[0] = (char)(0xC0 | (codepoint >> 6));
+        bytes[1] = (char)(0x80 | (codepoint & 0x3F));
+        len = 2;
+    } else {
+        bytes[0] = (char)(0xE0 | (codepoint >> 12));
+        bytes[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        bytes[2] = (char)(0x80 | (codepoint & 0x3F));
+        len = 3;
+    }
+    if (*out + len >= end) {
+        return false;
+    }
+    memcpy(*out, bytes, len);
+    *out += len;
+    return true;
+}
+
+/*
+ * Copy the JSON string value of "key" into out, resolving escapes (\uXXXX
+ * to UTF-8; surrogate pairs become '?'). A value too long for out is cut.
+ */
+static bool music_assistant_json_string(const char *document, const char *key, char *out, size_t size)
+{
+    char pattern[40];
+    snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+    const char *p = strstr(document, pattern);
+    if (p == NULL || size == 0) {
+        return false;
+    }
+    p += strlen(pattern);
+
+    char *o = out;
+    const char *end = out + size;
+    while (*p != '\0' && *p != '"') {
+        uint32_t codepoint = (uint8_t)*p++;
+        if (codepoint == '\\' && *p != '\0') {
+            char escape = *p++;
+            switch (escape) {
+                case 'n': case 'r': case 't': codepoint = ' '; break;
+                case 'b': case 'f':           codepoint = '?'; break;
+                case 'u': {
+                    char hex[5] = {0};
+                    strncpy(hex, p, 4);
+                    p += strnlen(hex, 4);
+                    codepoint = (uint32_t)strtoul(hex, NULL, 16);
+                    if (codepoint >= 0xD800 && codepoint < 0xE000) {
+                        codepoint = '?';
+                    }
+                    break;
+                }
+                default: codepoint = (uint8_t)escape; break;   /* \" \\ \/ */
+            }
+            if (!music_assistant_put_utf8(&o, end, codepoint)) {
+                break;
+            }
+        } else {
+            /* Raw byte, possibly part of a UTF-8 sequence: copy as is */
+            if (o + 1 >= end) {
+                /* Cut: drop the last character rather than leave half a sequence */
+                while (o > out && ((uint8_t)o[-1] & 0xC0) == 0x80) {
+                    o--;
+                }
+                if (o > out && ((uint8_t)o[-1] & 0xC0) == 0xC0) {
+                    o--;
+                }
+                break;
+            }
+            *o++ = (char)codepoint;
+        }
+    }
+    *o = '\0';
+    return true;
+}
+
+/* Numeric value of "key", or fallback if the key is missing or null */
+static double music_assistant_json_number(const char *document, const char *key, double fallback)
+{
+    char pattern[40];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(document, pattern);
+    if (p == NULL) {
+        return fallback;
+    }
+    p += strlen(pattern);
+
+    char *end = NULL;
+    double value = strtod(p, &end);
+    return end == p ? fallback : value;
+}
+
+esp_err_t music_assistant_get_now_playing(music_assistant_now_playing_t *info)
+{
+    if (info == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char *document = NULL;
+    esp_err_t err = music_assistant_fetch_state(&document);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    memset(info, 0, sizeof(*info));
+    err = music_assistant_parse_player_state(document, &info->state);
+    if (err == ESP_OK) {
+        music_assistant_json_string(document, "media_title", info->title, sizeof(info->title));
+        music_assistant_json_string(document, "media_artist", info->artist, sizeof(info->artist));
+        /* A cut path would fetch the wrong resource: keep it whole or not at all */
+        if (!music_assistant_json_string(document, "entity_picture", info->picture, sizeof(info->picture)) ||
+            strlen(info->picture) == sizeof(info->picture) - 1) {
+            info->picture[0] = '\0';
+        }
+        info->duration = (float)music_assistant_json_number(document, "media_duration", 0.0);
+        double volume = music_assistant_json_number(document, "volume_level", -1.0);
+        info->volume = volume < 0.0 ? -1 : (int)(volume * 100.0 + 0.5);
+
+        /* Same document, so the position costs no extra request */
+        float position;
+        music_assistant_seed_clock_from_state(document, &position);
+    }
+
+    free(document);
+    return err;
+}
+
+struct music_assistant_stream {
+    esp_http_client_handle_t client;
+};
+
+int music_assistant_stream_read(music_assistant_stream_t *stream, void *buffer, size_t len)
+{
+    int data_read = esp_http_client_read(stream->client, buffer, (int)len);
+    return data_read < 0 ? -1 : data_read;
+}
+
+esp_err_t music_assistant_fetch_picture(const char *path, music_assistant_stream_consumer_t consumer, void *ctx)
+{
+    if (path == NULL || path[0] != '/' || consumer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        ESP_LOGW(TAG, "Client not initialized (is MUSIC_ASSISTANT_HOST set in menuconfig?)");
+        return ESP_FAIL;
+    }
+
+    char *url = NULL;
+    if (asprintf(&url, "%s%s", s_base_url, path) < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* Artwork is optional: it follows the host breaker but never trips or probes it */
+    esp_err_t err = music_assistant_endpoint_check_host(&s_picture_endpoint);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "picture query rejected, circuit breaker open");
+        free(url);
+        return err;
+    }
+
+    int timeout_ms = music_assistant_endpoint_timeout_ms(&s_picture_endpoint);
+    music_assistant_connection_t *connection = music_assistant_connection_acquire(url, HTTP_METHOD_GET, timeout_ms);
+    free(url);
+    if (!connection) {
+        ESP_LOGE(TAG, "No HTTP connection available");
+        return ESP_FAIL;
+    }
+    esp_http_client_handle_t client = connection->handle;
+
+    int64_t sent_us = esp_timer_get_time();
+    err = music_assistant_connection_open(connection, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "picture query failed: %s", esp_err_to_name(err));
+        music_assistant_note_failure(&s_picture_endpoint, sent_us, timeout_ms);
+        music_assistant_connection_release(connection, false);
+        return ESP_FAIL;
+    }
+
+    int content_length = esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (content_length < 0 && status <= 0) {
+        music_assistant_note_failure(&s_picture_endpoint, sent_us, timeout_ms);
+    } else {
+        music_assistant_endpoint_on_response(&s_picture_endpoint, esp_timer_get_time() - sent_us);
+    }
+
+    bool reusable;
+    if (status >= 200 && status < 300) {
+        music_assistant_stream_t stream = { .client = client };
+        err = consumer(&stream, esp_http_client_is_chunked_response(client) ? -1 : content_length, ctx);
+        /* A consumer that stopped early (e.g. unsupported format) left the rest unread: close, don't download it */
+        reusable = err == ESP_OK && esp_http_client_is_complete_data_received(client);
+    } else {
+        ESP_LOGE(TAG, "HTTP %d Error in picture query", status);
+        err = ESP_FAIL;
+        /* Error bodies are short: drain them to keep the connection */
+        reusable = status > 0 && esp_http_client_flush_response(client, NULL) == ESP_OK;
+    }
+    music_assistant_connection_release(connection, reusable);
+    return err;
+}
+
+size_t music_assistant_client_get_connection_metrics(music_assistant_connection_metrics_t *metrics, size_t max_count)
+{
+    if (metrics == NULL || !s_initialized) {
+        return 0;
+    }
+    return music_assistant_connection_get_metrics(metrics, max_count);
+}
+
+void music_assistant_client_get_state_metrics(music_assistant_state_metrics_t *metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_state_metrics_lock);
+    *metrics = s_state_metrics;
+    portEXIT_CRITICAL(&s_state_metrics_lock);
+}
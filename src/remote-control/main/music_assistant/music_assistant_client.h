@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 /**
@@ -12,14 +15,130 @@
  * - Authentication header setup
  * - Media playback requests
  * - Error handling and logging
+ * - Adaptive per-endpoint request timeouts derived from measured round-trip times
+ * - Per-endpoint circuit breaker and bounded, jittered retries of idempotent calls
+ * - Kept-alive connections and, for https hosts, TLS session resumption
+ * - gzip-compressed state documents, inflated while they are received
+ * - Streamed downloads of the player's cover picture
  */
 
+/** Base of the error codes returned by this module */
+#define ESP_ERR_MUSIC_ASSISTANT_BASE            0xA000
+/** Request rejected without network access because the endpoint's circuit breaker is open */
+#define ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_OPEN    (ESP_ERR_MUSIC_ASSISTANT_BASE + 1)
+/** Published (never returned) when an open circuit breaker lets a probe request through */
+#define ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_PROBING (ESP_ERR_MUSIC_ASSISTANT_BASE + 2)
+
+/**
+ * @brief Circuit breaker state of an endpoint
+ */
+typedef enum {
+    MUSIC_ASSISTANT_BREAKER_CLOSED = 0,   /* Requests flow normally */
+    MUSIC_ASSISTANT_BREAKER_OPEN,         /* Requests fail immediately */
+    MUSIC_ASSISTANT_BREAKER_HALF_OPEN,    /* A single probe request is in flight */
+} music_assistant_breaker_state_t;
+
+/**
+ * @brief Playback state of the Music Assistant player entity
+ */
+typedef enum {
+    MUSIC_ASSISTANT_PLAYER_STATE_UNKNOWN = 0,
+    MUSIC_ASSISTANT_PLAYER_STATE_PLAYING,
+    MUSIC_ASSISTANT_PLAYER_STATE_PAUSED,     /* paused, idle, on or off */
+} music_assistant_player_state_t;
+
+/** Longest media title kept, in bytes (UTF-8) including the terminating NUL */
+#define MUSIC_ASSISTANT_TITLE_MAX 64
+
+/** Longest entity_picture path kept, in bytes including the terminating NUL */
+#define MUSIC_ASSISTANT_PICTURE_MAX 256
+
+/**
+ * @brief What the player is playing, as reported by Home Assistant
+ */
+typedef struct {
+    music_assistant_player_state_t state;
+    char title[MUSIC_ASSISTANT_TITLE_MAX];  /* media_title, empty if none; cut if longer */
+    char artist[MUSIC_ASSISTANT_TITLE_MAX]; /* media_artist, same rules */
+    char picture[MUSIC_ASSISTANT_PICTURE_MAX];  /* entity_picture path on the host, empty if none or too long */
+    float duration;                         /* media_duration in seconds, 0 if unknown (e.g. radio) */
+    int volume;                             /* volume_level in percent, -1 if unknown */
+} music_assistant_now_playing_t;
+
+/**
+ * @brief Transport metrics of one Music Assistant endpoint (service path)
+ */
+typedef struct {
+    const char *endpoint;   /* Service path, e.g. "media_player/volume_set" */
+    uint32_t srtt_ms;       /* Smoothed round-trip time */
+    uint32_t rttvar_ms;     /* Round-trip time variance */
+    uint32_t timeout_ms;    /* Timeout applied to the next request */
+    uint32_t samples;       /* Number of round-trip samples taken */
+    uint32_t timeouts;      /* Number of requests that ran into their timeout */
+    music_assistant_breaker_state_t breaker_state;  /* Shared by all endpoints of the host */
+    uint32_t rejected;      /* Requests to this endpoint failed fast by the open circuit breaker */
+} music_assistant_endpoint_metrics_t;
+
+/**
+ * @brief Metrics of one pooled HTTP(S) connection
+ *
+ * The first connect of a slot is a full handshake; later reconnects (after
+ * the server closed the kept-alive connection or it went idle) present the
+ * cached TLS session and are resumed if the server accepts it.
+ */
+typedef struct {
+    bool tls;                   /* https host */
+    uint32_t requests;          /* Requests sent over this slot */
+    uint32_t connects;          /* TCP (and TLS) connections established */
+    uint32_t full_connect_ms;   /* Duration of the first connect, incl. full handshake */
+    uint32_t last_connect_ms;   /* Duration of the most recent connect */
+    uint32_t avg_reconnect_ms;  /* Mean duration of the connects after the first */
+} music_assistant_connection_metrics_t;
+
+/**
+ * @brief Transfer counters of one response body encoding
+ */
+typedef struct {
+    uint32_t responses;
+    uint32_t wire_bytes;        /* Body bytes as received from the server */
+    uint32_t document_bytes;    /* Body bytes after decoding */
+    uint64_t body_us;           /* Time spent receiving and decoding bodies */
+} music_assistant_body_metrics_t;
+
+/**
+ * @brief Player state transfers: full state documents split by the encoding
+ *        the server chose, and projected position queries
+ */
+typedef struct {
+    music_assistant_body_metrics_t identity;
+    music_assistant_body_metrics_t gzip;
+    music_assistant_body_metrics_t template_query;  /* Position queries via /api/template */
+} music_assistant_state_metrics_t;
+
+/**
+ * @brief Accuracy of the local playback clock
+ *
+ * Drift is the server-reported position minus the local prediction at the
+ * moment a new report arrives (positive: the player is ahead of the clock).
+ */
+typedef struct {
+    uint32_t seeds;             /* Server reports fed into the clock */
+    uint32_t samples;           /* Reports compared with a running clock */
+    int32_t last_drift_ms;
+    uint32_t max_abs_drift_ms;
+    bool wall_clock_synced;     /* SNTP time was available for the last report */
+} music_assistant_playback_clock_metrics_t;
+
 /**
  * @brief Initialize the Music Assistant client
  * 
- * This function prepares any necessary state for Music Assistant communication.
- * Currently minimal setup is needed, but provided for future enhancements
- * (e.g., connection pooling, retry logic).
+ * Builds a prepared request template for every service call: the full URL,
+ * the Authorization header and the static JSON body around the single variable
+ * field are formatted once here, so each call only writes its variable part.
+ * Must be called before any other function of this module.
+ *
+ * A missing MUSIC_ASSISTANT_HOST is not treated as an error; all calls will
+ * then fail fast with ESP_FAIL.
  * 
  * @return ESP_OK on success, ESP_ERR_* on failure
  */
@@ -32,8 +151,13 @@ esp_err_t music_assistant_client_init(void);
  * the configured Music Assistant host. Uses the device_id and API key from
  * menuconfig for authentication.
  * 
+ * The request is idempotent (enqueue "replace") and retried on transport
+ * errors and 5xx responses. The media ID is JSON-escaped, so IDs read from
+ * cards cannot change the request body.
+ *
  * @param media_id The Music Assistant media ID (e.g., "radiobrowser://radio/...")
  * @return ESP_OK on HTTP 2xx response, ESP_ERR_INVALID_ARG if media_id is NULL,
+ *         ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_OPEN while the endpoint's breaker is open,
  *         ESP_FAIL if HTTP request failed or host/API key not configured
  */
 esp_err_t music_assistant_play_media(const char *media_id);
@@ -41,6 +165,9 @@ esp_err_t music_assistant_play_media(const char *media_id);
 /**
  * @brief Send a previous-track command to Music Assistant
  *
+ * Not idempotent, therefore never retried. Like every call of this module it
+ * returns ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_OPEN while the endpoint's breaker is open.
+ *
  * @return ESP_OK on HTTP 2xx response, ESP_FAIL otherwise
  */
 esp_err_t music_assistant_previous_track(void);
@@ -48,10 +175,31 @@ esp_err_t music_assistant_previous_track(void);
 /**
  * @brief Send a play/pause toggle command to Music Assistant
  *
+ * A toggle is not idempotent: it is never retried and two in-flight toggles
+ * cancel each other out. Prefer music_assistant_play() / music_assistant_pause().
+ *
  * @return ESP_OK on HTTP 2xx response, ESP_FAIL otherwise
  */
 esp_err_t music_assistant_play_pause(void);
 
+/**
+ * @brief Resume playback (media_player/media_play)
+ *
+ * Idempotent, retried on transport errors and 5xx.
+ *
+ * @return ESP_OK on HTTP 2xx response, ESP_FAIL otherwise
+ */
+esp_err_t music_assistant_play(void);
+
+/**
+ * @brief Pause playback (media_player/media_pause)
+ *
+ * Idempotent, retried on transport errors and 5xx.
+ *
+ * @return ESP_OK on HTTP 2xx response, ESP_FAIL otherwise
+ */
+esp_err_t music_assistant_pause(void);
+
 /**
  * @brief Send a next-track command to Music Assistant
  *
@@ -84,6 +232,9 @@ esp_err_t music_assistant_volume_down(void);
 /**
  * @brief Seek forward in current media on Music Assistant
  *
+ * Issued as an absolute media_seek to the locally estimated position plus
+ * seconds (see music_assistant_estimate_media_position()).
+ *
  * @param seconds Number of seconds to seek forward (default: 10)
  * @return ESP_OK on HTTP 2xx response, ESP_FAIL otherwise
  */
@@ -92,6 +243,9 @@ esp_err_t music_assistant_seek_forward(int seconds);
 /**
  * @brief Seek backward in current media on Music Assistant
  *
+ * Issued as an absolute media_seek to the locally estimated position minus
+ * seconds, clamped to 0.
+ *
  * @param seconds Number of seconds to seek backward (default: 10)
  * @return ESP_OK on HTTP 2xx response, ESP_FAIL otherwise
  */
@@ -100,11 +254,87 @@ esp_err_t music_assistant_seek_backward(int seconds);
 /**
  * @brief Get current media position from Music Assistant
  *
+ * Renders a template via POST /api/template so Home Assistant returns only
+ * the position, its update time as an epoch and the player state. If the
+ * server refuses the template API (HTTP 400/401/403/404/405) the client
+ * falls back to the full state document for the rest of the session.
+ *
  * @param position Pointer to store the current position in seconds
  * @return ESP_OK on success, ESP_FAIL otherwise
  */
 esp_err_t music_assistant_get_media_position(float *position);
 
+/**
+ * @brief Estimate the current media position without a network read
+ *
+ * Reads the local playback clock, which is seeded by
+ * music_assistant_get_media_position() and moved along with play, pause,
+ * seek and track changes. Falls back to music_assistant_get_media_position()
+ * if the clock is unseeded or stale.
+ *
+ * @param position Pointer to store the position in seconds
+ * @return ESP_OK on success, ESP_FAIL otherwise
+ */
+esp_err_t music_assistant_estimate_media_position(float *position);
+
+/**
+ * @brief Get the playback state of the player entity from Home Assistant
+ *
+ * @param state Pointer to store the player state
+ * @return ESP_OK on success, ESP_FAIL otherwise
+ */
+esp_err_t music_assistant_get_player_state(music_assistant_player_state_t *state);
+
+/**
+ * @brief Read title, artist, picture, state, duration and volume of the player in one request
+ *
+ * Fetches the state document once; its media_position also seeds the
+ * playback clock, so the position can be animated locally afterwards.
+ *
+ * @param info Filled with the player's now-playing information
+ * @return ESP_OK on success, ESP_FAIL otherwise
+ */
+esp_err_t music_assistant_get_now_playing(music_assistant_now_playing_t *info);
+
+/** A picture download in progress, see music_assistant_fetch_picture() */
+typedef struct music_assistant_stream music_assistant_stream_t;
+
+/**
+ * @brief Consumer of a picture download
+ *
+ * Called once the response headers are in. Pulls the body with
+ * music_assistant_stream_read() at its own pace, so it never has to be held
+ * in memory as a whole.
+ *
+ * @param stream         Body to read from
+ * @param content_length Body size in bytes, or -1 if not announced (chunked)
+ * @param ctx            As passed to music_assistant_fetch_picture()
+ * @return ESP_OK if the picture was used
+ */
+typedef esp_err_t (*music_assistant_stream_consumer_t)(music_assistant_stream_t *stream, int content_length, void *ctx);
+
+/**
+ * @brief Download a picture from the Home Assistant host (e.g. entity_picture)
+ *
+ * Uses a pooled connection with the Authorization header, and the "picture"
+ * endpoint's adaptive timeout and circuit breaker. Not retried.
+ *
+ * @param path     Absolute path on the host, starting with '/'
+ * @param consumer Reads the body; runs in the calling task
+ * @param ctx      Passed to consumer
+ * @return The consumer's result on HTTP 2xx, ESP_ERR_INVALID_ARG for a path
+ *         that is not on the host, ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_OPEN while
+ *         the breaker is open, ESP_FAIL otherwise
+ */
+esp_err_t music_assistant_fetch_picture(const char *path, music_assistant_stream_consumer_t consumer, void *ctx);
+
+/**
+ * @brief Read the next part of a picture body
+ *
+ * @return Bytes read (less than len only at the end of the body), or -1 on error
+ */
+int music_assistant_stream_read(music_assistant_stream_t *stream, void *buffer, size_t len);
+
 /**
  * @brief Seek to absolute position in current media
  *
@@ -112,3 +342,33 @@ esp_err_t music_assistant_get_media_position(float *position);
  * @return ESP_OK on HTTP 2xx response, ESP_FAIL otherwise
  */
 esp_err_t music_assistant_seek_to_position(float position);
+
+/**
+ * @brief Get transport metrics of all endpoints
+ *
+ * @param metrics   Array to fill
+ * @param max_count Capacity of the array
+ * @return Number of entries written
+ */
+size_t music_assistant_client_get_metrics(music_assistant_endpoint_metrics_t *metrics, size_t max_count);
+
+/**
+ * @brief Get metrics of the pooled HTTP(S) connections
+ *
+ * @param metrics   Array to fill
+ * @param max_count Capacity of the array
+ * @return Number of entries written
+ */
+size_t music_assistant_client_get_connection_metrics(music_assistant_connection_metrics_t *metrics, size_t max_count);
+
+/**
+ * @brief Get transfer counters of the player state queries
+ *
+ * @param metrics Filled with the counters for uncompressed and gzip responses
+ */
+void music_assistant_client_get_state_metrics(music_assistant_state_metrics_t *metrics);
+
+/**
+ * @brief Get drift statistics of the local playback clock
+ */
+void music_assistant_client_get_playback_clock_metrics(music_assistant_playback_clock_metrics_t *metrics);
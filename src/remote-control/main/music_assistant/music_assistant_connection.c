@@ -0,0 +1,231 @@
+#include "music_assistant_connection.h"
+
+#include <string.h>
+#include <strings.h>
+
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include "common/config.h"
+#if CONFIG_MUSIC_ASSISTANT_TLS_CERT_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+
+static const char *TAG = "MA_CONNECTION";
+
+#define MAX_HTTP_HEADER_BUFFER 512
+
+#if CONFIG_MUSIC_ASSISTANT_TLS_PINNED_CERT
+/* Embedded by main/CMakeLists.txt from CONFIG_MUSIC_ASSISTANT_TLS_CA_PEM */
+extern const char music_assistant_ca_pem_start[] asm("_binary_music_assistant_ca_pem_start");
+#endif
+
+static music_assistant_connection_t s_connections[HTTP_CONNECTION_POOL_SIZE];
+static SemaphoreHandle_t s_available = NULL;
+static portMUX_TYPE s_pool_lock = portMUX_INITIALIZER_UNLOCKED;
+#if CONFIG_PM_ENABLE
+/* Counted: held once per connection in use, full CPU speed and no light sleep meanwhile */
+static esp_pm_lock_handle_t s_pm_lock = NULL;
+#endif
+
+static esp_err_t music_assistant_connection_event_handler(esp_http_client_event_t *evt)
+{
+    music_assistant_connection_t *connection = (music_assistant_connection_t *)evt->user_data;
+
+    switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            connection->connected = true;
+            break;
+        case HTTP_EVENT_DISCONNECTED:
+            connection->connected = false;
+            break;
+        case HTTP_EVENT_ON_HEADER:
+            if (strcasecmp(evt->header_key, "Content-Encoding") == 0) {
+                connection->gzip_response = strcasecmp(evt->header_value, "gzip") == 0;
+            }
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+esp_err_t music_assistant_connection_pool_init(const char *url, const char *auth_header)
+{
+    bool tls = strncmp(url, "https://", 8) == 0;
+
+    s_available = xSemaphoreCreateCounting(HTTP_CONNECTION_POOL_SIZE, HTTP_CONNECTION_POOL_SIZE);
+    if (s_available == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+#if CONFIG_PM_ENABLE
+    esp_err_t err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "ma_http", &s_pm_lock);
+    if (err != ESP_OK) {
+        music_assistant_connection_pool_deinit();
+        return err;
+    }
+#endif
+
+    for (int i = 0; i < HTTP_CONNECTION_POOL_SIZE; i++) {
+        music_assistant_connection_t *connection = &s_connections[i];
+        memset(connection, 0, sizeof(*connection));
+        connection->metrics.tls = tls;
+
+        esp_http_client_config_t config = {
+            .url = url,
+            .timeout_ms = HTTP_REQUEST_TIMEOUT_MS,
+            .buffer_size = MAX_HTTP_HEADER_BUFFER,
+            .keep_alive_enable = true,
+            .event_handler = music_assistant_connection_event_handler,
+            .user_data = connection,
+        };
+
+        if (tls) {
+#if CONFIG_MUSIC_ASSISTANT_TLS_CERT_BUNDLE
+            config.crt_bundle_attach = esp_crt_bundle_attach;
+#elif CONFIG_MUSIC_ASSISTANT_TLS_PINNED_CERT
+            config.cert_pem = music_assistant_ca_pem_start;
+#endif
+#if CONFIG_MUSIC_ASSISTANT_TLS_SESSION_RESUMPTION
+            /* Keep the session ticket across reconnects of this handle */
+            config.save_client_session = true;
+#endif
+        }
+
+        connection->handle = esp_http_client_init(&config);
+        if (connection->handle == NULL) {
+            ESP_LOGE(TAG, "Failed to init HTTP client %d", i);
+            music_assistant_connection_pool_deinit();
+            return ESP_ERR_NO_MEM;
+        }
+
+        if (auth_header) {
+            esp_http_client_set_header(connection->handle, "Authorization", auth_header);
+        }
+        esp_http_client_set_header(connection->handle, "Content-Type", "application/json");
+    }
+
+    ESP_LOGI(TAG, "%d %s connection(s) prepared", HTTP_CONNECTION_POOL_SIZE, tls ? "https" : "http");
+    return ESP_OK;
+}
+
+void music_assistant_connection_pool_deinit(void)
+{
+    for (int i = 0; i < HTTP_CONNECTION_POOL_SIZE; i++) {
+        if (s_connections[i].handle) {
+            esp_http_client_cleanup(s_connections[i].handle);
+        }
+        memset(&s_connections[i], 0, sizeof(s_connections[i]));
+    }
+    if (s_available) {
+        vSemaphoreDelete(s_available);
+        s_available = NULL;
+    }
+#if CONFIG_PM_ENABLE
+    if (s_pm_lock) {
+        esp_pm_lock_delete(s_pm_lock);
+        s_pm_lock = NULL;
+    }
+#endif
+}
+
+music_assistant_connection_t *music_assistant_connection_acquire(const char *url,
+                                                                 esp_http_client_method_t method,
+                                                                 int timeout_ms)
+{
+    if (s_available == NULL || xSemaphoreTake(s_available, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return NULL;
+    }
+
+    music_assistant_connection_t *connection = NULL;
+    portENTER_CRITICAL(&s_pool_lock);
+    for (int i = 0; i < HTTP_CONNECTION_POOL_SIZE; i++) {
+        if (!s_connections[i].in_use) {
+            connection = &s_connections[i];
+            connection->in_use = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_pool_lock);
+
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_acquire(s_pm_lock);
+#endif
+
+    if (connection->connected &&
+        esp_timer_get_time() - connection->last_used_us > (int64_t)HTTP_KEEP_ALIVE_IDLE_MS * 1000) {
+        /* The server has most likely dropped it already; do not find out mid-request */
+        esp_http_client_close(connection->handle);
+        connection->connected = false;
+    }
+
+    connection->gzip_response = false;
+    esp_http_client_set_url(connection->handle, url);
+    esp_http_client_set_method(connection->handle, method);
+    esp_http_client_set_timeout_ms(connection->handle, timeout_ms);
+    return connection;
+}
+
+esp_err_t music_assistant_connection_open(music_assistant_connection_t *connection, int write_len)
+{
+    bool reused = connection->connected;
+    int64_t start_us = esp_timer_get_time();
+
+    esp_err_t err = esp_http_client_open(connection->handle, write_len);
+    if (err != ESP_OK || reused) {
+        return err;
+    }
+
+    uint32_t connect_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+
+    portENTER_CRITICAL(&s_pool_lock);
+    music_assistant_connection_metrics_t *metrics = &connection->metrics;
+    if (metrics->connects == 0) {
+        metrics->full_connect_ms = connect_ms;
+    } else {
+        connection->reconnect_ms_total += connect_ms;
+        metrics->avg_reconnect_ms = (uint32_t)(connection->reconnect_ms_total / metrics->connects);
+    }
+    metrics->connects++;
+    metrics->last_connect_ms = connect_ms;
+    portEXIT_CRITICAL(&s_pool_lock);
+
+    ESP_LOGI(TAG, "Connected in %lu ms (%s)", (unsigned long)connect_ms,
+             connection->metrics.tls ? (connection->metrics.connects == 1 ? "full TLS handshake" : "TLS resumption offered")
+                                     : "plain TCP");
+    return ESP_OK;
+}
+
+void music_assistant_connection_release(music_assistant_connection_t *connection, bool keep_alive)
+{
+    if (!keep_alive) {
+        esp_http_client_close(connection->handle);
+        connection->connected = false;
+    }
+
+    portENTER_CRITICAL(&s_pool_lock);
+    connection->last_used_us = esp_timer_get_time();
+    connection->metrics.requests++;
+    connection->in_use = false;
+    portEXIT_CRITICAL(&s_pool_lock);
+
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_release(s_pm_lock);
+#endif
+    xSemaphoreGive(s_available);
+}
+
+size_t music_assistant_connection_get_metrics(music_assistant_connection_metrics_t *metrics, size_t max_count)
+{
+    size_t count = HTTP_CONNECTION_POOL_SIZE < max_count ? HTTP_CONNECTION_POOL_SIZE : max_count;
+
+    portENTER_CRITICAL(&s_pool_lock);
+    for (size_t i = 0; i < count; i++) {
+        metrics[i] = s_connections[i].metrics;
+    }
+    portEXIT_CRITICAL(&s_pool_lock);
+    return count;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+#include "freertos/FreeRTOS.h"
+#include "music_assistant_client.h"
+
+/**
+ * @file music_assistant_connection.h
+ * @brief Pool of kept-alive HTTP(S) connections to the Music Assistant host
+ *
+ * Requests borrow a connection from a fixed pool of HTTP_CONNECTION_POOL_SIZE
+ * esp_http_client handles instead of creating one per call, so consecutive
+ * requests reuse the open socket. For https hosts each handle keeps the TLS
+ * session ticket of its last connection; when the socket has to be re-opened
+ * the ticket is presented and the server can resume the session instead of
+ * running a full handshake.
+ *
+ * The server certificate is verified against the ESP-IDF certificate bundle
+ * or a pinned certificate, selected in menuconfig.
+ */
+
+typedef struct {
+    esp_http_client_handle_t handle;
+    bool in_use;
+    bool connected;         /* Set by the HTTP_EVENT_ON_CONNECTED handler */
+    bool gzip_response;     /* Current response has Content-Encoding: gzip */
+    int64_t last_used_us;
+    music_assistant_connection_metrics_t metrics;
+    uint64_t reconnect_ms_total;
+} music_assistant_connection_t;
+
+/**
+ * @brief Create the pooled client handles
+ *
+ * @param url         Any URL on the Music Assistant host (decides http/https)
+ * @param auth_header Value of the Authorization header, or NULL
+ * @return ESP_OK, or ESP_ERR_NO_MEM
+ */
+esp_err_t music_assistant_connection_pool_init(const char *url, const char *auth_header);
+
+/**
+ * @brief Destroy the pooled client handles and their connections
+ */
+void music_assistant_connection_pool_deinit(void);
+
+/**
+ * @brief Borrow a connection and point it at a request
+ *
+ * Blocks up to timeout_ms if all connections are in use.
+ *
+ * @return Connection, or NULL if none became free in time
+ */
+music_assistant_connection_t *music_assistant_connection_acquire(const char *url,
+                                                                 esp_http_client_method_t method,
+                                                                 int timeout_ms);
+
+/**
+ * @brief Send the request line and headers (esp_http_client_open)
+ *
+ * Reuses the open socket if there is one; otherwise connects and records
+ * the connect/handshake duration in the connection metrics.
+ */
+esp_err_t music_assistant_connection_open(music_assistant_connection_t *connection, int write_len);
+
+/**
+ * @brief Return a borrowed connection to the pool
+ *
+ * @param keep_alive true if the response was consumed completely and the
+ *                   socket can carry the next request; false closes it
+ *                   (the TLS session ticket is kept for resumption)
+ */
+void music_assistant_connection_release(music_assistant_connection_t *connection, bool keep_alive);
+
+/**
+ * @brief Copy the metrics of all pooled connections
+ */
+size_t music_assistant_connection_get_metrics(music_assistant_connection_metrics_t *metrics, size_t max_count);
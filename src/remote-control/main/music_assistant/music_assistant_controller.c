@@ -1,75 +1,567 @@
 #include "music_assistant_controller.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
+#include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/timers.h"
+#include "common/app_events.h"
 #include "input/buttons.h"
 #include "music_assistant/music_assistant_client.h"
+#include "music_assistant/music_assistant_playback_clock.h"
+#include "common/config.h"
+#include "cover/cover_art.h"
+#include "storage/media_metadata.h"
+#include "parental/parental_control.h"
+#include "soft_power/standby.h"
+#include "wifi/wifi_power_save.h"
 
 static const char *TAG = "MUSIC_ASSISTANT_CTRL";
 
 #define COMMAND_QUEUE_SIZE 10
 #define WORKER_TASK_STACK_SIZE 8192
 #define WORKER_TASK_PRIORITY 5
+#define SUBMIT_TIMEOUT_MS 100        // Longest wait for room in a full transport queue
 
 typedef enum {
     MA_CMD_PREVIOUS_TRACK,
-    MA_CMD_PLAY_PAUSE,
+    MA_CMD_PLAY_PAUSE,      // unresolved toggle, only queued while the player state is unknown
+    MA_CMD_PLAY,
+    MA_CMD_PAUSE,
     MA_CMD_NEXT_TRACK,
     MA_CMD_PLAY_MEDIA,
+    MA_CMD_SET_VOLUME,
+    MA_CMD_RESUME,          // seek, then play
+    MA_CMD_PAUSE_SNAPSHOT,  // pause, then report the position
+    MA_CMD_SYNC_STATE,      // read the player state from Home Assistant
 } ma_command_type_t;
 
 typedef struct {
     ma_command_type_t type;
+    uint32_t seq;            // monotonically increasing per enqueued command
+    int64_t enqueued_us;     // esp_timer time of enqueue, for queue wait metrics
     union {
-        char media_id[128];  // for MA_CMD_PLAY_MEDIA
+        struct {
+            char id[128];
+            float start_position;   // seek here after loading, if > 0
+        } media;                    // for MA_CMD_PLAY_MEDIA
+        int volume_level;           // for MA_CMD_SET_VOLUME
+        float position;             // for MA_CMD_RESUME
+        struct {
+            music_assistant_snapshot_cb_t callback;
+            uint8_t context[MUSIC_ASSISTANT_SNAPSHOT_CONTEXT_MAX];
+        } snapshot;                 // for MA_CMD_PAUSE_SNAPSHOT
     };
 } ma_command_t;
 
+/*
+ * Commands are executed on independent lanes, each with its own worker task,
+ * so a slow request on one lane never delays another. Within the transport
+ * lane commands stay strictly ordered; the volume lane is a one-slot mailbox
+ * where a newer level replaces one that has not been sent yet.
+ */
+typedef struct {
+    const char *name;
+    QueueHandle_t queue;
+    TaskHandle_t task;
+    bool latest_wins;
+    music_assistant_lane_metrics_t metrics;
+    portMUX_TYPE lock;
+} ma_lane_t;
+
+static ma_lane_t s_transport_lane = {
+    .name = "transport",
+    .latest_wins = false,
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static ma_lane_t s_volume_lane = {
+    .name = "volume",
+    .latest_wins = true,
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
 static bool s_handlers_registered = false;
-static QueueHandle_t s_command_queue = NULL;
-static TaskHandle_t s_worker_task_handle = NULL;
+
+/*
+ * Player state as intended by the commands queued so far. Play/pause presses
+ * are resolved against it at enqueue time, so every queued transport command
+ * is an explicit, idempotent media_play or media_pause.
+ *
+ * This, the now-playing cache and the loaded media ID live in RTC memory, so
+ * after a wake from standby the panel knows what it was playing without
+ * asking the server.
+ */
+static RTC_DATA_ATTR music_assistant_player_state_t s_player_state = MUSIC_ASSISTANT_PLAYER_STATE_UNKNOWN;
+static uint32_t s_next_seq = 0;
+static portMUX_TYPE s_state_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ * Last title, duration and volume read from the server (volume also follows
+ * our own volume commands). Together with the playback clock this is all the
+ * now-playing screen needs, so play/pause/volume updates cost no request.
+ */
+static RTC_DATA_ATTR char s_title[APP_NOW_PLAYING_TITLE_MAX] = "";
+static RTC_DATA_ATTR float s_duration = 0.0f;
+static RTC_DATA_ATTR int s_volume = -1;
+
+/* Re-read title/duration once the player has loaded a new item, and now and then while playing */
+static esp_timer_handle_t s_settle_timer = NULL;
+static esp_timer_handle_t s_resync_timer = NULL;
+
+/* Media ID of the last loaded card, the key of its cover and metadata; only used on the transport lane */
+static RTC_DATA_ATTR char s_media_id[sizeof(((ma_command_t *)0)->media.id)] = "";
+static RTC_DATA_ATTR bool s_media_unlearnt = false;    /* No title reported for s_media_id since it was loaded */
+
+/*
+ * Daily playtime used up: the pause is re-sent until a state sync reads the
+ * player as paused, so a failed or dropped pause cannot leave music playing
+ */
+static esp_timer_handle_t s_limit_pause_timer = NULL;
+static bool s_limit_pause_pending = false;      /* Guarded by s_state_lock */
+
+/* Woken by play/pause: sent as media_play as soon as the network is up */
+static bool s_wake_play_pending = false;
+
+static const char *command_name(ma_command_type_t type)
+{
+    switch (type) {
+        case MA_CMD_PREVIOUS_TRACK: return "previous_track";
+        case MA_CMD_PLAY_PAUSE:     return "play_pause";
+        case MA_CMD_PLAY:           return "play";
+        case MA_CMD_PAUSE:          return "pause";
+        case MA_CMD_NEXT_TRACK:     return "next_track";
+        case MA_CMD_PLAY_MEDIA:     return "play_media";
+        case MA_CMD_SET_VOLUME:     return "set_volume";
+        case MA_CMD_RESUME:         return "resume";
+        case MA_CMD_PAUSE_SNAPSHOT: return "pause_snapshot";
+        case MA_CMD_SYNC_STATE:     return "sync_state";
+        default:                    return "unknown";
+    }
+}
+
+static bool starts_playback(ma_command_type_t type)
+{
+    return type == MA_CMD_PLAY || type == MA_CMD_PLAY_MEDIA || type == MA_CMD_RESUME;
+}
+
+static bool stops_playback(ma_command_type_t type)
+{
+    return type == MA_CMD_PAUSE || type == MA_CMD_PAUSE_SNAPSHOT;
+}
+
+static void set_player_state(music_assistant_player_state_t state)
+{
+    portENTER_CRITICAL(&s_state_lock);
+    s_player_state = state;
+    portEXIT_CRITICAL(&s_state_lock);
+}
+
+/*
+ * Turn a toggle press into an explicit command, apply its intended state and
+ * assign its sequence number. Returns the state before, for
+ * unresolve_command() should the command not get queued.
+ */
+static music_assistant_player_state_t resolve_command(ma_command_t *cmd)
+{
+    portENTER_CRITICAL(&s_state_lock);
+    music_assistant_player_state_t previous = s_player_state;
+    if (cmd->type == MA_CMD_PLAY_PAUSE) {
+        if (s_player_state == MUSIC_ASSISTANT_PLAYER_STATE_PLAYING) {
+            cmd->type = MA_CMD_PAUSE;
+            s_player_state = MUSIC_ASSISTANT_PLAYER_STATE_PAUSED;
+        } else if (s_player_state == MUSIC_ASSISTANT_PLAYER_STATE_PAUSED) {
+            cmd->type = MA_CMD_PLAY;
+            s_player_state = MUSIC_ASSISTANT_PLAYER_STATE_PLAYING;
+        }
+        /* Unknown: the worker queries Home Assistant before deciding */
+    } else if (cmd->type == MA_CMD_PLAY || cmd->type == MA_CMD_PLAY_MEDIA || cmd->type == MA_CMD_RESUME) {
+        s_player_state = MUSIC_ASSISTANT_PLAYER_STATE_PLAYING;
+    } else if (cmd->type == MA_CMD_PAUSE || cmd->type == MA_CMD_PAUSE_SNAPSHOT) {
+        s_player_state = MUSIC_ASSISTANT_PLAYER_STATE_PAUSED;
+    }
+    cmd->seq = ++s_next_seq;
+    portEXIT_CRITICAL(&s_state_lock);
+    return previous;
+}
+
+/* Undo the intended state of a command that was never queued, unless something changed it since */
+static void unresolve_command(const ma_command_t *cmd, music_assistant_player_state_t previous)
+{
+    music_assistant_player_state_t applied;
+    if (starts_playback(cmd->type)) {
+        applied = MUSIC_ASSISTANT_PLAYER_STATE_PLAYING;
+    } else if (stops_playback(cmd->type)) {
+        applied = MUSIC_ASSISTANT_PLAYER_STATE_PAUSED;
+    } else {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_state_lock);
+    if (s_player_state == applied) {
+        s_player_state = previous;
+    }
+    portEXIT_CRITICAL(&s_state_lock);
+}
+
+/* Resolve a toggle queued while the state was unknown; runs in the worker */
+static ma_command_type_t resolve_unknown_toggle(void)
+{
+    music_assistant_player_state_t state = MUSIC_ASSISTANT_PLAYER_STATE_UNKNOWN;
+    if (music_assistant_get_player_state(&state) != ESP_OK) {
+        /* Cannot tell: starting playback is the safe, idempotent choice */
+        state = MUSIC_ASSISTANT_PLAYER_STATE_PAUSED;
+    }
+
+    ma_command_type_t type = (state == MUSIC_ASSISTANT_PLAYER_STATE_PLAYING) ? MA_CMD_PAUSE : MA_CMD_PLAY;
+    set_player_state(type == MA_CMD_PAUSE ? MUSIC_ASSISTANT_PLAYER_STATE_PAUSED
+                                          : MUSIC_ASSISTANT_PLAYER_STATE_PLAYING);
+    return type;
+}
+
+static bool changes_item(ma_command_type_t type)
+{
+    return type == MA_CMD_PLAY_MEDIA || type == MA_CMD_NEXT_TRACK || type == MA_CMD_PREVIOUS_TRACK;
+}
+
+/* Post the cached now-playing information with the given position (< 0: unknown) */
+static void post_now_playing(float position)
+{
+    app_now_playing_event_t event = { .position = position };
+
+    portENTER_CRITICAL(&s_state_lock);
+    memcpy(event.title, s_title, sizeof(event.title));
+    event.duration = s_duration;
+    event.volume = s_volume;
+    event.playing = s_player_state == MUSIC_ASSISTANT_PLAYER_STATE_PLAYING;
+    portEXIT_CRITICAL(&s_state_lock);
+
+    event.anchor_us = esp_timer_get_time();
+
+    esp_err_t err = esp_event_post(APP_EVENTS, APP_EVENT_NOW_PLAYING, &event, sizeof(event), 0);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to post now-playing event: %s", esp_err_to_name(err));
+    }
+}
+
+/* Post the cached now-playing information with the playback clock's current position */
+static void publish_now_playing(void)
+{
+    float position;
+    if (music_assistant_playback_clock_get_position(&position) != ESP_OK) {
+        position = -1.0f;
+    }
+    post_now_playing(position);
+}
+
+/* Take title and duration from the metadata cache, or clear them if the item is unknown */
+static bool set_now_playing_from_metadata(const char *media_id)
+{
+    media_metadata_t metadata;
+    bool known = media_id != NULL && media_metadata_get(media_id, &metadata);
+
+    portENTER_CRITICAL(&s_state_lock);
+    if (known) {
+        memcpy(s_title, metadata.title, sizeof(s_title));
+        s_duration = metadata.duration;
+    } else {
+        s_title[0] = '\0';
+        s_duration = 0.0f;
+    }
+    portEXIT_CRITICAL(&s_state_lock);
+    return known;
+}
+
+/*
+ * Correct the intended state (and playtime accounting) from what the player
+ * reports, and refresh the now-playing information from the same document
+ */
+static esp_err_t sync_player_state(void)
+{
+    music_assistant_now_playing_t info;
+    esp_err_t err = music_assistant_get_now_playing(&info);
+    if (err != ESP_OK) {
+        return err;
+    }
+    set_player_state(info.state);
+    if (info.state != MUSIC_ASSISTANT_PLAYER_STATE_UNKNOWN) {
+        parental_control_on_playback(info.state == MUSIC_ASSISTANT_PLAYER_STATE_PLAYING);
+    }
+    if (info.state == MUSIC_ASSISTANT_PLAYER_STATE_PAUSED) {
+        portENTER_CRITICAL(&s_state_lock);
+        bool confirmed = s_limit_pause_pending;
+        s_limit_pause_pending = false;
+        portEXIT_CRITICAL(&s_state_lock);
+        if (confirmed) {
+            esp_timer_stop(s_limit_pause_timer);
+            ESP_LOGI(TAG, "Player paused for the daily limit");
+        }
+    }
+
+    portENTER_CRITICAL(&s_state_lock);
+    memcpy(s_title, info.title, sizeof(s_title));
+    s_duration = info.duration;
+    if (info.volume >= 0) {
+        s_volume = info.volume;
+    }
+    portEXIT_CRITICAL(&s_state_lock);
+
+    publish_now_playing();
+    if (s_media_unlearnt && info.title[0] != '\0') {
+        /* First report after loading: what the card plays, for the next tap */
+        media_metadata_t metadata = { .duration = info.duration };
+        memcpy(metadata.title, info.title, sizeof(metadata.title));
+        memcpy(metadata.artist, info.artist, sizeof(metadata.artist));
+        media_metadata_put(s_media_id, &metadata);
+        s_media_unlearnt = false;
+    }
+    if (s_media_id[0] != '\0') {
+        /* Free if the cover is already up; fetches it once the server names a picture */
+        cover_art_show(s_media_id, info.picture);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t execute_command(ma_command_t *cmd)
+{
+    if (cmd->type == MA_CMD_PLAY_PAUSE) {
+        cmd->type = resolve_unknown_toggle();
+    }
+    if (starts_playback(cmd->type) && parental_control_check_play() != ESP_OK) {
+        ESP_LOGW(TAG, "Refusing #%lu %s: daily playtime used up", (unsigned long)cmd->seq, command_name(cmd->type));
+        return ESP_ERR_PARENTAL_LIMIT_REACHED;
+    }
+    ESP_LOGI(TAG, "Executing #%lu %s", (unsigned long)cmd->seq, command_name(cmd->type));
+
+    switch (cmd->type) {
+        case MA_CMD_PREVIOUS_TRACK:
+            return music_assistant_previous_track();
+        case MA_CMD_PLAY:
+            return music_assistant_play();
+        case MA_CMD_PAUSE:
+            return music_assistant_pause();
+        case MA_CMD_NEXT_TRACK:
+            return music_assistant_next_track();
+        case MA_CMD_PLAY_MEDIA: {
+            esp_err_t err = music_assistant_play_media(cmd->media.id);
+            if (err == ESP_OK) {
+                /* A cover on flash shows up right away, before the server reports anything */
+                memcpy(s_media_id, cmd->media.id, sizeof(s_media_id));
+                s_media_unlearnt = true;
+                cover_art_show(s_media_id, NULL);
+            }
+            if (err == ESP_OK && cmd->media.start_position > 0.0f) {
+                err = music_assistant_seek_to_position(cmd->media.start_position);
+            }
+            return err;
+        }
+        case MA_CMD_SET_VOLUME:
+            return music_assistant_set_volume(cmd->volume_level);
+        case MA_CMD_RESUME: {
+            /* A failed seek (e.g. a live stream) must not keep playback paused */
+            esp_err_t seek_err = music_assistant_seek_to_position(cmd->position);
+            esp_err_t err = music_assistant_play();
+            return err != ESP_OK ? err : seek_err;
+        }
+        case MA_CMD_PAUSE_SNAPSHOT: {
+            esp_err_t err = music_assistant_pause();
+            if (err != ESP_OK) {
+                /* Still playing: a position read now would be stale by the time it is used */
+                return err;
+            }
+            /* Once paused the playback clock stands still, so this is a local read */
+            float position = 0.0f;
+            if (music_assistant_estimate_media_position(&position) == ESP_OK) {
+                cmd->snapshot.callback(position, cmd->snapshot.context);
+            }
+            return err;
+        }
+        case MA_CMD_SYNC_STATE:
+            return sync_player_state();
+        default:
+            ESP_LOGW(TAG, "Unknown command type: %d", cmd->type);
+            return ESP_ERR_INVALID_ARG;
+    }
+}
 
 static void music_assistant_worker_task(void *arg)
 {
-    (void)arg;
+    ma_lane_t *lane = (ma_lane_t *)arg;
     ma_command_t cmd;
 
-    ESP_LOGI(TAG, "Worker task started");
+    ESP_LOGI(TAG, "Worker task started (%s lane)", lane->name);
 
     while (1) {
-        if (xQueueReceive(s_command_queue, &cmd, portMAX_DELAY) == pdTRUE) {
-            esp_err_t err = ESP_OK;
-
-            switch (cmd.type) {
-                case MA_CMD_PREVIOUS_TRACK:
-                    err = music_assistant_previous_track();
-                    break;
-                case MA_CMD_PLAY_PAUSE:
-                    err = music_assistant_play_pause();
-                    break;
-                case MA_CMD_NEXT_TRACK:
-                    err = music_assistant_next_track();
-                    break;
-                case MA_CMD_PLAY_MEDIA:
-                    err = music_assistant_play_media(cmd.media_id);
-                    break;
-                default:
-                    ESP_LOGW(TAG, "Unknown command type: %d", cmd.type);
-                    continue;
+        if (xQueueReceive(lane->queue, &cmd, portMAX_DELAY) == pdTRUE) {
+            wifi_power_save_mode_t ps_mode = wifi_power_save_get_mode();
+            int64_t started_us = esp_timer_get_time();
+            esp_err_t err = execute_command(&cmd);
+            int64_t finished_us = esp_timer_get_time();
+
+            uint32_t wait_ms = (uint32_t)((started_us - cmd.enqueued_us) / 1000);
+            uint32_t busy_ms = (uint32_t)((finished_us - started_us) / 1000);
+
+            portENTER_CRITICAL(&lane->lock);
+            lane->metrics.executed++;
+            if (err != ESP_OK) {
+                lane->metrics.failed++;
+            }
+            lane->metrics.busy_ms += busy_ms;
+            if (wait_ms > lane->metrics.max_wait_ms) {
+                lane->metrics.max_wait_ms = wait_ms;
             }
+            portEXIT_CRITICAL(&lane->lock);
 
             if (err != ESP_OK) {
-                ESP_LOGW(TAG, "Failed to execute command type=%d: %s", cmd.type, esp_err_to_name(err));
+                ESP_LOGW(TAG, "Failed to execute #%lu %s: %s",
+                         (unsigned long)cmd.seq, command_name(cmd.type), esp_err_to_name(err));
+                if (starts_playback(cmd.type) || stops_playback(cmd.type)) {
+                    /* The intended state never reached the player; re-query on the next toggle */
+                    set_player_state(MUSIC_ASSISTANT_PLAYER_STATE_UNKNOWN);
+                }
+            } else {
+                wifi_power_save_record_command(ps_mode, busy_ms);
+                if (starts_playback(cmd.type) || stops_playback(cmd.type)) {
+                    parental_control_on_playback(starts_playback(cmd.type));
+                }
+                if (cmd.type == MA_CMD_SET_VOLUME) {
+                    portENTER_CRITICAL(&s_state_lock);
+                    s_volume = cmd.volume_level;
+                    portEXIT_CRITICAL(&s_state_lock);
+                }
+                if (changes_item(cmd.type)) {
+                    /* The server needs a moment before it reports the new title; a known card's is kept */
+                    set_now_playing_from_metadata(cmd.type == MA_CMD_PLAY_MEDIA ? cmd.media.id : NULL);
+                    esp_timer_stop(s_settle_timer);
+                    esp_timer_start_once(s_settle_timer, (uint64_t)NOW_PLAYING_SETTLE_MS * 1000);
+                }
+                if (cmd.type != MA_CMD_SYNC_STATE) {
+                    /* Local update from the playback clock, no request */
+                    publish_now_playing();
+                    standby_note_command_sent();
+                }
             }
         }
     }
 }
 
+/*
+ * Over the daily limit nothing may start playback: explicit starts are
+ * refused, and a toggle can only pause. Returns true if cmd is refused.
+ */
+static bool refuse_over_limit(ma_command_t *cmd)
+{
+    if (!starts_playback(cmd->type) && cmd->type != MA_CMD_PLAY_PAUSE) {
+        return false;
+    }
+    if (cmd->type == MA_CMD_PLAY_PAUSE) {
+        music_assistant_player_state_t state = music_assistant_controller_get_player_state();
+        if (state == MUSIC_ASSISTANT_PLAYER_STATE_PLAYING) {
+            return false;
+        }
+        if (state == MUSIC_ASSISTANT_PLAYER_STATE_UNKNOWN && parental_control_check_play() != ESP_OK) {
+            /* Pausing is always allowed */
+            cmd->type = MA_CMD_PAUSE;
+            return false;
+        }
+    }
+    if (parental_control_check_play() != ESP_OK) {
+        ESP_LOGW(TAG, "Refusing %s: daily playtime used up", command_name(cmd->type));
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Queue a command on a lane. A full queue is waited on for up to wait ticks;
+ * callers on the esp_timer task pass 0, since blocking there would stall
+ * every other timer.
+ */
+static esp_err_t enqueue_command(ma_lane_t *lane, ma_command_t *cmd, TickType_t wait)
+{
+    if (lane->queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (refuse_over_limit(cmd)) {
+        return ESP_ERR_PARENTAL_LIMIT_REACHED;
+    }
+
+    music_assistant_player_state_t previous = resolve_command(cmd);
+    cmd->enqueued_us = esp_timer_get_time();
+    if (wait > 0 && cmd->type != MA_CMD_SYNC_STATE) {
+        /* Someone is using the panel (state reads and timer-driven retries are not; the power-save switch may block) */
+        standby_note_activity();
+        wifi_power_save_note_activity();
+    }
+
+    if (lane->latest_wins) {
+        /* Not atomic with the overwrite; only used for the superseded counter */
+        bool pending = uxQueueMessagesWaiting(lane->queue) > 0;
+        xQueueOverwrite(lane->queue, cmd);
+        portENTER_CRITICAL(&lane->lock);
+        lane->metrics.submitted++;
+        if (pending) {
+            lane->metrics.superseded++;
+        }
+        portEXIT_CRITICAL(&lane->lock);
+        return ESP_OK;
+    }
+
+    if (xQueueSend(lane->queue, cmd, wait) != pdTRUE) {
+        /* The player never gets this command: the next toggle must not assume it did */
+        unresolve_command(cmd, previous);
+        ESP_LOGW(TAG, "Failed to queue #%lu %s (queue full)", (unsigned long)cmd->seq, command_name(cmd->type));
+        portENTER_CRITICAL(&lane->lock);
+        lane->metrics.dropped++;
+        portEXIT_CRITICAL(&lane->lock);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    portENTER_CRITICAL(&lane->lock);
+    lane->metrics.submitted++;
+    portEXIT_CRITICAL(&lane->lock);
+    return ESP_OK;
+}
+
+/* From tasks: a full queue is waited on briefly */
+static esp_err_t submit_command(ma_lane_t *lane, ma_command_t *cmd)
+{
+    return enqueue_command(lane, cmd, pdMS_TO_TICKS(SUBMIT_TIMEOUT_MS));
+}
+
+static esp_err_t start_lane(ma_lane_t *lane, const char *task_name, UBaseType_t queue_length)
+{
+    lane->queue = xQueueCreate(queue_length, sizeof(ma_command_t));
+    if (lane->queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create %s queue", lane->name);
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t ret = xTaskCreate(
+        music_assistant_worker_task,
+        task_name,
+        WORKER_TASK_STACK_SIZE,
+        lane,
+        WORKER_TASK_PRIORITY,
+        &lane->task
+    );
+
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create %s worker task", lane->name);
+        vQueueDelete(lane->queue);
+        lane->queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
 static void music_assistant_button_event_handler(void *arg,
                                                  esp_event_base_t event_base,
                                                  int32_t event_id,
@@ -99,10 +591,76 @@ static void music_assistant_button_event_handler(void *arg,
             return;
     }
 
-    // Post command to queue (non-blocking with short timeout)
-    if (xQueueSend(s_command_queue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) {
-        ESP_LOGW(TAG, "Failed to queue command type=%d (queue full)", cmd.type);
+    submit_command(&s_transport_lane, &cmd);
+}
+
+/* Playtime used up: stop the music, and keep at it until the player reports paused */
+static void music_assistant_parental_event_handler(void *arg,
+                                                   esp_event_base_t event_base,
+                                                   int32_t event_id,
+                                                   void *event_data)
+{
+    portENTER_CRITICAL(&s_state_lock);
+    s_limit_pause_pending = true;
+    portEXIT_CRITICAL(&s_state_lock);
+
+    ma_command_t cmd = { .type = MA_CMD_PAUSE };
+    submit_command(&s_transport_lane, &cmd);
+    esp_timer_stop(s_limit_pause_timer);
+    esp_timer_start_periodic(s_limit_pause_timer, (uint64_t)PARENTAL_PAUSE_RETRY_MS * 1000);
+}
+
+static void limit_pause_timer_callback(void *arg)
+{
+    (void)arg;
+    parental_control_status_t status;
+    parental_control_get_status(&status);
+
+    portENTER_CRITICAL(&s_state_lock);
+    if (!status.limit_reached) {
+        /* A new day: the budget is back */
+        s_limit_pause_pending = false;
+    }
+    bool pending = s_limit_pause_pending;
+    portEXIT_CRITICAL(&s_state_lock);
+
+    if (!pending) {
+        esp_timer_stop(s_limit_pause_timer);
+        return;
+    }
+    /* Runs on the esp_timer task: never block; whatever is dropped goes out on the next tick */
+    ma_command_t pause = { .type = MA_CMD_PAUSE };
+    ma_command_t sync = { .type = MA_CMD_SYNC_STATE };
+    enqueue_command(&s_transport_lane, &pause, 0);
+    enqueue_command(&s_transport_lane, &sync, 0);
+}
+
+static void now_playing_timer_callback(void *arg)
+{
+    /* The slow cadence only matters while something plays; the settle timer always syncs */
+    if (arg == &s_resync_timer &&
+        music_assistant_controller_get_player_state() != MUSIC_ASSISTANT_PLAYER_STATE_PLAYING) {
+        return;
+    }
+    /* Runs on the esp_timer task: never block; a dropped sync is redone by the next one */
+    ma_command_t cmd = { .type = MA_CMD_SYNC_STATE };
+    enqueue_command(&s_transport_lane, &cmd, 0);
+}
+
+/* Reconnected: the player may have changed while we were away */
+static void music_assistant_ip_event_handler(void *arg,
+                                             esp_event_base_t event_base,
+                                             int32_t event_id,
+                                             void *event_data)
+{
+    if (s_wake_play_pending) {
+        /* The press that ended standby goes out before anything else */
+        s_wake_play_pending = false;
+        ma_command_t play = { .type = MA_CMD_PLAY };
+        submit_command(&s_transport_lane, &play);
     }
+    ma_command_t cmd = { .type = MA_CMD_SYNC_STATE };
+    submit_command(&s_transport_lane, &cmd);
 }
 
 esp_err_t music_assistant_controller_init(void)
@@ -111,30 +669,47 @@ esp_err_t music_assistant_controller_init(void)
         return ESP_OK;
     }
 
-    BaseType_t ret;
+    /* Created first: the workers arm the settle timer */
+    const esp_timer_create_args_t settle_args = {
+        .callback = now_playing_timer_callback,
+        .arg = &s_settle_timer,
+        .name = "ma_settle",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&settle_args, &s_settle_timer));
 
-    // Create command queue
-    s_command_queue = xQueueCreate(COMMAND_QUEUE_SIZE, sizeof(ma_command_t));
-    if (s_command_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create command queue");
-        return ESP_ERR_NO_MEM;
+    const esp_timer_create_args_t resync_args = {
+        .callback = now_playing_timer_callback,
+        .arg = &s_resync_timer,
+        .name = "ma_resync",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&resync_args, &s_resync_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(s_resync_timer, (uint64_t)NOW_PLAYING_RESYNC_MS * 1000));
+
+    const esp_timer_create_args_t limit_pause_args = {
+        .callback = limit_pause_timer_callback,
+        .name = "ma_limit_pause",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&limit_pause_args, &s_limit_pause_timer));
+
+    // Transport commands: ordered FIFO
+    esp_err_t err = start_lane(&s_transport_lane, "ma_worker", COMMAND_QUEUE_SIZE);
+    if (err != ESP_OK) {
+        return err;
     }
 
-    // Create worker task
-    ret = xTaskCreate(
-        music_assistant_worker_task,
-        "ma_worker",
-        WORKER_TASK_STACK_SIZE,
-        NULL,
-        WORKER_TASK_PRIORITY,
-        &s_worker_task_handle
-    );
+    // Volume: one-slot mailbox, latest level wins
+    err = start_lane(&s_volume_lane, "ma_volume", 1);
+    if (err != ESP_OK) {
+        return err;
+    }
 
-    if (ret != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create worker task");
-        vQueueDelete(s_command_queue);
-        s_command_queue = NULL;
-        return ESP_ERR_NO_MEM;
+    if (standby_get_wake_source() == STANDBY_WAKE_BUTTON) {
+        /* Back from standby: show what was loaded right away, from RTC memory */
+        s_wake_play_pending = true;
+        if (s_media_id[0] != '\0') {
+            cover_art_show(s_media_id, NULL);
+        }
+        post_now_playing(-1.0f);
     }
 
     ESP_ERROR_CHECK(buttons_subscribe(
@@ -155,8 +730,97 @@ esp_err_t music_assistant_controller_init(void)
         NULL
     ));
 
+    ESP_ERROR_CHECK(esp_event_handler_register(
+        APP_EVENTS,
+        APP_EVENT_PARENTAL_LIMIT_REACHED,
+        music_assistant_parental_event_handler,
+        NULL
+    ));
+
+    ESP_ERROR_CHECK(esp_event_handler_register(
+        IP_EVENT,
+        IP_EVENT_STA_GOT_IP,
+        music_assistant_ip_event_handler,
+        NULL
+    ));
+
     s_handlers_registered = true;
     ESP_LOGI(TAG, "Music Assistant controller initialized (queue=%d, stack=%d)", 
              COMMAND_QUEUE_SIZE, WORKER_TASK_STACK_SIZE);
     return ESP_OK;
 }
+
+esp_err_t music_assistant_controller_play_media(const char *media_id)
+{
+    return music_assistant_controller_play_media_at(media_id, 0.0f);
+}
+
+esp_err_t music_assistant_controller_play_media_at(const char *media_id, float start_position)
+{
+    if (media_id == NULL || strlen(media_id) >= sizeof(((ma_command_t *)0)->media.id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ma_command_t cmd = { .type = MA_CMD_PLAY_MEDIA };
+    strcpy(cmd.media.id, media_id);
+    cmd.media.start_position = start_position;
+    esp_err_t err = submit_command(&s_transport_lane, &cmd);
+
+    /* A known card shows its title right away, before the play_media round trip */
+    if (err == ESP_OK && set_now_playing_from_metadata(media_id)) {
+        post_now_playing(start_position);
+    }
+    return err;
+}
+
+esp_err_t music_assistant_controller_resume(float position)
+{
+    ma_command_t cmd = { .type = MA_CMD_RESUME, .position = position };
+    return submit_command(&s_transport_lane, &cmd);
+}
+
+esp_err_t music_assistant_controller_pause_and_snapshot(music_assistant_snapshot_cb_t callback,
+                                                        const void *context, size_t context_len)
+{
+    if (callback == NULL || context_len > MUSIC_ASSISTANT_SNAPSHOT_CONTEXT_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ma_command_t cmd = { .type = MA_CMD_PAUSE_SNAPSHOT };
+    cmd.snapshot.callback = callback;
+    if (context_len > 0) {
+        memcpy(cmd.snapshot.context, context, context_len);
+    }
+    return submit_command(&s_transport_lane, &cmd);
+}
+
+esp_err_t music_assistant_controller_set_volume(int volume_level)
+{
+    ma_command_t cmd = { .type = MA_CMD_SET_VOLUME, .volume_level = volume_level };
+    return submit_command(&s_volume_lane, &cmd);
+}
+
+music_assistant_player_state_t music_assistant_controller_get_player_state(void)
+{
+    portENTER_CRITICAL(&s_state_lock);
+    music_assistant_player_state_t state = s_player_state;
+    portEXIT_CRITICAL(&s_state_lock);
+    return state;
+}
+
+size_t music_assistant_controller_get_metrics(music_assistant_lane_metrics_t *metrics, size_t max_count)
+{
+    ma_lane_t *lanes[] = { &s_transport_lane, &s_volume_lane };
+    size_t count = sizeof(lanes) / sizeof(lanes[0]);
+    if (count > max_count) {
+        count = max_count;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        portENTER_CRITICAL(&lanes[i]->lock);
+        metrics[i] = lanes[i]->metrics;
+        portEXIT_CRITICAL(&lanes[i]->lock);
+        metrics[i].lane = lanes[i]->name;
+    }
+    return count;
+}
@@ -1,12 +1,111 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
+#include "music_assistant_client.h"
+
+/** Size of the context copied into a pause snapshot command */
+#define MUSIC_ASSISTANT_SNAPSHOT_CONTEXT_MAX 16
+
+/**
+ * @brief Receives the position after a pause snapshot
+ *
+ * Runs in the controller's transport worker task.
+ *
+ * @param position Playback position in seconds when playback was paused
+ * @param context  Copy of the context passed to music_assistant_controller_pause_and_snapshot()
+ */
+typedef void (*music_assistant_snapshot_cb_t)(float position, const void *context);
+
+/**
+ * @brief Per-lane execution counters
+ *
+ * Throughput of a lane is executed / busy_ms; max_wait_ms shows how long a
+ * command sat behind earlier ones on the same lane.
+ */
+typedef struct {
+    const char *lane;       /* "transport" or "volume" */
+    uint32_t submitted;
+    uint32_t executed;
+    uint32_t failed;
+    uint32_t dropped;       /* Queue full (transport lane) */
+    uint32_t superseded;    /* Replaced by a newer value before being sent (volume lane) */
+    uint32_t max_wait_ms;   /* Longest time between enqueue and start of execution */
+    uint32_t busy_ms;       /* Total time spent executing requests */
+} music_assistant_lane_metrics_t;
 
 /**
  * @brief Initialize Music Assistant controller
  *
- * Subscribes to button events and forwards them to the Music Assistant client.
+ * Starts one worker task per lane and subscribes to button events. Transport
+ * commands (buttons, play media) are executed in order on one lane; volume
+ * changes run concurrently on their own lane, where only the latest pending
+ * level is sent.
  *
  * @return ESP_OK on success, ESP_ERR_* on failure
  */
 esp_err_t music_assistant_controller_init(void);
+
+/**
+ * @brief Queue playback of a media item on the transport lane
+ *
+ * @param media_id Media URI, shorter than 128 characters
+ * @return ESP_OK if queued, ESP_ERR_INVALID_STATE before init,
+ *         ESP_ERR_TIMEOUT if the queue is full
+ */
+esp_err_t music_assistant_controller_play_media(const char *media_id);
+
+/**
+ * @brief Queue playback of a media item and seek to a start position
+ *
+ * @param media_id       Media URI, shorter than 128 characters
+ * @param start_position Position in seconds to seek to once loaded; 0 to start at the beginning
+ * @return See music_assistant_controller_play_media()
+ */
+esp_err_t music_assistant_controller_play_media_at(const char *media_id, float start_position);
+
+/**
+ * @brief Queue a seek to position followed by play, on the transport lane
+ *
+ * Continues the media already loaded in the player without reloading it.
+ */
+esp_err_t music_assistant_controller_resume(float position);
+
+/**
+ * @brief Queue a pause and report the position it stopped at
+ *
+ * @param callback    Called with the position once the pause succeeded; not
+ *                    called if the pause request failed
+ * @param context     Up to MUSIC_ASSISTANT_SNAPSHOT_CONTEXT_MAX bytes copied into the command
+ * @param context_len Size of context
+ */
+esp_err_t music_assistant_controller_pause_and_snapshot(music_assistant_snapshot_cb_t callback,
+                                                        const void *context, size_t context_len);
+
+/**
+ * @brief Queue a volume change on the volume lane
+ *
+ * Never blocks. A level that has not been sent yet is replaced.
+ *
+ * @param volume_level Volume level (0-100)
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE before init
+ */
+esp_err_t music_assistant_controller_set_volume(int volume_level);
+
+/**
+ * @brief Player state as intended by the commands queued so far
+ *
+ * Cached locally; reconciled with Home Assistant on reconnect and whenever a
+ * toggle meets an unknown state. Never blocks.
+ */
+music_assistant_player_state_t music_assistant_controller_get_player_state(void);
+
+/**
+ * @brief Copy the per-lane counters
+ *
+ * @param metrics   Output array
+ * @param max_count Capacity of the output array
+ * @return Number of entries written
+ */
+size_t music_assistant_controller_get_metrics(music_assistant_lane_metrics_t *metrics, size_t max_count);
@@ -0,0 +1,255 @@
+#include "music_assistant_endpoint.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "common/config.h"
+#include "common/app_events.h"
+
+static const char *TAG = "MA_ENDPOINT";
+
+/* Clock granularity term of the RTO formula (RFC 6298 "G") */
+#define RTO_GRANULARITY_US 10000
+
+_Static_assert(CONFIG_MUSIC_ASSISTANT_TIMEOUT_MIN_MS <= CONFIG_MUSIC_ASSISTANT_TIMEOUT_MAX_MS,
+               "MUSIC_ASSISTANT_TIMEOUT_MIN_MS must not exceed MUSIC_ASSISTANT_TIMEOUT_MAX_MS");
+
+/* One breaker for the Home Assistant host, shared by all endpoints */
+typedef struct {
+    music_assistant_breaker_state_t state;
+    uint32_t consecutive_failures;
+    int64_t opened_at_us;
+    bool probe_in_flight;
+} host_breaker_t;
+
+static host_breaker_t s_breaker = { .state = MUSIC_ASSISTANT_BREAKER_CLOSED };
+static portMUX_TYPE s_breaker_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int32_t clamp_timeout_ms(const music_assistant_endpoint_t *endpoint, int64_t timeout_ms)
+{
+    if (timeout_ms < endpoint->min_timeout_ms) {
+        return endpoint->min_timeout_ms;
+    }
+    if (timeout_ms > CONFIG_MUSIC_ASSISTANT_TIMEOUT_MAX_MS) {
+        return CONFIG_MUSIC_ASSISTANT_TIMEOUT_MAX_MS;
+    }
+    return (int32_t)timeout_ms;
+}
+
+void music_assistant_endpoint_init(music_assistant_endpoint_t *endpoint, const char *name, int32_t min_timeout_ms)
+{
+    memset(endpoint, 0, sizeof(*endpoint));
+    endpoint->name = name;
+    endpoint->min_timeout_ms = min_timeout_ms < CONFIG_MUSIC_ASSISTANT_TIMEOUT_MAX_MS ?
+                               min_timeout_ms : CONFIG_MUSIC_ASSISTANT_TIMEOUT_MAX_MS;
+    endpoint->timeout_ms = clamp_timeout_ms(endpoint, HTTP_REQUEST_TIMEOUT_MS);
+    portMUX_INITIALIZE(&endpoint->lock);
+}
+
+int music_assistant_endpoint_timeout_ms(music_assistant_endpoint_t *endpoint)
+{
+    portENTER_CRITICAL(&endpoint->lock);
+    int timeout_ms = endpoint->timeout_ms;
+    portEXIT_CRITICAL(&endpoint->lock);
+    return timeout_ms;
+}
+
+void music_assistant_endpoint_on_response(music_assistant_endpoint_t *endpoint, int64_t rtt_us)
+{
+    if (rtt_us < 0) {
+        return;
+    }
+    if (rtt_us > INT32_MAX) {
+        rtt_us = INT32_MAX;
+    }
+
+    portENTER_CRITICAL(&endpoint->lock);
+    if (endpoint->samples == 0) {
+        endpoint->srtt_us = (int32_t)rtt_us;
+        endpoint->rttvar_us = (int32_t)(rtt_us / 2);
+    } else {
+        /* rttvar = 3/4 rttvar + 1/4 |srtt - rtt|,  srtt = 7/8 srtt + 1/8 rtt */
+        int32_t delta = abs(endpoint->srtt_us - (int32_t)rtt_us);
+        endpoint->rttvar_us = endpoint->rttvar_us - (endpoint->rttvar_us >> 2) + (delta >> 2);
+        endpoint->srtt_us = endpoint->srtt_us - (endpoint->srtt_us >> 3) + (int32_t)(rtt_us >> 3);
+    }
+    endpoint->samples++;
+
+    int64_t variance_term = (int64_t)endpoint->rttvar_us * 4;
+    if (variance_term < RTO_GRANULARITY_US) {
+        variance_term = RTO_GRANULARITY_US;
+    }
+    endpoint->timeout_ms = clamp_timeout_ms(endpoint, (endpoint->srtt_us + variance_term + 999) / 1000);
+    int32_t srtt_us = endpoint->srtt_us;
+    int32_t timeout_ms = endpoint->timeout_ms;
+    portEXIT_CRITICAL(&endpoint->lock);
+
+    ESP_LOGD(TAG, "%s: rtt=%lldms srtt=%ldms timeout=%ldms",
+             endpoint->name, (long long)(rtt_us / 1000), (long)(srtt_us / 1000), (long)timeout_ms);
+}
+
+void music_assistant_endpoint_on_timeout(music_assistant_endpoint_t *endpoint)
+{
+    portENTER_CRITICAL(&endpoint->lock);
+    endpoint->timeouts++;
+    endpoint->timeout_ms = clamp_timeout_ms(endpoint, (int64_t)endpoint->timeout_ms * 2);
+    int32_t timeout_ms = endpoint->timeout_ms;
+    portEXIT_CRITICAL(&endpoint->lock);
+
+    ESP_LOGW(TAG, "%s: request timed out, next timeout %ldms", endpoint->name, (long)timeout_ms);
+}
+
+static const char *breaker_state_name(music_assistant_breaker_state_t state)
+{
+    switch (state) {
+        case MUSIC_ASSISTANT_BREAKER_CLOSED:    return "closed";
+        case MUSIC_ASSISTANT_BREAKER_OPEN:      return "open";
+        case MUSIC_ASSISTANT_BREAKER_HALF_OPEN: return "half-open";
+        default:                                return "unknown";
+    }
+}
+
+/* Called outside the critical section: logging and event posting may block */
+static void publish_breaker_transition(const music_assistant_endpoint_t *endpoint,
+                                       music_assistant_breaker_state_t from,
+                                       music_assistant_breaker_state_t to)
+{
+    app_error_event_t event = {0};
+
+    ESP_LOGW(TAG, "Circuit breaker %s -> %s (on %s)", breaker_state_name(from), breaker_state_name(to), endpoint->name);
+
+    switch (to) {
+        case MUSIC_ASSISTANT_BREAKER_OPEN:
+            event.error_code = ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_OPEN;
+            event.error_message = "Music Assistant unreachable";
+            break;
+        case MUSIC_ASSISTANT_BREAKER_HALF_OPEN:
+            event.error_code = ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_PROBING;
+            event.error_message = "Music Assistant probing";
+            break;
+        case MUSIC_ASSISTANT_BREAKER_CLOSED:
+        default:
+            event.error_code = ESP_OK;
+            event.error_message = "Music Assistant reachable";
+            break;
+    }
+
+    esp_err_t err = esp_event_post(APP_EVENTS, APP_EVENT_ERROR, &event, sizeof(event), 0);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to post breaker event: %s", esp_err_to_name(err));
+    }
+}
+
+esp_err_t music_assistant_endpoint_acquire(music_assistant_endpoint_t *endpoint)
+{
+    esp_err_t result = ESP_OK;
+    bool transitioned = false;
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_breaker_lock);
+    switch (s_breaker.state) {
+        case MUSIC_ASSISTANT_BREAKER_OPEN:
+            if (now_us - s_breaker.opened_at_us >= (int64_t)CONFIG_MUSIC_ASSISTANT_BREAKER_OPEN_MS * 1000) {
+                /* Cool-down elapsed: let exactly this request through as a probe */
+                s_breaker.state = MUSIC_ASSISTANT_BREAKER_HALF_OPEN;
+                s_breaker.probe_in_flight = true;
+                transitioned = true;
+            } else {
+                result = ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_OPEN;
+            }
+            break;
+        case MUSIC_ASSISTANT_BREAKER_HALF_OPEN:
+            if (s_breaker.probe_in_flight) {
+                result = ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_OPEN;
+            } else {
+                s_breaker.probe_in_flight = true;
+            }
+            break;
+        case MUSIC_ASSISTANT_BREAKER_CLOSED:
+        default:
+            break;
+    }
+    portEXIT_CRITICAL(&s_breaker_lock);
+
+    if (result != ESP_OK) {
+        portENTER_CRITICAL(&endpoint->lock);
+        endpoint->rejected++;
+        portEXIT_CRITICAL(&endpoint->lock);
+    }
+
+    if (transitioned) {
+        publish_breaker_transition(endpoint, MUSIC_ASSISTANT_BREAKER_OPEN, MUSIC_ASSISTANT_BREAKER_HALF_OPEN);
+    }
+    return result;
+}
+
+esp_err_t music_assistant_endpoint_check_host(music_assistant_endpoint_t *endpoint)
+{
+    portENTER_CRITICAL(&s_breaker_lock);
+    bool closed = s_breaker.state == MUSIC_ASSISTANT_BREAKER_CLOSED;
+    portEXIT_CRITICAL(&s_breaker_lock);
+
+    if (closed) {
+        return ESP_OK;
+    }
+    portENTER_CRITICAL(&endpoint->lock);
+    endpoint->rejected++;
+    portEXIT_CRITICAL(&endpoint->lock);
+    return ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_OPEN;
+}
+
+void music_assistant_endpoint_on_success(music_assistant_endpoint_t *endpoint)
+{
+    portENTER_CRITICAL(&s_breaker_lock);
+    music_assistant_breaker_state_t from = s_breaker.state;
+    s_breaker.consecutive_failures = 0;
+    s_breaker.probe_in_flight = false;
+    s_breaker.state = MUSIC_ASSISTANT_BREAKER_CLOSED;
+    portEXIT_CRITICAL(&s_breaker_lock);
+
+    if (from != MUSIC_ASSISTANT_BREAKER_CLOSED) {
+        publish_breaker_transition(endpoint, from, MUSIC_ASSISTANT_BREAKER_CLOSED);
+    }
+}
+
+void music_assistant_endpoint_on_failure(music_assistant_endpoint_t *endpoint)
+{
+    portENTER_CRITICAL(&s_breaker_lock);
+    music_assistant_breaker_state_t from = s_breaker.state;
+    s_breaker.consecutive_failures++;
+    s_breaker.probe_in_flight = false;
+    if (from == MUSIC_ASSISTANT_BREAKER_HALF_OPEN ||
+        (from == MUSIC_ASSISTANT_BREAKER_CLOSED &&
+         s_breaker.consecutive_failures >= CONFIG_MUSIC_ASSISTANT_BREAKER_FAILURE_THRESHOLD)) {
+        s_breaker.state = MUSIC_ASSISTANT_BREAKER_OPEN;
+        s_breaker.opened_at_us = esp_timer_get_time();
+    }
+    music_assistant_breaker_state_t to = s_breaker.state;
+    portEXIT_CRITICAL(&s_breaker_lock);
+
+    if (from != to) {
+        publish_breaker_transition(endpoint, from, to);
+    }
+}
+
+void music_assistant_endpoint_get_metrics(music_assistant_endpoint_t *endpoint,
+                                          music_assistant_endpoint_metrics_t *metrics)
+{
+    portENTER_CRITICAL(&endpoint->lock);
+    metrics->endpoint = endpoint->name;
+    metrics->srtt_ms = (uint32_t)(endpoint->srtt_us / 1000);
+    metrics->rttvar_ms = (uint32_t)(endpoint->rttvar_us / 1000);
+    metrics->timeout_ms = (uint32_t)endpoint->timeout_ms;
+    metrics->samples = endpoint->samples;
+    metrics->timeouts = endpoint->timeouts;
+    metrics->rejected = endpoint->rejected;
+    portEXIT_CRITICAL(&endpoint->lock);
+
+    portENTER_CRITICAL(&s_breaker_lock);
+    metrics->breaker_state = s_breaker.state;
+    portEXIT_CRITICAL(&s_breaker_lock);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "music_assistant_client.h"
+
+/**
+ * @file music_assistant_endpoint.h
+ * @brief Per-endpoint transport state for the Music Assistant client
+ *
+ * Each Home Assistant service path the client talks to is tracked as an
+ * endpoint. The endpoint keeps a smoothed round-trip time and its variance
+ * the way TCP does (RFC 6298) and derives the request timeout from them,
+ * clamped to the endpoint's floor..CONFIG_MUSIC_ASSISTANT_TIMEOUT_MAX_MS.
+ * Reads use CONFIG_MUSIC_ASSISTANT_TIMEOUT_MIN_MS as the floor; service
+ * calls, which the server answers only after doing the work, a higher one.
+ *
+ * All endpoints live on the same Home Assistant host, so they share one
+ * circuit breaker. After CONFIG_MUSIC_ASSISTANT_BREAKER_FAILURE_THRESHOLD
+ * consecutive failures on any mix of endpoints the breaker opens and requests
+ * to every endpoint are rejected without touching the network. After
+ * CONFIG_MUSIC_ASSISTANT_BREAKER_OPEN_MS a single probe request to whichever
+ * endpoint asks first is let through (half-open); its result closes or
+ * re-opens the breaker. Every transition of the host breaker is published
+ * once as APP_EVENT_ERROR, so there is one reachability state.
+ *
+ * Best-effort requests (cover pictures) stay out of the breaker: they only
+ * look at it (music_assistant_endpoint_check_host()) and never report to it,
+ * so a slow or missing picture cannot lock out the transport commands.
+ *
+ * All functions are safe to call from any task.
+ */
+
+typedef struct {
+    const char *name;
+    int32_t srtt_us;        /* Smoothed round-trip time, 0 until first sample */
+    int32_t rttvar_us;      /* Round-trip time variance */
+    int32_t timeout_ms;     /* Current request timeout (RTO) */
+    int32_t min_timeout_ms; /* Floor of timeout_ms */
+    uint32_t samples;
+    uint32_t timeouts;
+    uint32_t rejected;      /* Requests to this endpoint refused by the host breaker */
+    portMUX_TYPE lock;
+} music_assistant_endpoint_t;
+
+/**
+ * @brief Reset an endpoint to its initial state
+ *
+ * The initial timeout is HTTP_REQUEST_TIMEOUT_MS clamped to the bounds.
+ *
+ * @param endpoint       Endpoint to initialize
+ * @param name           Static name used in logs and metrics (e.g. the service path)
+ * @param min_timeout_ms Floor of the timeout, at most CONFIG_MUSIC_ASSISTANT_TIMEOUT_MAX_MS
+ */
+void music_assistant_endpoint_init(music_assistant_endpoint_t *endpoint, const char *name, int32_t min_timeout_ms);
+
+/**
+ * @brief Timeout to use for the next request to this endpoint
+ */
+int music_assistant_endpoint_timeout_ms(music_assistant_endpoint_t *endpoint);
+
+/**
+ * @brief Feed a measured round-trip time (request sent to headers received)
+ */
+void music_assistant_endpoint_on_response(music_assistant_endpoint_t *endpoint, int64_t rtt_us);
+
+/**
+ * @brief Record a request that ran into its timeout
+ *
+ * Backs the timeout off exponentially (up to the maximum bound) until the
+ * next successful sample, like a TCP retransmission timeout.
+ */
+void music_assistant_endpoint_on_timeout(music_assistant_endpoint_t *endpoint);
+
+/**
+ * @brief Ask the host's circuit breaker whether a request to this endpoint
+ *        may be sent now
+ *
+ * Must be paired with music_assistant_endpoint_on_success() or
+ * music_assistant_endpoint_on_failure() when ESP_OK is returned.
+ *
+ * @return ESP_OK if the request may proceed,
+ *         ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_OPEN if it must fail immediately
+ */
+esp_err_t music_assistant_endpoint_acquire(music_assistant_endpoint_t *endpoint);
+
+/**
+ * @brief Ask whether the host breaker lets requests through, without taking
+ *        the half-open probe or being paired with a report
+ *
+ * For best-effort requests that must not affect the breaker.
+ *
+ * @return ESP_OK if the breaker is closed,
+ *         ESP_ERR_MUSIC_ASSISTANT_CIRCUIT_OPEN otherwise (counted as rejected)
+ */
+esp_err_t music_assistant_endpoint_check_host(music_assistant_endpoint_t *endpoint);
+
+/**
+ * @brief Report that the server answered (any status below 500)
+ */
+void music_assistant_endpoint_on_success(music_assistant_endpoint_t *endpoint);
+
+/**
+ * @brief Report a transport error, timeout or 5xx response
+ */
+void music_assistant_endpoint_on_failure(music_assistant_endpoint_t *endpoint);
+
+/**
+ * @brief Copy a consistent snapshot of the endpoint state
+ *
+ * breaker_state is the shared host breaker's.
+ */
+void music_assistant_endpoint_get_metrics(music_assistant_endpoint_t *endpoint,
+                                          music_assistant_endpoint_metrics_t *metrics);
@@ -0,0 +1,187 @@
+#include "music_assistant_gzip.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rom/miniz.h"
+
+/* RFC 1952 member header flags */
+#define GZIP_FLAG_HCRC      0x02
+#define GZIP_FLAG_EXTRA     0x04
+#define GZIP_FLAG_NAME      0x08
+#define GZIP_FLAG_COMMENT   0x10
+#define GZIP_FIXED_HEADER_LEN 10
+
+typedef enum {
+    GZIP_STATE_FIXED_HEADER,
+    GZIP_STATE_EXTRA_LEN,
+    GZIP_STATE_EXTRA,
+    GZIP_STATE_NAME,
+    GZIP_STATE_COMMENT,
+    GZIP_STATE_HCRC,
+    GZIP_STATE_DEFLATE,
+    GZIP_STATE_DONE,
+} gzip_state_t;
+
+struct music_assistant_gzip {
+    tinfl_decompressor inflator;
+    gzip_state_t state;
+    uint8_t flags;
+    size_t header_pos;      /* Bytes consumed of the current header field */
+    size_t extra_len;
+    uint8_t *out;
+    size_t out_capacity;    /* Excluding the terminating NUL */
+    size_t out_len;
+};
+
+music_assistant_gzip_t *music_assistant_gzip_create(char *out, size_t out_size)
+{
+    if (out == NULL || out_size < 2) {
+        return NULL;
+    }
+
+    music_assistant_gzip_t *gzip = calloc(1, sizeof(*gzip));
+    if (gzip == NULL) {
+        return NULL;
+    }
+
+    tinfl_init(&gzip->inflator);
+    gzip->state = GZIP_STATE_FIXED_HEADER;
+    gzip->out = (uint8_t *)out;
+    gzip->out_capacity = out_size - 1;
+    out[0] = '\0';
+    return gzip;
+}
+
+/* Advance to the next optional header field announced by the flags */
+static gzip_state_t next_header_state(const music_assistant_gzip_t *gzip, gzip_state_t after)
+{
+    switch (after) {
+        case GZIP_STATE_FIXED_HEADER:
+            if (gzip->flags & GZIP_FLAG_EXTRA) return GZIP_STATE_EXTRA_LEN;
+            /* fall through */
+        case GZIP_STATE_EXTRA:
+            if (gzip->flags & GZIP_FLAG_NAME) return GZIP_STATE_NAME;
+            /* fall through */
+        case GZIP_STATE_NAME:
+            if (gzip->flags & GZIP_FLAG_COMMENT) return GZIP_STATE_COMMENT;
+            /* fall through */
+        case GZIP_STATE_COMMENT:
+            if (gzip->flags & GZIP_FLAG_HCRC) return GZIP_STATE_HCRC;
+            /* fall through */
+        default:
+            return GZIP_STATE_DEFLATE;
+    }
+}
+
+/* Consume header bytes; returns the number of bytes used or -1 on a bad header */
+static int parse_header(music_assistant_gzip_t *gzip, const uint8_t *data, size_t len)
+{
+    size_t used = 0;
+
+    while (used < len && gzip->state != GZIP_STATE_DEFLATE) {
+        uint8_t byte = data[used++];
+
+        switch (gzip->state) {
+            case GZIP_STATE_FIXED_HEADER:
+                /* ID1 ID2 CM FLG MTIME(4) XFL OS */
+                if ((gzip->header_pos == 0 && byte != 0x1f) ||
+                    (gzip->header_pos == 1 && byte != 0x8b) ||
+                    (gzip->header_pos == 2 && byte != 8)) {
+                    return -1;
+                }
+                if (gzip->header_pos == 3) {
+                    gzip->flags = byte;
+                }
+                if (++gzip->header_pos == GZIP_FIXED_HEADER_LEN) {
+                    gzip->header_pos = 0;
+                    gzip->state = next_header_state(gzip, GZIP_STATE_FIXED_HEADER);
+                }
+                break;
+            case GZIP_STATE_EXTRA_LEN:
+                gzip->extra_len |= (size_t)byte << (8 * gzip->header_pos);
+                if (++gzip->header_pos == 2) {
+                    gzip->header_pos = 0;
+                    gzip->state = gzip->extra_len > 0 ? GZIP_STATE_EXTRA
+                                                      : next_header_state(gzip, GZIP_STATE_EXTRA);
+                }
+                break;
+            case GZIP_STATE_EXTRA:
+                if (++gzip->header_pos == gzip->extra_len) {
+                    gzip->header_pos = 0;
+                    gzip->state = next_header_state(gzip, GZIP_STATE_EXTRA);
+                }
+                break;
+            case GZIP_STATE_NAME:
+            case GZIP_STATE_COMMENT:
+                if (byte == 0) {
+                    gzip->state = next_header_state(gzip, gzip->state);
+                }
+                break;
+            case GZIP_STATE_HCRC:
+                if (++gzip->header_pos == 2) {
+                    gzip->header_pos = 0;
+                    gzip->state = GZIP_STATE_DEFLATE;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return (int)used;
+}
+
+esp_err_t music_assistant_gzip_feed(music_assistant_gzip_t *gzip, const uint8_t *data, size_t len)
+{
+    if (gzip->state != GZIP_STATE_DEFLATE && gzip->state != GZIP_STATE_DONE) {
+        int used = parse_header(gzip, data, len);
+        if (used < 0) {
+            gzip->state = GZIP_STATE_DONE;
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        data += used;
+        len -= (size_t)used;
+    }
+
+    while (len > 0 && gzip->state == GZIP_STATE_DEFLATE) {
+        size_t in_size = len;
+        size_t out_size = gzip->out_capacity - gzip->out_len;
+
+        /* Raw deflate into a non-wrapping window: back references may point anywhere before out_len */
+        tinfl_status status = tinfl_decompress(&gzip->inflator, data, &in_size,
+                                               gzip->out, gzip->out + gzip->out_len, &out_size,
+                                               TINFL_FLAG_HAS_MORE_INPUT | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+        data += in_size;
+        len -= in_size;
+        gzip->out_len += out_size;
+        gzip->out[gzip->out_len] = '\0';
+
+        if (status < TINFL_STATUS_DONE) {
+            gzip->state = GZIP_STATE_DONE;
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (status == TINFL_STATUS_DONE || status == TINFL_STATUS_HAS_MORE_OUTPUT) {
+            /* End of stream (the CRC32/ISIZE trailer is ignored) or window full: truncate */
+            gzip->state = GZIP_STATE_DONE;
+        } else if (in_size == 0 && out_size == 0) {
+            /* TINFL_STATUS_NEEDS_MORE_INPUT with nothing consumed: wait for the next chunk */
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+bool music_assistant_gzip_done(const music_assistant_gzip_t *gzip)
+{
+    return gzip->state == GZIP_STATE_DONE;
+}
+
+size_t music_assistant_gzip_output_len(const music_assistant_gzip_t *gzip)
+{
+    return gzip->out_len;
+}
+
+void music_assistant_gzip_destroy(music_assistant_gzip_t *gzip)
+{
+    free(gzip);
+}
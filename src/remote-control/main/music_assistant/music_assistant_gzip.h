@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @file music_assistant_gzip.h
+ * @brief Streaming gzip decoder for Music Assistant responses
+ *
+ * Feeds a gzip body (RFC 1952) chunk by chunk through the ROM tinfl inflater
+ * straight into the caller's document buffer, so no compressed copy of the
+ * body is kept. The buffer is used as a non-wrapping window: the document
+ * must fit into it, and a longer document is truncated exactly like an
+ * uncompressed one that does not fit.
+ */
+
+typedef struct music_assistant_gzip music_assistant_gzip_t;
+
+/**
+ * @brief Create a decoder writing into out (NUL-terminated, at most out_size - 1 bytes)
+ *
+ * Allocates the inflater state (about 11 kB) for the lifetime of the decoder.
+ *
+ * @return Decoder, or NULL if out of memory
+ */
+music_assistant_gzip_t *music_assistant_gzip_create(char *out, size_t out_size);
+
+/**
+ * @brief Decode the next chunk of the gzip stream
+ *
+ * @return ESP_OK if the chunk was consumed (see music_assistant_gzip_done()),
+ *         ESP_ERR_INVALID_RESPONSE if the stream is not valid gzip/deflate
+ */
+esp_err_t music_assistant_gzip_feed(music_assistant_gzip_t *gzip, const uint8_t *data, size_t len);
+
+/**
+ * @brief Whether the stream ended or the output buffer is full
+ */
+bool music_assistant_gzip_done(const music_assistant_gzip_t *gzip);
+
+/**
+ * @brief Number of document bytes produced so far
+ */
+size_t music_assistant_gzip_output_len(const music_assistant_gzip_t *gzip);
+
+/**
+ * @brief Free the decoder (not the output buffer)
+ */
+void music_assistant_gzip_destroy(music_assistant_gzip_t *gzip);
@@ -0,0 +1,134 @@
+#include "music_assistant_playback_clock.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "common/config.h"
+#include "wifi/time_sync.h"
+
+static const char *TAG = "MA_PLAYBACK_CLOCK";
+
+static struct {
+    bool valid;
+    bool playing;
+    float anchor_position;      /* Seconds at anchor_us */
+    int64_t anchor_us;          /* esp_timer time of the anchor */
+} s_clock;
+
+static music_assistant_playback_clock_metrics_t s_metrics;
+static portMUX_TYPE s_clock_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Must be called with s_clock_lock held */
+static float predicted_position(int64_t now_us)
+{
+    if (!s_clock.playing) {
+        return s_clock.anchor_position;
+    }
+    return s_clock.anchor_position + (float)(now_us - s_clock.anchor_us) / 1e6f;
+}
+
+void music_assistant_playback_clock_seed(float position, double updated_epoch, bool playing)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    /* Age of the server sample; without a synced wall clock it is unknown and taken as 0 */
+    double age_s = 0.0;
+    if (updated_epoch > 0.0 && time_sync_is_synced()) {
+        age_s = (double)time_sync_now_us() / 1e6 - updated_epoch;
+        if (age_s < 0.0) {
+            age_s = 0.0;
+        }
+    }
+    float server_position = playing ? position + (float)age_s : position;
+
+    portENTER_CRITICAL(&s_clock_lock);
+    bool compare = s_clock.valid;
+    float drift_s = compare ? server_position - predicted_position(now_us) : 0.0f;
+
+    s_clock.valid = true;
+    s_clock.playing = playing;
+    s_clock.anchor_position = server_position;
+    s_clock.anchor_us = now_us;
+
+    if (compare) {
+        int32_t drift_ms = (int32_t)lroundf(drift_s * 1000.0f);
+        s_metrics.samples++;
+        s_metrics.last_drift_ms = drift_ms;
+        if ((uint32_t)abs(drift_ms) > s_metrics.max_abs_drift_ms) {
+            s_metrics.max_abs_drift_ms = (uint32_t)abs(drift_ms);
+        }
+    }
+    s_metrics.seeds++;
+    s_metrics.wall_clock_synced = time_sync_is_synced();
+    portEXIT_CRITICAL(&s_clock_lock);
+
+    if (compare) {
+        ESP_LOGI(TAG, "Seeded at %.1fs, drift against local prediction %+.0f ms", server_position, drift_s * 1000.0f);
+    }
+}
+
+void music_assistant_playback_clock_set_position(float position, bool playing)
+{
+    portENTER_CRITICAL(&s_clock_lock);
+    s_clock.valid = true;
+    s_clock.playing = playing;
+    s_clock.anchor_position = position < 0.0f ? 0.0f : position;
+    s_clock.anchor_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_clock_lock);
+}
+
+void music_assistant_playback_clock_seek(float position)
+{
+    portENTER_CRITICAL(&s_clock_lock);
+    s_clock.playing = s_clock.valid ? s_clock.playing : true;
+    s_clock.valid = true;
+    s_clock.anchor_position = position < 0.0f ? 0.0f : position;
+    s_clock.anchor_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_clock_lock);
+}
+
+void music_assistant_playback_clock_set_playing(bool playing)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_clock_lock);
+    if (s_clock.valid && s_clock.playing != playing) {
+        s_clock.anchor_position = predicted_position(now_us);
+        s_clock.anchor_us = now_us;
+        s_clock.playing = playing;
+    }
+    portEXIT_CRITICAL(&s_clock_lock);
+}
+
+void music_assistant_playback_clock_invalidate(void)
+{
+    portENTER_CRITICAL(&s_clock_lock);
+    s_clock.valid = false;
+    portEXIT_CRITICAL(&s_clock_lock);
+}
+
+esp_err_t music_assistant_playback_clock_get_position(float *position)
+{
+    int64_t now_us = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+
+    portENTER_CRITICAL(&s_clock_lock);
+    if (!s_clock.valid || now_us - s_clock.anchor_us > (int64_t)PLAYBACK_CLOCK_MAX_AGE_MS * 1000) {
+        /* Tracks end and others may control the player; do not trust an old anchor */
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        *position = predicted_position(now_us);
+    }
+    portEXIT_CRITICAL(&s_clock_lock);
+    return err;
+}
+
+void music_assistant_playback_clock_get_metrics(music_assistant_playback_clock_metrics_t *metrics)
+{
+    portENTER_CRITICAL(&s_clock_lock);
+    *metrics = s_metrics;
+    portEXIT_CRITICAL(&s_clock_lock);
+}
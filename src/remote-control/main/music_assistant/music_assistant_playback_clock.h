@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "music_assistant_client.h"
+
+/**
+ * @file music_assistant_playback_clock.h
+ * @brief Local model of the player's playback position
+ *
+ * The clock is anchored at a position and a monotonic (esp_timer) instant and
+ * advances at rate 1 while playing, 0 while paused. It is seeded from
+ * positions reported by Home Assistant. If the wall clock is synchronised
+ * (time_sync), the time since the server's position update is accounted
+ * for. Local transport commands move the anchor without a network read.
+ * Reading the position is O(1) and never touches the network.
+ *
+ * Every server report that arrives while the clock is already running is
+ * compared with the local prediction; the difference is kept as drift.
+ *
+ * All functions are safe to call from any task.
+ */
+
+/**
+ * @brief Seed the clock from a position reported by the server
+ *
+ * @param position      media_position in seconds
+ * @param updated_epoch media_position_updated_at as Unix time, or 0 if unknown
+ * @param playing       Whether the player is playing
+ */
+void music_assistant_playback_clock_seed(float position, double updated_epoch, bool playing);
+
+/**
+ * @brief Re-anchor at a known position after a local command (seek, new media)
+ */
+void music_assistant_playback_clock_set_position(float position, bool playing);
+
+/**
+ * @brief Re-anchor at a seek target, keeping the playing state
+ *
+ * If the clock is unseeded it is assumed to be playing.
+ */
+void music_assistant_playback_clock_seek(float position);
+
+/**
+ * @brief Start or stop the clock at its current position (play / pause)
+ */
+void music_assistant_playback_clock_set_playing(bool playing);
+
+/**
+ * @brief Forget the position, e.g. when the player state became unknown
+ */
+void music_assistant_playback_clock_invalidate(void);
+
+/**
+ * @brief Current position predicted by the clock
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if the clock is unseeded or its
+ *         anchor is older than PLAYBACK_CLOCK_MAX_AGE_MS
+ */
+esp_err_t music_assistant_playback_clock_get_position(float *position);
+
+/**
+ * @brief Copy the clock's drift statistics
+ */
+void music_assistant_playback_clock_get_metrics(music_assistant_playback_clock_metrics_t *metrics);
@@ -0,0 +1,258 @@
+#include "parental_control.h"
+
+#include <time.h>
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+#include "common/config.h"
+#include "sdkconfig.h"
+#include "common/app_events.h"
+#include "storage/log_store.h"
+#include "wifi/time_sync.h"
+
+static const char *TAG = "PARENTAL";
+
+#define STORE_KEY "playtime"
+#define BUDGET_MS ((int64_t)CONFIG_PARENTAL_DAILY_LIMIT_MIN * 60 * 1000)
+
+typedef struct {
+    uint32_t day;
+    uint32_t used_s;
+} playtime_record_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t s_limit_timer = NULL;
+static TimerHandle_t s_checkpoint_timer = NULL;
+
+static uint32_t s_day = 0;
+static int64_t s_used_ms = 0;           /* Today, without the running session */
+static int64_t s_session_start_us = 0;  /* 0 while not playing */
+static bool s_limit_reached = false;
+static uint32_t s_blocked = 0;
+
+/* Local date as YYYYMMDD, or 0 while the wall clock is unknown */
+static uint32_t current_day(void)
+{
+    if (!time_sync_is_synced()) {
+        return 0;
+    }
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    return (uint32_t)((local.tm_year + 1900) * 10000 + (local.tm_mon + 1) * 100 + local.tm_mday);
+}
+
+static int64_t used_ms_locked(int64_t now_us)
+{
+    int64_t used = s_used_ms;
+    if (s_session_start_us != 0) {
+        used += (now_us - s_session_start_us) / 1000;
+    }
+    return used;
+}
+
+/* Start a new budget when the date changed; called with s_lock held */
+static void roll_day_locked(uint32_t today, int64_t now_us)
+{
+    if (today == 0 || today == s_day) {
+        return;
+    }
+    if (s_day != 0) {
+        s_used_ms = 0;
+        s_limit_reached = false;
+        if (s_session_start_us != 0) {
+            s_session_start_us = now_us;
+        }
+    }
+    /* Usage counted before the clock was set belongs to today */
+    s_day = today;
+}
+
+static void persist(uint32_t day, int64_t used_ms)
+{
+    playtime_record_t record = { .day = day, .used_s = (uint32_t)(used_ms / 1000) };
+    esp_err_t err = log_store_set(STORE_KEY, &record, sizeof(record));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save playtime: %s", esp_err_to_name(err));
+    }
+}
+
+/*
+ * Save the running session while it plays, so a reboot or power loss loses
+ * at most this interval plus the log store's flush delay. A FreeRTOS timer,
+ * not an esp_timer: log_store_set() waits while a flush holds the store.
+ */
+static void checkpoint_timer_callback(TimerHandle_t timer)
+{
+    (void)timer;
+    uint32_t today = current_day();
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    roll_day_locked(today, now_us);
+    bool playing = s_session_start_us != 0;
+    int64_t used = used_ms_locked(now_us);
+    uint32_t day = s_day;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (playing) {
+        persist(day, used);
+    }
+}
+
+static void post_limit_reached(void)
+{
+    ESP_LOGW(TAG, "Daily playtime of %d min used up", CONFIG_PARENTAL_DAILY_LIMIT_MIN);
+    esp_err_t err = esp_event_post(APP_EVENTS, APP_EVENT_PARENTAL_LIMIT_REACHED, NULL, 0, 0);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to post limit event: %s", esp_err_to_name(err));
+    }
+}
+
+static void limit_timer_callback(void *arg)
+{
+    (void)arg;
+    uint32_t today = current_day();
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    roll_day_locked(today, now_us);
+    int64_t used = used_ms_locked(now_us);
+    bool playing = s_session_start_us != 0;
+    bool reached = playing && used >= BUDGET_MS;
+    int64_t remaining_ms = BUDGET_MS - used;
+    if (reached) {
+        s_limit_reached = true;
+    }
+    uint32_t day = s_day;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (reached) {
+        persist(day, used);
+        post_limit_reached();
+    } else if (playing && remaining_ms > 0) {
+        /* The day rolled over mid-session: wait for the fresh budget */
+        esp_timer_start_once(s_limit_timer, (uint64_t)remaining_ms * 1000);
+    }
+}
+
+void parental_control_on_playback(bool playing)
+{
+    if (BUDGET_MS == 0 || s_limit_timer == NULL) {
+        return;
+    }
+
+    uint32_t today = current_day();
+    int64_t now_us = esp_timer_get_time();
+    bool started = false;
+    bool stopped = false;
+
+    portENTER_CRITICAL(&s_lock);
+    roll_day_locked(today, now_us);
+    if (playing && s_session_start_us == 0) {
+        s_session_start_us = now_us;
+        started = true;
+    } else if (!playing && s_session_start_us != 0) {
+        s_used_ms += (now_us - s_session_start_us) / 1000;
+        s_session_start_us = 0;
+        stopped = true;
+    }
+    int64_t used = used_ms_locked(now_us);
+    uint32_t day = s_day;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (started) {
+        int64_t remaining_ms = BUDGET_MS - used;
+        ESP_LOGI(TAG, "Playback started, %lld s of today's budget left", (long long)(remaining_ms / 1000));
+        esp_timer_stop(s_limit_timer);
+        esp_timer_start_once(s_limit_timer, remaining_ms > 0 ? (uint64_t)remaining_ms * 1000 : 1);
+        xTimerStart(s_checkpoint_timer, 0);
+    } else if (stopped) {
+        esp_timer_stop(s_limit_timer);
+        xTimerStop(s_checkpoint_timer, 0);
+        persist(day, used);
+        ESP_LOGI(TAG, "Playback stopped, %lld s played today", (long long)(used / 1000));
+    }
+}
+
+esp_err_t parental_control_check_play(void)
+{
+    if (BUDGET_MS == 0) {
+        return ESP_OK;
+    }
+
+    uint32_t today = current_day();
+    int64_t now_us = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+
+    portENTER_CRITICAL(&s_lock);
+    roll_day_locked(today, now_us);
+    if (s_limit_reached || used_ms_locked(now_us) >= BUDGET_MS) {
+        s_blocked++;
+        err = ESP_ERR_PARENTAL_LIMIT_REACHED;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+void parental_control_get_status(parental_control_status_t *status)
+{
+    if (status == NULL) {
+        return;
+    }
+
+    uint32_t today = current_day();
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    roll_day_locked(today, now_us);
+    status->budget_s = (uint32_t)(BUDGET_MS / 1000);
+    status->used_s = (uint32_t)(used_ms_locked(now_us) / 1000);
+    status->day = s_day;
+    status->playing = s_session_start_us != 0;
+    status->limit_reached = s_limit_reached;
+    status->blocked = s_blocked;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t parental_control_init(void)
+{
+    if (s_limit_timer != NULL) {
+        return ESP_OK;
+    }
+    if (BUDGET_MS == 0) {
+        ESP_LOGI(TAG, "No daily playtime limit configured");
+        return ESP_OK;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = limit_timer_callback,
+        .name = "parental_limit",
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_limit_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_checkpoint_timer = xTimerCreate("parental_ckpt", pdMS_TO_TICKS(PARENTAL_CHECKPOINT_MS), pdTRUE, NULL,
+                                      checkpoint_timer_callback);
+    if (s_checkpoint_timer == NULL) {
+        esp_timer_delete(s_limit_timer);
+        s_limit_timer = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    playtime_record_t record;
+    size_t size = sizeof(record);
+    if (log_store_get(STORE_KEY, &record, &size) == ESP_OK && size == sizeof(record)) {
+        s_day = record.day;
+        s_used_ms = (int64_t)record.used_s * 1000;
+        s_limit_reached = s_used_ms >= BUDGET_MS;
+    }
+
+    ESP_LOGI(TAG, "Daily limit %d min, %lu s used on %lu",
+             CONFIG_PARENTAL_DAILY_LIMIT_MIN, (unsigned long)(s_used_ms / 1000), (unsigned long)s_day);
+    return ESP_OK;
+}
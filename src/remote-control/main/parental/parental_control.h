@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @file parental_control.h
+ * @brief Daily playtime budget, accounted on the device
+ *
+ * Playtime is measured between the play and pause transitions the controller
+ * reports, using the monotonic esp_timer clock. Starting playback arms a
+ * one-shot timer for the remaining budget. When it fires,
+ * APP_EVENT_PARENTAL_LIMIT_REACHED is posted and further play commands are
+ * refused until the next day; the controller keeps pausing the player until
+ * it reports paused.
+ *
+ * Today's usage is kept in the log store: on every pause and, while music
+ * plays, every PARENTAL_CHECKPOINT_MS, so rebooting or pulling the power
+ * mid-session does not reset the budget. Days are told apart by the local wall clock (see time_sync.h); until
+ * the clock is set, usage keeps counting towards the last known day.
+ *
+ * The budget is CONFIG_PARENTAL_DAILY_LIMIT_MIN; 0 disables the limit.
+ * All functions are safe to call from any task.
+ */
+
+#define ESP_ERR_PARENTAL_BASE           0xA100
+/** Play refused: today's budget is used up */
+#define ESP_ERR_PARENTAL_LIMIT_REACHED  (ESP_ERR_PARENTAL_BASE + 1)
+
+typedef struct {
+    uint32_t budget_s;          /* 0 = no limit */
+    uint32_t used_s;            /* Today, including a running session */
+    uint32_t day;               /* Local date as YYYYMMDD, 0 until the clock was set */
+    bool playing;
+    bool limit_reached;
+    uint32_t blocked;           /* Play commands refused since boot */
+} parental_control_status_t;
+
+/**
+ * @brief Restore today's usage and create the budget timer
+ *
+ * Requires log_store_init().
+ */
+esp_err_t parental_control_init(void);
+
+/**
+ * @brief Report a confirmed playback transition
+ *
+ * Called by the controller once a play or pause command went through, or
+ * after the player state was read from Home Assistant.
+ */
+void parental_control_on_playback(bool playing);
+
+/**
+ * @brief Ask whether playback may start now
+ *
+ * @return ESP_OK, or ESP_ERR_PARENTAL_LIMIT_REACHED (counted as blocked)
+ */
+esp_err_t parental_control_check_play(void);
+
+/**
+ * @brief Copy the current budget and usage
+ */
+void parental_control_get_status(parental_control_status_t *status);
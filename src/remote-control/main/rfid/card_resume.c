@@ -0,0 +1,79 @@
+#include "card_resume.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "storage/log_store.h"
+
+static const char *TAG = "CARD_RESUME";
+
+#define KEY_PREFIX "r"
+
+static card_resume_metrics_t s_metrics;
+static portMUX_TYPE s_metrics_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* "r" followed by the UID in hex: at most 21 characters */
+static void uid_to_key(const rc522_picc_uid_t *uid, char key[LOG_STORE_KEY_MAX])
+{
+    _Static_assert(sizeof(KEY_PREFIX) - 1 + RC522_PICC_UID_SIZE_MAX * 2 < LOG_STORE_KEY_MAX,
+                   "card key must fit into a log store key");
+
+    int len = snprintf(key, LOG_STORE_KEY_MAX, KEY_PREFIX);
+    for (int i = 0; i < uid->length && i < RC522_PICC_UID_SIZE_MAX; i++) {
+        len += snprintf(&key[len], LOG_STORE_KEY_MAX - len, "%02X", uid->value[i]);
+    }
+}
+
+bool card_resume_get(const rc522_picc_uid_t *uid, float *position)
+{
+    if (uid == NULL || position == NULL) {
+        return false;
+    }
+
+    char key[LOG_STORE_KEY_MAX];
+    float stored = 0.0f;
+    size_t size = sizeof(stored);
+    uid_to_key(uid, key);
+    bool found = log_store_get(key, &stored, &size) == ESP_OK && size == sizeof(stored);
+
+    portENTER_CRITICAL(&s_metrics_lock);
+    s_metrics.lookups++;
+    s_metrics.hits += found;
+    portEXIT_CRITICAL(&s_metrics_lock);
+
+    if (found) {
+        *position = stored;
+    }
+    return found;
+}
+
+void card_resume_put(const rc522_picc_uid_t *uid, float position)
+{
+    if (uid == NULL) {
+        return;
+    }
+
+    char key[LOG_STORE_KEY_MAX];
+    uid_to_key(uid, key);
+    esp_err_t err = log_store_set(key, &position, sizeof(position));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save resume position: %s", esp_err_to_name(err));
+        return;
+    }
+
+    portENTER_CRITICAL(&s_metrics_lock);
+    s_metrics.updates++;
+    portEXIT_CRITICAL(&s_metrics_lock);
+}
+
+void card_resume_get_metrics(card_resume_metrics_t *metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_metrics_lock);
+    *metrics = s_metrics;
+    portEXIT_CRITICAL(&s_metrics_lock);
+}
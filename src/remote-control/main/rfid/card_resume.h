@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "rc522_types.h"
+
+/**
+ * @file card_resume.h
+ * @brief Per-card playback resume positions
+ *
+ * Positions are kept in the log store (see storage/log_store.h) under a key
+ * derived from the card UID. Reads are served from RAM, and updates reach
+ * flash with the store's next batch, so a tap-remove-tap sequence costs no
+ * flash write of its own.
+ *
+ * Requires log_store_init(). All functions are safe to call from any task.
+ */
+
+typedef struct {
+    uint32_t lookups;
+    uint32_t hits;              /* Lookups that found a position */
+    uint32_t updates;           /* Positions saved */
+} card_resume_metrics_t;
+
+/**
+ * @brief Look up the saved position of a card
+ *
+ * @return true and *position if a position is known
+ */
+bool card_resume_get(const rc522_picc_uid_t *uid, float *position);
+
+/**
+ * @brief Remember the position of a card; reaches flash with the next log store batch
+ */
+void card_resume_put(const rc522_picc_uid_t *uid, float position);
+
+/**
+ * @brief Copy the lookup and update counters
+ */
+void card_resume_get_metrics(card_resume_metrics_t *metrics);
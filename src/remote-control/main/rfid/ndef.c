@@ -0,0 +1,131 @@
+#include "ndef.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#define TLV_NULL        0x00
+#define TLV_NDEF        0x03
+#define TLV_TERMINATOR  0xFE
+
+#define RECORD_MB       0x80
+#define RECORD_ME       0x40
+#define RECORD_CF       0x20
+#define RECORD_SR       0x10
+#define RECORD_IL       0x08
+#define RECORD_TNF_MASK 0x07
+#define TNF_WELL_KNOWN  0x01
+
+/* NFC Forum URI RTD identifier codes; only the ones seen on media cards */
+#define URI_PREFIX_COUNT (sizeof(URI_PREFIXES) / sizeof(URI_PREFIXES[0]))
+static const char *const URI_PREFIXES[] = {
+    "",
+    "http://www.",
+    "https://www.",
+    "http://",
+    "https://",
+};
+
+/* Walk the records of one NDEF message */
+static esp_err_t find_uri_record(const uint8_t *msg, size_t len, char *uri, size_t uri_size)
+{
+    size_t pos = 0;
+
+    while (pos < len) {
+        uint8_t header = msg[pos++];
+        bool short_record = header & RECORD_SR;
+        bool has_id = header & RECORD_IL;
+
+        if (pos + 1 + (short_record ? 1 : 4) + (has_id ? 1 : 0) > len) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        uint8_t type_len = msg[pos++];
+        uint32_t payload_len;
+        if (short_record) {
+            payload_len = msg[pos++];
+        } else {
+            payload_len = ((uint32_t)msg[pos] << 24) | ((uint32_t)msg[pos + 1] << 16) |
+                          ((uint32_t)msg[pos + 2] << 8) | msg[pos + 3];
+            pos += 4;
+        }
+        uint8_t id_len = has_id ? msg[pos++] : 0;
+
+        /* One term at a time: a 32-bit payload length must not wrap the sum */
+        size_t remaining = len - pos;
+        if (type_len > remaining || id_len > remaining - type_len ||
+            payload_len > remaining - type_len - id_len) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        const uint8_t *type = &msg[pos];
+        const uint8_t *payload = &msg[pos + type_len + id_len];
+        pos += type_len + id_len + payload_len;
+
+        if ((header & RECORD_TNF_MASK) == TNF_WELL_KNOWN && !(header & RECORD_CF) &&
+            type_len == 1 && type[0] == 'U' && payload_len >= 1) {
+            uint8_t code = payload[0];
+            if (code >= URI_PREFIX_COUNT) {
+                /* e.g. tel: or mailto:, never a media ID */
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            const char *prefix = URI_PREFIXES[code];
+            size_t prefix_len = strlen(prefix);
+            size_t rest_len = payload_len - 1;
+
+            /* Not part of any URI; a NUL would also cut the media ID short */
+            for (size_t i = 1; i < payload_len; i++) {
+                if (payload[i] < 0x20 || payload[i] == 0x7F) {
+                    return ESP_ERR_INVALID_RESPONSE;
+                }
+            }
+
+            if (prefix_len + rest_len + 1 > uri_size) {
+                return ESP_ERR_NO_MEM;
+            }
+            memcpy(uri, prefix, prefix_len);
+            memcpy(uri + prefix_len, payload + 1, rest_len);
+            uri[prefix_len + rest_len] = '\0';
+            return ESP_OK;
+        }
+
+        if (header & RECORD_ME) {
+            break;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t ndef_find_uri(const uint8_t *tlv, size_t len, char *uri, size_t uri_size)
+{
+    size_t pos = 0;
+
+    while (pos < len) {
+        uint8_t tag = tlv[pos++];
+        if (tag == TLV_NULL) {
+            continue;
+        }
+        if (tag == TLV_TERMINATOR) {
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        /* Length: one byte, or 0xFF followed by two bytes */
+        if (pos >= len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        size_t value_len = tlv[pos++];
+        if (value_len == 0xFF) {
+            if (pos + 2 > len) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            value_len = ((size_t)tlv[pos] << 8) | tlv[pos + 1];
+            pos += 2;
+        }
+        if (pos + value_len > len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        if (tag == TLV_NDEF) {
+            return find_uri_record(&tlv[pos], value_len, uri, uri_size);
+        }
+        pos += value_len;   /* Lock/memory control and proprietary TLVs */
+    }
+    return ESP_ERR_INVALID_SIZE;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @file ndef.h
+ * @brief Minimal NDEF parser for URI records on NFC Forum Type 2 tags
+ *
+ * Only what is needed to use a URI stored on an NTAG21x card as a media ID:
+ * the TLV area is walked to the first NDEF message TLV and the first
+ * well-known URI record ("U") in it is decoded, including the URI
+ * identifier code abbreviations (e.g. 0x04 = "https://").
+ */
+
+/** Capability container magic in byte 0 of page 3 */
+#define NDEF_CC_MAGIC 0xE1
+
+/**
+ * @brief Find and decode the first URI record
+ *
+ * @param tlv      TLV area of the tag (user memory, starting at page 4)
+ * @param len      Bytes available in tlv
+ * @param uri      Output, NUL-terminated
+ * @param uri_size Size of uri
+ * @return ESP_OK if a URI was decoded,
+ *         ESP_ERR_INVALID_SIZE if the NDEF message extends beyond len (read more and retry),
+ *         ESP_ERR_NOT_FOUND if the tag holds no URI record,
+ *         ESP_ERR_NO_MEM if the URI does not fit into uri,
+ *         ESP_ERR_NOT_SUPPORTED for an identifier code other than 0x00-0x04,
+ *         ESP_ERR_INVALID_RESPONSE if the data is malformed or the URI
+ *         contains control characters
+ */
+esp_err_t ndef_find_uri(const uint8_t *tlv, size_t len, char *uri, size_t uri_size);
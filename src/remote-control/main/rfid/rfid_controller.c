@@ -0,0 +1,304 @@
+#include "rfid_controller.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "rc522_picc.h"
+#include "media_mapping.h"
+#include "card_resume.h"
+#include "common/config.h"
+#include "input/buttons.h"
+#include "music_assistant/music_assistant_controller.h"
+#include "soft_power/standby.h"
+#include "wifi/wifi_power_save.h"
+
+static const char *TAG = "RFID_CONTROLLER";
+
+static display_t *s_display = NULL;
+
+#define RESCAN_WINDOW_US ((int64_t)CONFIG_RFID_RESCAN_WINDOW_MS * 1000)
+
+/*
+ * Card whose media was loaded last and the card currently on the reader
+ * (kept here because the removal event may not carry the UID). Written from
+ * the RC522 event task; the removal timer reads them under s_lock. Kept in
+ * RTC memory across standby.
+ */
+static RTC_DATA_ATTR rc522_picc_uid_t s_loaded_uid;
+static RTC_DATA_ATTR char s_loaded_media_id[RFID_NDEF_URI_MAX];
+static RTC_DATA_ATTR bool s_media_loaded = false;
+static RTC_DATA_ATTR rc522_picc_uid_t s_present_uid;
+static RTC_DATA_ATTR bool s_card_present = false;
+
+/* Woke from standby with s_present_uid on the reader; cleared by the first card seen */
+static bool s_card_from_standby = false;
+
+/*
+ * A removal is only acted on once the card stayed away for the re-scan
+ * window, so jiggling a card on the reader sends nothing at all.
+ */
+static esp_timer_handle_t s_removal_timer = NULL;
+static bool s_removal_pending = false;
+static int64_t s_removed_at_us = INT64_MIN / 2;
+
+static rfid_controller_metrics_t s_metrics;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool uid_equal(const rc522_picc_uid_t *a, const rc522_picc_uid_t *b)
+{
+    return a->length == b->length && memcmp(a->value, b->value, a->length) == 0;
+}
+
+#if CONFIG_RFID_RESUME_ON_RETAP
+/* Runs in the controller's transport worker once the pause was sent */
+static void on_pause_snapshot(float position, const void *context)
+{
+    rc522_picc_uid_t uid;
+    memcpy(&uid, context, sizeof(uid));
+    card_resume_put(&uid, position);
+    ESP_LOGI(TAG, "Saved position %.1fs for removed card", position);
+}
+#endif
+
+static void pause_removed_card(const rc522_picc_uid_t *uid)
+{
+#if CONFIG_RFID_RESUME_ON_RETAP
+    esp_err_t err = music_assistant_controller_pause_and_snapshot(on_pause_snapshot, uid, sizeof(*uid));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to queue pause on removal: %s", esp_err_to_name(err));
+    }
+#endif
+}
+
+/* Claim a removal that has not been acted on yet; false if there is none */
+static bool take_pending_removal(rc522_picc_uid_t *uid)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool pending = s_removal_pending;
+    s_removal_pending = false;
+    *uid = s_loaded_uid;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (pending) {
+        esp_timer_stop(s_removal_timer);
+    }
+    return pending;
+}
+
+static void removal_timer_callback(void *arg)
+{
+    (void)arg;
+    rc522_picc_uid_t uid;
+    if (take_pending_removal(&uid)) {
+        pause_removed_card(&uid);
+    }
+}
+
+/* Mapping table first (no SPI traffic), then a URI stored on the card itself */
+static const char *resolve_media_id(rc522_picc_t *picc, char *buffer, size_t size)
+{
+    int64_t start_us = esp_timer_get_time();
+    const char *media_id = media_mapping_get_media_id(&picc->uid);
+    uint32_t lookup_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+    portENTER_CRITICAL(&s_lock);
+    s_metrics.mapping_lookup_us = lookup_us;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (media_id != NULL) {
+        return media_id;
+    }
+    if (rfid_scanner_read_uri(picc, buffer, size) == ESP_OK) {
+        portENTER_CRITICAL(&s_lock);
+        s_metrics.ndef_resolved++;
+        portEXIT_CRITICAL(&s_lock);
+        return buffer;
+    }
+    return NULL;
+}
+
+static void remember_loaded(const rc522_picc_uid_t *uid, const char *media_id)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_loaded_uid = *uid;
+    snprintf(s_loaded_media_id, sizeof(s_loaded_media_id), "%s", media_id);
+    s_media_loaded = true;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void on_card_placed(rc522_picc_t *picc)
+{
+    /* Before the card is resolved, so power save is off by the time its command goes out */
+    wifi_power_save_note_activity();
+
+    int64_t now_us = esp_timer_get_time();
+    /* The reader finds a card left on it within its first fast polls after waking */
+    bool left_in_standby = s_card_from_standby && uid_equal(&s_present_uid, &picc->uid) &&
+                           now_us < (int64_t)STANDBY_CARD_RECHECK_MS * 1000;
+    s_card_from_standby = false;
+    s_present_uid = picc->uid;
+    s_card_present = true;
+
+    portENTER_CRITICAL(&s_lock);
+    s_metrics.scans++;
+    if (left_in_standby) {
+        s_metrics.suppressed++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (left_in_standby) {
+        /* Its media is still loaded; the wake press resumes it */
+        ESP_LOGI(TAG, "Card left on the reader during standby, scan suppressed");
+        return;
+    }
+
+    char uri[RFID_NDEF_URI_MAX];
+    const char *media_id = resolve_media_id(picc, uri, sizeof(uri));
+    if (!media_id) {
+        ESP_LOGW(TAG, "No media mapping or NDEF URI found for this card, skipping playback request");
+        return;
+    }
+
+    rc522_picc_uid_t removed_uid;
+    bool removal_pending = take_pending_removal(&removed_uid);
+    bool same_item = s_media_loaded && uid_equal(&s_loaded_uid, &picc->uid) &&
+                     strcmp(s_loaded_media_id, media_id) == 0;
+
+    /* Back within the window and still playing (or never paused): nothing changed */
+    if (same_item && now_us - s_removed_at_us < RESCAN_WINDOW_US &&
+        (removal_pending ||
+         music_assistant_controller_get_player_state() == MUSIC_ASSISTANT_PLAYER_STATE_PLAYING)) {
+        portENTER_CRITICAL(&s_lock);
+        s_metrics.suppressed++;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGI(TAG, "Same card back within %d ms, scan suppressed", CONFIG_RFID_RESCAN_WINDOW_MS);
+        return;
+    }
+
+    if (removal_pending) {
+        /* A different card (or a late return): the previous removal still counts */
+        pause_removed_card(&removed_uid);
+    }
+
+#if CONFIG_RFID_RESUME_ON_RETAP
+    float position = 0.0f;
+    if (card_resume_get(&picc->uid, &position) && position > 0.0f) {
+        if (same_item) {
+            ESP_LOGI(TAG, "Same card back, resuming at %.1fs", position);
+            music_assistant_controller_resume(position);
+            return;
+        }
+        ESP_LOGI(TAG, "Loading media and resuming at %.1fs", position);
+        if (music_assistant_controller_play_media_at(media_id, position) == ESP_OK) {
+            remember_loaded(&picc->uid, media_id);
+        }
+        return;
+    }
+#endif
+
+    if (music_assistant_controller_play_media(media_id) == ESP_OK) {
+        remember_loaded(&picc->uid, media_id);
+    }
+}
+
+static void on_card_removed(void)
+{
+    if (!s_card_present) {
+        return;
+    }
+    s_card_present = false;
+    s_removed_at_us = esp_timer_get_time();
+
+#if CONFIG_RFID_RESUME_ON_RETAP
+    if (s_media_loaded && uid_equal(&s_loaded_uid, &s_present_uid)) {
+        portENTER_CRITICAL(&s_lock);
+        s_removal_pending = true;
+        portEXIT_CRITICAL(&s_lock);
+        esp_timer_stop(s_removal_timer);
+        esp_timer_start_once(s_removal_timer, RESCAN_WINDOW_US > 0 ? (uint64_t)RESCAN_WINDOW_US : 1);
+    }
+#endif
+}
+
+/* Someone is at the panel: a card is likely to follow */
+static void on_button_pressed(void *arg, esp_event_base_t base, int32_t event_id, void *data)
+{
+    rfid_scanner_boost();
+}
+
+static void on_rfid_tag_scanned(void *arg, esp_event_base_t base, int32_t event_id, void *data)
+{
+    rc522_picc_state_changed_event_t *event = (rc522_picc_state_changed_event_t *)data;
+    rc522_picc_t *picc = event->picc;
+
+    if (picc->state == RC522_PICC_STATE_ACTIVE) {
+        rc522_picc_print(picc);
+        const char *type_name = rc522_picc_type_name(picc->type);
+        char uid_str[RC522_PICC_UID_STR_BUFFER_SIZE_MAX] = {0};
+        if (rc522_picc_uid_to_str(&picc->uid, uid_str, sizeof(uid_str)) != ESP_OK) {
+            snprintf(uid_str, sizeof(uid_str), "UID-error");
+        }
+        display_show(s_display, type_name ? type_name : "Unknown", uid_str);
+        on_card_placed(picc);
+    }
+    else if (picc->state == RC522_PICC_STATE_IDLE && event->old_state >= RC522_PICC_STATE_ACTIVE) {
+        ESP_LOGI(TAG, "Card has been removed");
+        display_show(s_display, DISPLAY_MSG_WAITING);
+        on_card_removed();
+    }
+}
+
+esp_err_t rfid_controller_init(display_t *display, rfid_scanner_t *scanner)
+{
+    if (!display || !scanner) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    _Static_assert(sizeof(rc522_picc_uid_t) <= MUSIC_ASSISTANT_SNAPSHOT_CONTEXT_MAX,
+                   "card UID must fit into a snapshot context");
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = removal_timer_callback,
+        .name = "rfid_removal",
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_removal_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    const buttons_event_id_t buttons[] = {
+        BUTTON_EVENT_ID_PREVIOUS_TRACK_PRESSED,
+        BUTTON_EVENT_ID_PLAY_PAUSE_PRESSED,
+        BUTTON_EVENT_ID_NEXT_TRACK_PRESSED,
+    };
+    for (size_t i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++) {
+        err = buttons_subscribe(buttons[i], on_button_pressed, NULL);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    if (standby_get_wake_source() != STANDBY_WAKE_NONE && s_card_present) {
+        /* Present until the reader says otherwise: it starts from "no card" */
+        s_card_from_standby = true;
+        s_card_present = false;
+    }
+
+    s_display = display;
+    rfid_scanner_start(scanner, on_rfid_tag_scanned);
+    return ESP_OK;
+}
+
+void rfid_controller_get_metrics(rfid_controller_metrics_t *metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *metrics = s_metrics;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "esp_err.h"
+#include "display/display.h"
+#include "rfid_scanner.h"
+
+/**
+ * @file rfid_controller.h
+ * @brief Turns card placements and removals into playback commands
+ *
+ * Placing a card starts its media: the media ID comes from media_mapping, or,
+ * for cards not in the table, from an NDEF URI record on the card itself
+ * (CONFIG_RFID_NDEF_URI). With CONFIG_RFID_RESUME_ON_RETAP,
+ * removing the card pauses playback and remembers the position for that card
+ * (see card_resume.h). Putting the same card back while its media is still
+ * loaded continues with a single seek + play; any other remembered card is
+ * loaded and then seeked to its saved position.
+ *
+ * Scans are debounced with CONFIG_RFID_RESCAN_WINDOW_MS: a removal is only
+ * acted on once the card stayed away that long, and a card that comes back
+ * within the window while its media is still playing sends nothing. So a card
+ * jiggled on the reader costs no network round trip.
+ */
+
+typedef struct {
+    uint32_t scans;         /* Cards placed */
+    uint32_t suppressed;    /* Scans that matched the playing item within the window */
+    uint32_t ndef_resolved; /* Unmapped cards played from the URI stored on them */
+    uint32_t mapping_lookup_us; /* Last media_mapping lookup, to compare with the NDEF read cost */
+} rfid_controller_metrics_t;
+
+/**
+ * @brief Start the scanner and handle its card events
+ *
+ * Button presses switch the scanner to fast polling (rfid_scanner_boost()).
+ *
+ * Requires buttons_init(), music_assistant_controller_init() and log_store_init().
+ *
+ * @param display Display used to show the scanned card
+ * @param scanner Initialized scanner handle
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL handles
+ */
+esp_err_t rfid_controller_init(display_t *display, rfid_scanner_t *scanner);
+
+/**
+ * @brief Copy the scan counters (e.g. to tune CONFIG_RFID_RESCAN_WINDOW_MS)
+ */
+void rfid_controller_get_metrics(rfid_controller_metrics_t *metrics);
@@ -1,10 +1,162 @@
 #include "rfid_scanner.h"
+#include <stdio.h>
+#include <string.h>
 #include "board_pins.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
 #include "driver/rc522_spi.h"
+#include "rc522_picc.h"
+#include "picc/rc522_mifare.h"
+#include "common/config.h"
+#include "ndef.h"
 
 static const char *TAG = "RFID_SCANNER";
 
+/* Long enough for the driver to finish at least one full poll cycle */
+#define BURST_US ((int64_t)CONFIG_RFID_POLL_FAST_MS * 2 * 1000)
+
+/*
+ * Adaptive polling. The driver polls every CONFIG_RFID_POLL_FAST_MS while it
+ * runs. After boot, a card removal or rfid_scanner_boost() it runs
+ * continuously for CONFIG_RFID_POLL_BOOST_MS; afterwards it is paused and only
+ * woken for a short burst every CONFIG_RFID_POLL_IDLE_MS. All rc522_start() /
+ * rc522_pause() calls happen in the poll timer callback, so they never race.
+ */
+static rc522_handle_t s_scanner = NULL;
+static esp_timer_handle_t s_poll_timer = NULL;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_running = false;
+static bool s_card_present = false;
+static int64_t s_boost_until_us = 0;
+static int64_t s_running_since_us = 0;
+static int64_t s_last_empty_us = 0;     /* End of the last burst that found no card */
+static int64_t s_active_us = 0;
+static int64_t s_started_us = 0;
+static int64_t s_poll_due_us = 0;      /* When the poll timer should fire next */
+static rfid_scanner_metrics_t s_metrics;
+
+#if CONFIG_RFID_NDEF_URI
+/* First page of the capability container; reads return four pages */
+#define NDEF_CC_PAGE 3
+
+/* Decoded URIs per card (or the absence of one), so repeat taps need no page reads */
+typedef struct {
+    bool used;
+    bool has_uri;
+    rc522_picc_uid_t uid;
+    uint32_t last_use;
+    char uri[RFID_NDEF_URI_MAX];
+} ndef_cache_entry_t;
+
+static ndef_cache_entry_t s_ndef_cache[RFID_NDEF_CACHE_SIZE];
+static uint32_t s_ndef_use_counter = 0;
+#endif
+
+static void arm_poll_timer(int64_t delay_us)
+{
+    if (delay_us <= 0) {
+        delay_us = 1;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_poll_due_us = esp_timer_get_time() + delay_us;
+    portEXIT_CRITICAL(&s_lock);
+    esp_timer_stop(s_poll_timer);
+    esp_timer_start_once(s_poll_timer, (uint64_t)delay_us);
+}
+
+static void poll_timer_callback(void *arg)
+{
+    (void)arg;
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    /* How much later than scheduled the timer ran, e.g. by leaving light sleep */
+    uint32_t late_us = now_us > s_poll_due_us ? (uint32_t)(now_us - s_poll_due_us) : 0;
+    s_metrics.last_wake_late_us = late_us;
+    if (late_us > s_metrics.max_wake_late_us) {
+        s_metrics.max_wake_late_us = late_us;
+    }
+    bool boosting = now_us < s_boost_until_us;
+    int64_t boost_left_us = s_boost_until_us - now_us;
+    bool running = s_running;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (boosting) {
+        if (!running && rc522_start(s_scanner) == ESP_OK) {
+            portENTER_CRITICAL(&s_lock);
+            s_running = true;
+            s_running_since_us = now_us;
+            portEXIT_CRITICAL(&s_lock);
+        }
+        arm_poll_timer(boost_left_us);
+    } else if (running) {
+        /* Fast phase or burst over: sleep until the next burst */
+        rc522_pause(s_scanner);
+        portENTER_CRITICAL(&s_lock);
+        s_running = false;
+        s_active_us += now_us - s_running_since_us;
+        if (!s_card_present) {
+            s_last_empty_us = now_us;
+        }
+        portEXIT_CRITICAL(&s_lock);
+        arm_poll_timer((int64_t)CONFIG_RFID_POLL_IDLE_MS * 1000);
+    } else {
+        if (rc522_start(s_scanner) == ESP_OK) {
+            portENTER_CRITICAL(&s_lock);
+            s_running = true;
+            s_running_since_us = now_us;
+            s_metrics.bursts++;
+            portEXIT_CRITICAL(&s_lock);
+        }
+        arm_poll_timer(BURST_US);
+    }
+}
+
+void rfid_scanner_boost(void)
+{
+    if (s_poll_timer == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_boost_until_us = esp_timer_get_time() + (int64_t)CONFIG_RFID_POLL_BOOST_MS * 1000;
+    s_metrics.boosts++;
+    portEXIT_CRITICAL(&s_lock);
+
+    /* Let the timer callback switch modes right away */
+    arm_poll_timer(0);
+}
+
+/* Registered ahead of the application handler to follow card presence */
+static void scanner_event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *data)
+{
+    rc522_picc_state_changed_event_t *event = (rc522_picc_state_changed_event_t *)data;
+    rc522_picc_t *picc = event->picc;
+    int64_t now_us = esp_timer_get_time();
+
+    if (picc->state == RC522_PICC_STATE_ACTIVE) {
+        portENTER_CRITICAL(&s_lock);
+        s_card_present = true;
+        /* Upper bound: the card may have arrived any time since the last empty poll */
+        int64_t latency_us = now_us < s_boost_until_us ? (int64_t)CONFIG_RFID_POLL_FAST_MS * 1000
+                                                       : now_us - s_last_empty_us;
+        s_metrics.detections++;
+        s_metrics.last_detect_latency_ms = (uint32_t)(latency_us / 1000);
+        if (s_metrics.last_detect_latency_ms > s_metrics.max_detect_latency_ms) {
+            s_metrics.max_detect_latency_ms = s_metrics.last_detect_latency_ms;
+        }
+        portEXIT_CRITICAL(&s_lock);
+    } else if (picc->state == RC522_PICC_STATE_IDLE && event->old_state >= RC522_PICC_STATE_ACTIVE) {
+        portENTER_CRITICAL(&s_lock);
+        s_card_present = false;
+        portEXIT_CRITICAL(&s_lock);
+        /* A new card usually follows a removal */
+        rfid_scanner_boost();
+    }
+}
+
 esp_err_t rfid_scanner_init(rfid_scanner_t *scanner)
 {
     if (!scanner) {
@@ -39,6 +191,7 @@ esp_err_t rfid_scanner_init(rfid_scanner_t *scanner)
 
     rc522_config_t scanner_config = {
         .driver = scanner->driver,
+        .poll_interval_ms = CONFIG_RFID_POLL_FAST_MS,
     };
 
     ret = rc522_create(&scanner_config, &scanner->scanner);
@@ -47,6 +200,17 @@ esp_err_t rfid_scanner_init(rfid_scanner_t *scanner)
         return ret;
     }
 
+    const esp_timer_create_args_t timer_args = {
+        .callback = poll_timer_callback,
+        .name = "rfid_poll",
+    };
+    ret = esp_timer_create(&timer_args, &s_poll_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Poll timer creation failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    s_scanner = scanner->scanner;
+
     ESP_LOGI(TAG, "RFID Scanner initialized successfully");
     return ESP_OK;
 }
@@ -63,8 +227,159 @@ void rfid_scanner_start(rfid_scanner_t *scanner, void (*event_handler)(void *, c
         return;
     }
 
+    rc522_register_events(scanner->scanner, RC522_EVENT_PICC_STATE_CHANGED,
+                         scanner_event_handler, NULL);
     rc522_register_events(scanner->scanner, RC522_EVENT_PICC_STATE_CHANGED,
                          event_handler, NULL);
-    rc522_start(scanner->scanner);
-    ESP_LOGI(TAG, "RFID Scanner started");
+
+    s_started_us = esp_timer_get_time();
+    s_last_empty_us = s_started_us;
+    rfid_scanner_boost();
+    ESP_LOGI(TAG, "RFID Scanner started (fast %d ms for %d ms, then a burst every %d ms)",
+             CONFIG_RFID_POLL_FAST_MS, CONFIG_RFID_POLL_BOOST_MS, CONFIG_RFID_POLL_IDLE_MS);
+}
+
+#if CONFIG_RFID_NDEF_URI
+static ndef_cache_entry_t *ndef_cache_find(const rc522_picc_uid_t *uid)
+{
+    for (int i = 0; i < RFID_NDEF_CACHE_SIZE; i++) {
+        ndef_cache_entry_t *entry = &s_ndef_cache[i];
+        if (entry->used && entry->uid.length == uid->length &&
+            memcmp(entry->uid.value, uid->value, uid->length) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void ndef_cache_store(const rc522_picc_uid_t *uid, const char *uri)
+{
+    ndef_cache_entry_t *victim = &s_ndef_cache[0];
+    for (int i = 0; i < RFID_NDEF_CACHE_SIZE; i++) {
+        if (!s_ndef_cache[i].used) {
+            victim = &s_ndef_cache[i];
+            break;
+        }
+        if (s_ndef_cache[i].last_use < victim->last_use) {
+            victim = &s_ndef_cache[i];
+        }
+    }
+    victim->used = true;
+    victim->uid = *uid;
+    victim->last_use = ++s_ndef_use_counter;
+    victim->has_uri = uri != NULL;
+    snprintf(victim->uri, sizeof(victim->uri), "%s", uri ? uri : "");
+}
+
+/* Read the TLV area block by block until the NDEF message is complete */
+static esp_err_t ndef_read_uri(rc522_picc_t *picc, char *uri, size_t uri_size, uint32_t *blocks)
+{
+    uint8_t block[RC522_MIFARE_BLOCK_SIZE];
+    uint8_t tlv[RFID_NDEF_READ_MAX];
+    size_t len = 0;
+
+    esp_err_t err = rc522_mifare_read(s_scanner, picc, NDEF_CC_PAGE, block);
+    (*blocks)++;
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (block[0] != NDEF_CC_MAGIC) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    /* Pages 4..6 came with the capability container */
+    memcpy(tlv, &block[4], sizeof(block) - 4);
+    len = sizeof(block) - 4;
+
+    uint8_t page = NDEF_CC_PAGE + sizeof(block) / 4;
+    while ((err = ndef_find_uri(tlv, len, uri, uri_size)) == ESP_ERR_INVALID_SIZE &&
+           len + sizeof(block) <= sizeof(tlv)) {
+        esp_err_t read_err = rc522_mifare_read(s_scanner, picc, page, block);
+        (*blocks)++;
+        if (read_err != ESP_OK) {
+            return read_err;
+        }
+        memcpy(&tlv[len], block, sizeof(block));
+        len += sizeof(block);
+        page += sizeof(block) / 4;
+    }
+    /* A message longer than we are willing to read counts as no URI */
+    return err == ESP_ERR_INVALID_SIZE ? ESP_ERR_NOT_FOUND : err;
+}
+#endif
+
+esp_err_t rfid_scanner_read_uri(rc522_picc_t *picc, char *uri, size_t uri_size)
+{
+#if CONFIG_RFID_NDEF_URI
+    if (picc == NULL || uri == NULL || uri_size == 0 || s_scanner == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ndef_cache_entry_t *cached = ndef_cache_find(&picc->uid);
+    if (cached != NULL) {
+        cached->last_use = ++s_ndef_use_counter;
+        portENTER_CRITICAL(&s_lock);
+        s_metrics.ndef_cache_hits++;
+        portEXIT_CRITICAL(&s_lock);
+        if (!cached->has_uri) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        return snprintf(uri, uri_size, "%s", cached->uri) < (int)uri_size ? ESP_OK : ESP_ERR_NO_MEM;
+    }
+
+    if (picc->type != RC522_PICC_TYPE_MIFARE_UL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    uint32_t blocks = 0;
+    char decoded[RFID_NDEF_URI_MAX];
+    esp_err_t err = ndef_read_uri(picc, decoded, sizeof(decoded), &blocks);
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+    portENTER_CRITICAL(&s_lock);
+    s_metrics.ndef_reads++;
+    s_metrics.ndef_blocks += blocks;
+    s_metrics.ndef_last_read_us = elapsed_us;
+    if (elapsed_us > s_metrics.ndef_max_read_us) {
+        s_metrics.ndef_max_read_us = elapsed_us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    /* Cache definite answers only; a read error may just be a card pulled away too soon */
+    if (err == ESP_OK) {
+        ndef_cache_store(&picc->uid, decoded);
+        ESP_LOGI(TAG, "NDEF URI read in %lu us (%lu blocks): %s",
+                 (unsigned long)elapsed_us, (unsigned long)blocks, decoded);
+        return snprintf(uri, uri_size, "%s", decoded) < (int)uri_size ? ESP_OK : ESP_ERR_NO_MEM;
+    }
+    if (err == ESP_ERR_NOT_FOUND || err == ESP_ERR_NO_MEM || err == ESP_ERR_INVALID_RESPONSE ||
+        err == ESP_ERR_NOT_SUPPORTED) {
+        ndef_cache_store(&picc->uid, NULL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_LOGW(TAG, "NDEF read failed: %s", esp_err_to_name(err));
+    return err;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void rfid_scanner_get_metrics(rfid_scanner_metrics_t *metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    *metrics = s_metrics;
+    int64_t active_us = s_active_us + (s_running ? now_us - s_running_since_us : 0);
+    portEXIT_CRITICAL(&s_lock);
+
+    /* The driver polls once per interval while running */
+    metrics->active_ms = (uint32_t)(active_us / 1000);
+    metrics->polls = (uint32_t)(active_us / ((int64_t)CONFIG_RFID_POLL_FAST_MS * 1000));
+    int64_t elapsed_us = now_us - s_started_us;
+    metrics->polls_per_second = elapsed_us > 0 ? metrics->polls * 1e6f / (float)elapsed_us : 0.0f;
 }
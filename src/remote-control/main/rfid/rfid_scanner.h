@@ -10,8 +10,32 @@
  * 
  * This module encapsulates all RC522 RFID reader operations.
  * Low-level SPI driver initialization is handled internally.
+ *
+ * Polling is adaptive: every CONFIG_RFID_POLL_FAST_MS for
+ * CONFIG_RFID_POLL_BOOST_MS after start, a card removal or
+ * rfid_scanner_boost(); otherwise the reader is paused and woken for a short
+ * burst every CONFIG_RFID_POLL_IDLE_MS. The poll timer also ends light
+ * sleep; how late it runs is in the metrics and adds to the detect latency.
  */
 
+typedef struct {
+    uint32_t polls;                 /* Poll cycles since start (estimated from time spent running) */
+    float polls_per_second;         /* Average since start */
+    uint32_t active_ms;             /* Time the reader was polling */
+    uint32_t bursts;                /* Idle-rate wake-ups */
+    uint32_t boosts;                /* Switches to fast polling */
+    uint32_t detections;
+    uint32_t last_detect_latency_ms; /* Upper bound: time since the reader last saw no card */
+    uint32_t max_detect_latency_ms;
+    uint32_t last_wake_late_us;     /* Poll timer delay past its due time (light-sleep exit) */
+    uint32_t max_wake_late_us;
+    uint32_t ndef_reads;            /* Cards whose NDEF area was read */
+    uint32_t ndef_blocks;           /* 16-byte (4-page) reads issued for that */
+    uint32_t ndef_cache_hits;       /* Repeat taps answered from RAM */
+    uint32_t ndef_last_read_us;
+    uint32_t ndef_max_read_us;
+} rfid_scanner_metrics_t;
+
 typedef struct {
     rc522_driver_handle_t driver;
     rc522_handle_t scanner;
@@ -28,11 +52,44 @@ esp_err_t rfid_scanner_init(rfid_scanner_t *scanner);
 /**
  * Start scanning for RFID cards
  * 
- * Registers event callbacks and begins card detection.
+ * Registers event callbacks and begins card detection at the fast rate.
  * 
  * @param scanner Pointer to initialized rfid_scanner_t structure
  * @param event_handler Callback function to handle RFID events
  */
 void rfid_scanner_start(rfid_scanner_t *scanner, void (*event_handler)(void *, const char *, int32_t, void *));
 
+/**
+ * Poll at the fast rate for the next CONFIG_RFID_POLL_BOOST_MS
+ *
+ * Call when a card is likely to be placed soon (e.g. a button was pressed).
+ * Safe to call from any task; never blocks.
+ */
+void rfid_scanner_boost(void);
+
+/**
+ * Read the URI stored in the card's NDEF message
+ *
+ * Works with NFC Forum Type 2 tags (NTAG21x, reported as MIFARE Ultralight).
+ * Must be called from the card event handler while the card is selected.
+ * Results (including "no URI") are cached per UID in RAM, so repeat taps skip
+ * the page reads. Requires CONFIG_RFID_NDEF_URI.
+ *
+ * @param picc     Card from the state change event
+ * @param uri      Output, NUL-terminated
+ * @param uri_size Size of uri
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if the card holds no usable URI (none,
+ *         too long, an unsupported scheme code or control characters),
+ *         ESP_ERR_NOT_SUPPORTED for other card types or when disabled,
+ *         or the driver error of a failed read
+ */
+esp_err_t rfid_scanner_read_uri(rc522_picc_t *picc, char *uri, size_t uri_size);
+
+/**
+ * Copy the polling and detection counters
+ *
+ * @param metrics Output
+ */
+void rfid_scanner_get_metrics(rfid_scanner_metrics_t *metrics);
+
 #endif /* RFID_SCANNER_H */
@@ -0,0 +1,30 @@
+#include "power_management.h"
+
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "POWER_MGMT";
+
+esp_err_t power_management_init(void)
+{
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_POWER_MIN_CPU_FREQ_MHZ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE && CONFIG_POWER_LIGHT_SLEEP
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure power management: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "CPU %d-%d MHz, light sleep %s", config.min_freq_mhz, config.max_freq_mhz,
+             config.light_sleep_enable ? "on" : "off");
+#else
+    ESP_LOGI(TAG, "Power management disabled in sdkconfig, CPU at a fixed frequency");
+#endif
+    return ESP_OK;
+}
@@ -0,0 +1,37 @@
+#ifndef POWER_MANAGEMENT_H
+#define POWER_MANAGEMENT_H
+
+#include "esp_err.h"
+
+/**
+ * @file power_management.h
+ * @brief Dynamic frequency scaling and automatic light sleep between activity
+ *
+ * With CONFIG_PM_ENABLE the CPU runs at CONFIG_POWER_MIN_CPU_FREQ_MHZ and,
+ * with CONFIG_POWER_LIGHT_SLEEP, the chip light-sleeps whenever FreeRTOS is
+ * idle (tickless idle) and no PM lock is held. The WiFi driver keeps the
+ * association by waking for DTIM beacons itself.
+ *
+ * Modules hold PM locks only around their bursts of work:
+ * - music_assistant_connection: ESP_PM_CPU_FREQ_MAX per pooled HTTP
+ *   transaction (acquire to release), so TLS and JSON run at full speed
+ * - potentiometer: ESP_PM_APB_FREQ_MAX around each ADC read
+ * - SPI to the RC522 and the SSD1306: the spi_master driver itself holds
+ *   ESP_PM_APB_FREQ_MAX while transactions are queued
+ *
+ * Everything else wakes the chip the way it already works: esp_timer and
+ * FreeRTOS timers (RFID polling, debounce, LED fade ends) end the light
+ * sleep on time, and the buttons are GPIO wake sources. The wake latencies
+ * are in buttons_get_metrics() and rfid_scanner_get_metrics().
+ */
+
+/**
+ * @brief Apply the frequency range and light-sleep setting from menuconfig
+ *
+ * Does nothing but log when the build has CONFIG_PM_ENABLE off.
+ *
+ * @return ESP_OK on success, ESP_ERR_* from esp_pm_configure() otherwise
+ */
+esp_err_t power_management_init(void);
+
+#endif /* POWER_MANAGEMENT_H */
@@ -0,0 +1,227 @@
+#include "standby.h"
+
+#include "driver/gpio.h"
+#include "driver/rtc_io.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "sdkconfig.h"
+#include "common/app_events.h"
+#include "common/board_pins.h"
+#include "storage/log_store.h"
+
+static const char *TAG = "STANDBY";
+
+#define STANDBY_TIMEOUT_US ((uint64_t)CONFIG_STANDBY_TIMEOUT_S * 1000000)
+
+/* Driven low and held through deep sleep: power latch on, panel and RC522 in reset, LEDs off */
+static const gpio_num_t s_held_pins[] = {
+    BOARD_SOFT_POWER_OFF,
+    BOARD_OLED_PIN_RST,
+    BOARD_RFID_PIN_RST,
+    BOARD_LED_NETWORK_GPIO,
+    BOARD_LED_PLAYBACK_GPIO,
+};
+
+#define HELD_PIN_COUNT (sizeof(s_held_pins) / sizeof(s_held_pins[0]))
+
+/* Kept across deep sleep; zeroed by a cold boot */
+static RTC_DATA_ATTR uint32_t s_rtc_wakeups;
+static RTC_DATA_ATTR uint32_t s_rtc_cold_network_ready_ms;
+static RTC_DATA_ATTR uint32_t s_rtc_cold_first_command_ms;
+
+static standby_wake_source_t s_wake_source = STANDBY_WAKE_NONE;
+static esp_timer_handle_t s_timer = NULL;
+static bool s_playing = false;
+static standby_metrics_t s_metrics;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t ms_since_start(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void arm_timer(void)
+{
+    if (s_timer != NULL) {
+        esp_timer_stop(s_timer);
+        esp_timer_start_once(s_timer, STANDBY_TIMEOUT_US);
+    }
+}
+
+static void hold_pins_low(void)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < HELD_PIN_COUNT; i++) {
+        mask |= 1ULL << s_held_pins[i];
+    }
+    /* Reconfiguring as plain outputs also detaches the LEDC signals */
+    gpio_config_t io_conf = {
+        .pin_bit_mask = mask,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    gpio_config(&io_conf);
+    for (size_t i = 0; i < HELD_PIN_COUNT; i++) {
+        gpio_set_level(s_held_pins[i], 0);
+        gpio_hold_en(s_held_pins[i]);
+    }
+    gpio_deep_sleep_hold_en();
+}
+
+static void enter_standby(void)
+{
+    ESP_LOGI(TAG, "No activity for %d s, entering standby", CONFIG_STANDBY_TIMEOUT_S);
+
+    /* RAM is lost in deep sleep: batched resume positions and playtime go to flash now */
+    log_store_flush();
+    esp_wifi_stop();
+    hold_pins_low();
+
+    /* The button's pull-up must be an RTC one; digital pulls are off in deep sleep */
+    rtc_gpio_pullup_en(BOARD_BUTTON_PLAY_PAUSE_GPIO);
+    rtc_gpio_pulldown_dis(BOARD_BUTTON_PLAY_PAUSE_GPIO);
+    esp_sleep_enable_ext0_wakeup(BOARD_BUTTON_PLAY_PAUSE_GPIO, 0);
+
+    esp_deep_sleep_start();
+}
+
+static void standby_timer_callback(void *arg)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool playing = s_playing;
+    portEXIT_CRITICAL(&s_lock);
+
+    /* Re-armed when playback stops */
+    if (!playing) {
+        enter_standby();
+    }
+}
+
+static void standby_event_handler(void *arg,
+                                  esp_event_base_t event_base,
+                                  int32_t event_id,
+                                  void *event_data)
+{
+    if (event_base == APP_EVENTS && event_id == APP_EVENT_NOW_PLAYING && event_data) {
+        const app_now_playing_event_t *event = (const app_now_playing_event_t *)event_data;
+        portENTER_CRITICAL(&s_lock);
+        bool was_playing = s_playing;
+        s_playing = event->playing;
+        portEXIT_CRITICAL(&s_lock);
+
+        if (was_playing && !event->playing) {
+            arm_timer();
+        }
+        return;
+    }
+
+    if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        uint32_t now_ms = ms_since_start();
+        portENTER_CRITICAL(&s_lock);
+        if (s_metrics.network_ready_ms == 0) {
+            s_metrics.network_ready_ms = now_ms;
+            if (s_wake_source == STANDBY_WAKE_NONE) {
+                s_rtc_cold_network_ready_ms = now_ms;
+            }
+        }
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+esp_err_t standby_init(void)
+{
+    if (s_timer != NULL) {
+        return ESP_OK;
+    }
+
+    /* No-op after a cold boot */
+    gpio_deep_sleep_hold_dis();
+    for (size_t i = 0; i < HELD_PIN_COUNT; i++) {
+        gpio_hold_dis(s_held_pins[i]);
+    }
+
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0) {
+        s_wake_source = STANDBY_WAKE_BUTTON;
+        s_rtc_wakeups++;
+        /* Hand the pin back to the digital GPIO matrix for the button driver */
+        rtc_gpio_deinit(BOARD_BUTTON_PLAY_PAUSE_GPIO);
+        ESP_LOGI(TAG, "Woke from standby (#%lu)", (unsigned long)s_rtc_wakeups);
+    } else {
+        s_rtc_wakeups = 0;
+        s_rtc_cold_network_ready_ms = 0;
+        s_rtc_cold_first_command_ms = 0;
+    }
+
+    ESP_ERROR_CHECK(esp_event_handler_register(APP_EVENTS,
+                                               APP_EVENT_NOW_PLAYING,
+                                               &standby_event_handler,
+                                               NULL));
+
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT,
+                                               IP_EVENT_STA_GOT_IP,
+                                               &standby_event_handler,
+                                               NULL));
+
+    if (CONFIG_STANDBY_TIMEOUT_S > 0) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = standby_timer_callback,
+            .name = "standby",
+        };
+        esp_err_t err = esp_timer_create(&timer_args, &s_timer);
+        if (err != ESP_OK) {
+            return err;
+        }
+        arm_timer();
+    }
+    return ESP_OK;
+}
+
+standby_wake_source_t standby_get_wake_source(void)
+{
+    return s_wake_source;
+}
+
+void standby_note_activity(void)
+{
+    arm_timer();
+}
+
+void standby_note_command_sent(void)
+{
+    uint32_t now_ms = ms_since_start();
+    bool first = false;
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_metrics.first_command_ms == 0) {
+        s_metrics.first_command_ms = now_ms;
+        if (s_wake_source == STANDBY_WAKE_NONE) {
+            s_rtc_cold_first_command_ms = now_ms;
+        }
+        first = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (first) {
+        ESP_LOGI(TAG, "First command %lu ms after start, network after %lu ms (cold boot: %lu / %lu ms)",
+                 (unsigned long)now_ms, (unsigned long)s_metrics.network_ready_ms,
+                 (unsigned long)s_rtc_cold_first_command_ms, (unsigned long)s_rtc_cold_network_ready_ms);
+    }
+}
+
+void standby_get_metrics(standby_metrics_t *metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *metrics = s_metrics;
+    metrics->wakeups = s_rtc_wakeups;
+    metrics->cold_network_ready_ms = s_rtc_cold_network_ready_ms;
+    metrics->cold_first_command_ms = s_rtc_cold_first_command_ms;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,76 @@
+#ifndef STANDBY_H
+#define STANDBY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @file standby.h
+ * @brief Deep-sleep standby after inactivity, woken by the play/pause button
+ *
+ * After CONFIG_STANDBY_TIMEOUT_S without a user command and while nothing
+ * plays, pending log store changes are flushed, WiFi is stopped, the panel,
+ * the RC522 and the LEDs are held in reset / off and the ESP32 enters deep
+ * sleep. The soft power latch stays held low, so the board stays powered.
+ *
+ * Only the play/pause button (GPIO 25) is an RTC GPIO, so it is the wake
+ * source (ext0, active low). A wake boots the application again, but the
+ * modules keep what they need in RTC memory (RTC_DATA_ATTR, kept across
+ * deep sleep only) to get to the first command quickly:
+ * - wifi_manager: BSSID and channel of the last AP, no full scan
+ * - music_assistant_controller: intended player state, title, volume and
+ *   media ID; the wake press is sent as media_play as soon as the IP is up
+ * - rfid_controller: the card left on the reader is not played again
+ *
+ * Boot-to-network and boot-to-first-command times of this boot and of the
+ * last cold boot are in standby_get_metrics().
+ */
+
+typedef enum {
+    STANDBY_WAKE_NONE = 0,      /* Cold boot or reset */
+    STANDBY_WAKE_BUTTON,        /* Play/pause pressed in standby */
+} standby_wake_source_t;
+
+typedef struct {
+    uint32_t wakeups;               /* Wakes from standby since the last cold boot */
+    uint32_t network_ready_ms;      /* App start to IP address, this boot; 0 = not yet */
+    uint32_t first_command_ms;      /* App start to the first command the server confirmed */
+    uint32_t cold_network_ready_ms; /* The same two, measured on the last cold boot */
+    uint32_t cold_first_command_ms;
+} standby_metrics_t;
+
+/**
+ * @brief Release the pins held during standby, read the wake cause and arm
+ *        the inactivity timer
+ *
+ * Call early, before the display, RC522, LED and button drivers configure
+ * their pins, and after the default event loop was created.
+ *
+ * @return ESP_OK on success, ESP_ERR_* on failure
+ */
+esp_err_t standby_init(void);
+
+/**
+ * @brief Why this boot happened
+ */
+standby_wake_source_t standby_get_wake_source(void);
+
+/**
+ * @brief Restart the inactivity timeout; safe to call from any task
+ */
+void standby_note_activity(void);
+
+/**
+ * @brief Record the time of the first command confirmed by the server
+ *
+ * Only the first call per boot counts.
+ */
+void standby_note_command_sent(void);
+
+/**
+ * @brief Copy the wake counters and boot timings
+ */
+void standby_get_metrics(standby_metrics_t *metrics);
+
+#endif /* STANDBY_H */
@@ -0,0 +1,623 @@
+#include "log_store.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "common/config.h"
+
+static const char *TAG = "LOG_STORE";
+
+#define PARTITION_LABEL     "logstore"
+#define SECTOR_SIZE         4096
+#define MAX_SECTORS         64
+#define NO_SECTOR           0xFFFF
+
+#define SECTOR_MAGIC        0x4C4F4753u     /* "LOGS" */
+#define RECORD_MARKER       0xA5
+#define RECORD_FLAG_DELETED 0x01
+#define ERASED_BYTE         0xFF
+
+#define FLUSH_TASK_STACK_SIZE   3072
+#define FLUSH_TASK_PRIORITY     2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;           /* Increases with every sector opened; 0 is never used */
+    uint32_t crc;           /* Over magic and seq */
+    uint32_t reserved;
+} sector_header_t;
+
+typedef struct {
+    uint8_t marker;         /* RECORD_MARKER; erased flash here ends the sector */
+    uint8_t flags;
+    uint8_t key_len;        /* Without the terminating NUL */
+    uint8_t value_len;
+    uint32_t crc;           /* Over the four bytes above, the key and the value */
+} record_header_t;
+
+#define RECORD_MAX_SIZE \
+    ((sizeof(record_header_t) + LOG_STORE_KEY_MAX + LOG_STORE_VALUE_MAX + 3) & ~3u)
+
+/* Live records fill at most two sectors, so with MIN_SECTORS there is always stale data to reclaim */
+#define MIN_SECTORS         (LOG_STORE_RESERVE_SECTORS + 6)
+_Static_assert(LOG_STORE_MAX_KEYS * RECORD_MAX_SIZE <= 2 * (SECTOR_SIZE - sizeof(sector_header_t)),
+               "live records must fit into two sectors");
+
+typedef struct {
+    bool used;
+    bool dirty;
+    bool deleted;           /* Removal not yet written */
+    uint8_t len;
+    uint16_t sector;        /* Sector holding the latest record, NO_SECTOR if never written */
+    char key[LOG_STORE_KEY_MAX];
+    uint8_t value[LOG_STORE_VALUE_MAX];
+} log_entry_t;
+
+static const esp_partition_t *s_partition = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+static esp_timer_handle_t s_flush_timer = NULL;
+static TaskHandle_t s_flush_task = NULL;
+
+static log_entry_t s_entries[LOG_STORE_MAX_KEYS];
+static uint32_t s_sector_seq[MAX_SECTORS];     /* 0 = free */
+static uint16_t s_sector_count = 0;
+static uint16_t s_head = 0;
+static uint32_t s_head_offset = SECTOR_SIZE;   /* SECTOR_SIZE = sealed, open a new one first */
+static uint32_t s_next_seq = 1;
+static log_store_metrics_t s_metrics;
+
+static uint32_t sector_header_crc(const sector_header_t *header)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)header, offsetof(sector_header_t, crc));
+}
+
+static uint32_t record_crc(const uint8_t *record)
+{
+    const record_header_t *header = (const record_header_t *)record;
+    uint32_t crc = esp_rom_crc32_le(0, record, offsetof(record_header_t, crc));
+    return esp_rom_crc32_le(crc, record + sizeof(record_header_t), header->key_len + header->value_len);
+}
+
+static uint32_t record_size(size_t key_len, size_t value_len)
+{
+    return (sizeof(record_header_t) + key_len + value_len + 3) & ~3u;
+}
+
+static uint32_t free_sectors(void)
+{
+    uint32_t count = 0;
+    for (int i = 0; i < s_sector_count; i++) {
+        count += s_sector_seq[i] == 0;
+    }
+    return count;
+}
+
+static log_entry_t *find_locked(const char *key)
+{
+    for (int i = 0; i < LOG_STORE_MAX_KEYS; i++) {
+        if (s_entries[i].used && strcmp(s_entries[i].key, key) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static log_entry_t *allocate_locked(const char *key)
+{
+    for (int i = 0; i < LOG_STORE_MAX_KEYS; i++) {
+        if (!s_entries[i].used) {
+            log_entry_t *entry = &s_entries[i];
+            memset(entry, 0, sizeof(*entry));
+            entry->used = true;
+            entry->sector = NO_SECTOR;
+            strcpy(entry->key, key);
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t compact_oldest_locked(void);
+
+/*
+ * Erase the next free sector after the head and make it the new head.
+ * Outside of compaction, first compacts until LOG_STORE_RESERVE_SECTORS
+ * sectors are free, so compaction itself always has room to move records.
+ */
+static esp_err_t open_sector_locked(bool compacting)
+{
+    if (!compacting) {
+        for (int guard = 0; guard < s_sector_count && free_sectors() < LOG_STORE_RESERVE_SECTORS; guard++) {
+            if (compact_oldest_locked() != ESP_OK) {
+                break;
+            }
+        }
+    }
+
+    int next = -1;
+    for (int i = 1; i <= s_sector_count; i++) {
+        int candidate = (s_head + i) % s_sector_count;
+        if (s_sector_seq[candidate] == 0) {
+            next = candidate;
+            break;
+        }
+    }
+    if (next < 0) {
+        ESP_LOGE(TAG, "No free sector left");
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = esp_partition_erase_range(s_partition, (size_t)next * SECTOR_SIZE, SECTOR_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to erase sector %d: %s", next, esp_err_to_name(err));
+        return err;
+    }
+    s_metrics.sector_erases++;
+
+    sector_header_t header = {
+        .magic = SECTOR_MAGIC,
+        .seq = s_next_seq,
+        .reserved = 0xFFFFFFFFu,
+    };
+    header.crc = sector_header_crc(&header);
+    err = esp_partition_write(s_partition, (size_t)next * SECTOR_SIZE, &header, sizeof(header));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write sector %d header: %s", next, esp_err_to_name(err));
+        return err;
+    }
+
+    s_sector_seq[next] = s_next_seq++;
+    s_head = next;
+    s_head_offset = sizeof(sector_header_t);
+    return ESP_OK;
+}
+
+/* Append the current state of an entry (its value, or a removal) at the head */
+static esp_err_t append_record_locked(log_entry_t *entry, bool compacting)
+{
+    size_t key_len = strlen(entry->key);
+    size_t value_len = entry->deleted ? 0 : entry->len;
+    uint32_t size = record_size(key_len, value_len);
+
+    while (s_head_offset + size > SECTOR_SIZE) {
+        esp_err_t err = open_sector_locked(compacting);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    uint8_t record[RECORD_MAX_SIZE];
+    memset(record, ERASED_BYTE, sizeof(record));
+    record_header_t *header = (record_header_t *)record;
+    header->marker = RECORD_MARKER;
+    header->flags = entry->deleted ? RECORD_FLAG_DELETED : 0;
+    header->key_len = key_len;
+    header->value_len = value_len;
+    memcpy(record + sizeof(record_header_t), entry->key, key_len);
+    memcpy(record + sizeof(record_header_t) + key_len, entry->value, value_len);
+    header->crc = record_crc(record);
+
+    esp_err_t err = esp_partition_write(s_partition, (size_t)s_head * SECTOR_SIZE + s_head_offset, record, size);
+    if (err != ESP_OK) {
+        /* The bytes at the head are unknown now: never write there again */
+        s_head_offset = SECTOR_SIZE;
+        ESP_LOGE(TAG, "Failed to append record: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_head_offset += size;
+    entry->sector = s_head;
+    s_metrics.records_written++;
+    s_metrics.bytes_written += size;
+    return ESP_OK;
+}
+
+/* Move the current records out of the oldest sector and release it */
+static esp_err_t compact_oldest_locked(void)
+{
+    int tail = -1;
+    for (int i = 0; i < s_sector_count; i++) {
+        if (s_sector_seq[i] != 0 && (tail < 0 || s_sector_seq[i] < s_sector_seq[tail])) {
+            tail = i;
+        }
+    }
+    if (tail < 0 || tail == s_head) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (int i = 0; i < LOG_STORE_MAX_KEYS; i++) {
+        log_entry_t *entry = &s_entries[i];
+        if (!entry->used || entry->sector != tail) {
+            continue;
+        }
+        if (entry->deleted) {
+            /* Its only record is about to go away; nothing left to remove */
+            entry->used = false;
+            continue;
+        }
+        /* Write the newest value, which also covers a pending change */
+        esp_err_t err = append_record_locked(entry, true);
+        if (err != ESP_OK) {
+            return err;
+        }
+        entry->dirty = false;
+    }
+
+    /* Zero the magic so the sector reads as free even if the later erase is cut short */
+    uint32_t invalid = 0;
+    esp_err_t err = esp_partition_write(s_partition, (size_t)tail * SECTOR_SIZE, &invalid, sizeof(invalid));
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_sector_seq[tail] = 0;
+    s_metrics.compactions++;
+    ESP_LOGD(TAG, "Compacted sector %d", tail);
+    return ESP_OK;
+}
+
+static esp_err_t flush_locked(void)
+{
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+
+    for (int i = 0; i < LOG_STORE_MAX_KEYS && err == ESP_OK; i++) {
+        log_entry_t *entry = &s_entries[i];
+        if (!entry->used || !entry->dirty) {
+            continue;
+        }
+        err = append_record_locked(entry, false);
+        if (err == ESP_OK) {
+            entry->dirty = false;
+            if (entry->deleted) {
+                entry->used = false;
+            }
+        }
+    }
+
+    s_metrics.flushes++;
+    s_metrics.last_flush_us = (uint32_t)(esp_timer_get_time() - start_us);
+    return err;
+}
+
+/* A flush erases and programs flash for tens of ms: keep it off the esp_timer task */
+static void flush_timer_callback(void *arg)
+{
+    (void)arg;
+    xTaskNotifyGive(s_flush_task);
+}
+
+static void flush_task(void *arg)
+{
+    (void)arg;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        log_store_flush();
+    }
+}
+
+static void schedule_flush(void)
+{
+    /* Batch: the first change arms the timer, later ones ride along */
+    if (!esp_timer_is_active(s_flush_timer)) {
+        esp_timer_start_once(s_flush_timer, (uint64_t)LOG_STORE_FLUSH_DELAY_MS * 1000);
+    }
+}
+
+static void apply_record(const uint8_t *record, uint16_t sector)
+{
+    const record_header_t *header = (const record_header_t *)record;
+    char key[LOG_STORE_KEY_MAX];
+    memcpy(key, record + sizeof(record_header_t), header->key_len);
+    key[header->key_len] = '\0';
+
+    log_entry_t *entry = find_locked(key);
+    if (header->flags & RECORD_FLAG_DELETED) {
+        if (entry != NULL) {
+            entry->used = false;
+        }
+        return;
+    }
+    if (entry == NULL) {
+        entry = allocate_locked(key);
+        if (entry == NULL) {
+            ESP_LOGW(TAG, "No slot for key '%s', dropped", key);
+            return;
+        }
+    }
+    entry->len = header->value_len;
+    memcpy(entry->value, record + sizeof(record_header_t) + header->key_len, header->value_len);
+    entry->sector = sector;
+}
+
+/* Replay one sector from a RAM copy; returns the offset where valid records end */
+static uint32_t replay_sector(const uint8_t *data, uint16_t sector, bool *torn)
+{
+    uint32_t offset = sizeof(sector_header_t);
+    *torn = false;
+
+    while (offset + sizeof(record_header_t) <= SECTOR_SIZE) {
+        const record_header_t *header = (const record_header_t *)(data + offset);
+        if (header->marker == ERASED_BYTE) {
+            /* End of data, unless a torn write left programmed bytes further on */
+            for (uint32_t i = offset; i < SECTOR_SIZE; i++) {
+                if (data[i] != ERASED_BYTE) {
+                    *torn = true;
+                    break;
+                }
+            }
+            return offset;
+        }
+
+        uint32_t size = record_size(header->key_len, header->value_len);
+        if (header->marker != RECORD_MARKER || header->key_len == 0 ||
+            header->key_len >= LOG_STORE_KEY_MAX || header->value_len > LOG_STORE_VALUE_MAX ||
+            offset + size > SECTOR_SIZE || header->crc != record_crc(data + offset)) {
+            /* The length can't be trusted either: nothing after this is reachable */
+            s_metrics.torn_records++;
+            *torn = true;
+            return offset;
+        }
+
+        apply_record(data + offset, sector);
+        s_metrics.records_recovered++;
+        offset += size;
+    }
+    return offset;
+}
+
+static esp_err_t recover_locked(void)
+{
+    int64_t start_us = esp_timer_get_time();
+    uint8_t *data = malloc(SECTOR_SIZE);
+    if (data == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* Pass 1: find the sectors in use */
+    uint32_t max_seq = 0;
+    for (int i = 0; i < s_sector_count; i++) {
+        sector_header_t header;
+        s_sector_seq[i] = 0;
+        if (esp_partition_read(s_partition, (size_t)i * SECTOR_SIZE, &header, sizeof(header)) != ESP_OK) {
+            continue;
+        }
+        if (header.magic == SECTOR_MAGIC && header.seq != 0 && header.crc == sector_header_crc(&header)) {
+            s_sector_seq[i] = header.seq;
+            if (header.seq > max_seq) {
+                max_seq = header.seq;
+                s_head = i;
+            }
+        }
+    }
+    s_next_seq = max_seq + 1;
+
+    /* Pass 2: replay them oldest first so newer records win */
+    esp_err_t err = ESP_OK;
+    uint32_t last_seq = 0;
+    while (true) {
+        int sector = -1;
+        for (int i = 0; i < s_sector_count; i++) {
+            if (s_sector_seq[i] > last_seq && (sector < 0 || s_sector_seq[i] < s_sector_seq[sector])) {
+                sector = i;
+            }
+        }
+        if (sector < 0) {
+            break;
+        }
+        last_seq = s_sector_seq[sector];
+
+        err = esp_partition_read(s_partition, (size_t)sector * SECTOR_SIZE, data, SECTOR_SIZE);
+        if (err != ESP_OK) {
+            break;
+        }
+        bool torn = false;
+        uint32_t end = replay_sector(data, sector, &torn);
+        if (sector == s_head) {
+            /* Never append over a torn record: continue in a fresh sector instead */
+            s_head_offset = torn ? SECTOR_SIZE : end;
+        }
+        if (torn) {
+            ESP_LOGW(TAG, "Sector %d ends with a torn record at offset %lu", sector, (unsigned long)end);
+        }
+    }
+    free(data);
+
+    if (err == ESP_OK && max_seq == 0) {
+        /* Empty or foreign partition: start from the first sector */
+        s_head = s_sector_count - 1;
+        err = open_sector_locked(true);
+    }
+
+    s_metrics.recovery_us = (uint32_t)(esp_timer_get_time() - start_us);
+    return err;
+}
+
+esp_err_t log_store_init(void)
+{
+    if (s_lock != NULL) {
+        return ESP_OK;
+    }
+
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, PARTITION_LABEL);
+    if (s_partition == NULL) {
+        ESP_LOGE(TAG, "Partition '%s' not found", PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint32_t sectors = s_partition->size / SECTOR_SIZE;
+    if (sectors < MIN_SECTORS) {
+        ESP_LOGE(TAG, "Partition '%s' too small (%lu sectors)", PARTITION_LABEL, (unsigned long)sectors);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_sector_count = sectors > MAX_SECTORS ? MAX_SECTORS : sectors;
+
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = flush_timer_callback,
+        .name = "log_store_flush",
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_flush_timer);
+    if (err == ESP_OK) {
+        err = recover_locked();
+    }
+    if (err == ESP_OK && xTaskCreate(flush_task, "log_store", FLUSH_TASK_STACK_SIZE, NULL,
+                                     FLUSH_TASK_PRIORITY, &s_flush_task) != pdPASS) {
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize: %s", esp_err_to_name(err));
+        if (s_flush_timer != NULL) {
+            esp_timer_delete(s_flush_timer);
+            s_flush_timer = NULL;
+        }
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Recovered %lu record(s) from %lu sector(s) in %lu us (%lu torn)",
+             (unsigned long)s_metrics.records_recovered,
+             (unsigned long)(s_sector_count - free_sectors()),
+             (unsigned long)s_metrics.recovery_us,
+             (unsigned long)s_metrics.torn_records);
+    return ESP_OK;
+}
+
+esp_err_t log_store_get(const char *key, void *value, size_t *len)
+{
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (key == NULL || value == NULL || len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    log_entry_t *entry = find_locked(key);
+    if (entry == NULL || entry->deleted) {
+        err = ESP_ERR_NOT_FOUND;
+    } else if (*len < entry->len) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        memcpy(value, entry->value, entry->len);
+    }
+    if (entry != NULL && !entry->deleted) {
+        *len = entry->len;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t log_store_set(const char *key, const void *value, size_t len)
+{
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (key == NULL || key[0] == '\0' || strlen(key) >= LOG_STORE_KEY_MAX ||
+        (value == NULL && len > 0) || len > LOG_STORE_VALUE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    log_entry_t *entry = find_locked(key);
+    if (entry != NULL && !entry->deleted && entry->len == len && memcmp(entry->value, value, len) == 0) {
+        xSemaphoreGive(s_lock);
+        return ESP_OK;
+    }
+    if (entry == NULL) {
+        entry = allocate_locked(key);
+        if (entry == NULL) {
+            xSemaphoreGive(s_lock);
+            ESP_LOGW(TAG, "Store full, '%s' not saved", key);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    entry->deleted = false;
+    entry->dirty = true;
+    entry->len = len;
+    memcpy(entry->value, value, len);
+    s_metrics.sets++;
+    xSemaphoreGive(s_lock);
+
+    schedule_flush();
+    return ESP_OK;
+}
+
+esp_err_t log_store_erase(const char *key)
+{
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (key == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    log_entry_t *entry = find_locked(key);
+    if (entry == NULL || entry->deleted) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (entry->sector == NO_SECTOR) {
+        /* Never reached flash: nothing to remove there */
+        entry->used = false;
+        xSemaphoreGive(s_lock);
+        return ESP_OK;
+    }
+    entry->deleted = true;
+    entry->dirty = true;
+    xSemaphoreGive(s_lock);
+
+    schedule_flush();
+    return ESP_OK;
+}
+
+esp_err_t log_store_flush(void)
+{
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool pending = false;
+    for (int i = 0; i < LOG_STORE_MAX_KEYS; i++) {
+        pending |= s_entries[i].used && s_entries[i].dirty;
+    }
+    esp_err_t err = pending ? flush_locked() : ESP_OK;
+    xSemaphoreGive(s_lock);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Flush failed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+void log_store_get_metrics(log_store_metrics_t *metrics)
+{
+    if (s_lock == NULL || metrics == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *metrics = s_metrics;
+    metrics->sectors = s_sector_count;
+    metrics->sectors_used = s_sector_count - free_sectors();
+    metrics->keys = 0;
+    for (int i = 0; i < LOG_STORE_MAX_KEYS; i++) {
+        metrics->keys += s_entries[i].used && !s_entries[i].deleted;
+    }
+    xSemaphoreGive(s_lock);
+}
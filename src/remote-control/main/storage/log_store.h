@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @file log_store.h
+ * @brief Append-only key/value store for frequently updated runtime state
+ *
+ * Records live on the "logstore" data partition (see partitions.csv), which
+ * is used as a ring of flash sectors. Every update is appended as a
+ * CRC-framed record to the head sector; nothing is rewritten in place, so
+ * erases are spread evenly over the whole partition.
+ *
+ * All live values are mirrored in RAM: reads never touch flash, and writes
+ * only mark a value dirty. Dirty values are appended in one batch
+ * LOG_STORE_FLUSH_DELAY_MS after the first change, or on log_store_flush().
+ *
+ * When fewer than LOG_STORE_RESERVE_SECTORS sectors are free, the oldest
+ * sector is compacted: its still-current records are re-appended at the head
+ * and the sector is released. At boot the sectors are replayed oldest first;
+ * a record torn by power loss ends the replay of its sector, and the head is
+ * sealed so no later write lands on top of it.
+ *
+ * All functions are safe to call from any task.
+ */
+
+/** Longest key, including the terminating NUL */
+#define LOG_STORE_KEY_MAX 24
+
+/** Largest value in bytes */
+#define LOG_STORE_VALUE_MAX 32
+
+typedef struct {
+    uint32_t sectors;           /* Sectors in the partition */
+    uint32_t sectors_used;
+    uint32_t keys;              /* Live keys */
+    uint32_t sets;              /* log_store_set() calls that changed a value */
+    uint32_t flushes;
+    uint32_t records_written;
+    uint32_t bytes_written;
+    uint32_t sector_erases;
+    uint32_t compactions;
+    uint32_t records_recovered; /* Records replayed at boot */
+    uint32_t torn_records;      /* Records discarded at boot because their CRC failed */
+    uint32_t recovery_us;       /* Time spent replaying the log at boot */
+    uint32_t last_flush_us;
+} log_store_metrics_t;
+
+/**
+ * @brief Mount the partition, replay the log and start the flush timer
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the partition is missing,
+ *         ESP_ERR_INVALID_SIZE if it is too small
+ */
+esp_err_t log_store_init(void);
+
+/**
+ * @brief Read a value
+ *
+ * @param key   Key, shorter than LOG_STORE_KEY_MAX
+ * @param value Destination buffer
+ * @param len   In: size of value. Out: size of the stored value
+ * @return ESP_OK, ESP_ERR_NOT_FOUND, or ESP_ERR_INVALID_SIZE if the buffer is too small
+ */
+esp_err_t log_store_get(const char *key, void *value, size_t *len);
+
+/**
+ * @brief Store a value; it reaches flash with the next batch
+ *
+ * Setting a key to the value it already holds costs nothing.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an oversized key or value,
+ *         ESP_ERR_NO_MEM if LOG_STORE_MAX_KEYS keys are already in use
+ */
+esp_err_t log_store_set(const char *key, const void *value, size_t len);
+
+/**
+ * @brief Remove a key; the removal reaches flash with the next batch
+ *
+ * @return ESP_OK or ESP_ERR_NOT_FOUND
+ */
+esp_err_t log_store_erase(const char *key);
+
+/**
+ * @brief Append all pending changes now (e.g. before powering off)
+ */
+esp_err_t log_store_flush(void);
+
+/**
+ * @brief Copy the store and flash wear counters
+ */
+void log_store_get_metrics(log_store_metrics_t *metrics);
@@ -0,0 +1,330 @@
+#include "media_metadata.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "common/config.h"
+
+static const char *TAG = "MEDIA_METADATA";
+
+#define NVS_NAMESPACE   "media_meta"
+#define NVS_KEY_SIZE    10              /* "m" + 8 hex digits of the media ID hash + NUL */
+
+/* NVS blob: header, then media ID, title and artist without NULs */
+typedef struct {
+    uint32_t seq;           /* Write order; the smallest is dropped first */
+    float duration;
+    uint8_t id_len;
+    uint8_t title_len;
+    uint8_t artist_len;
+    uint8_t reserved;
+} record_header_t;
+
+#define RECORD_MAX_SIZE \
+    (sizeof(record_header_t) + MEDIA_METADATA_KEY_MAX + 2 * MEDIA_METADATA_TEXT_MAX)
+
+typedef struct {
+    bool used;
+    uint32_t hash;
+    uint32_t last_use;
+    char media_id[MEDIA_METADATA_KEY_MAX];
+    media_metadata_t metadata;
+} cache_entry_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t seq;           /* 0 = free */
+} flash_entry_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static nvs_handle_t s_nvs;
+static cache_entry_t s_cache[MEDIA_METADATA_CACHE_SIZE];
+static flash_entry_t s_flash[MEDIA_METADATA_FLASH_MAX];
+static uint32_t s_use_clock = 0;
+static uint32_t s_write_seq = 0;
+static media_metadata_metrics_t s_metrics;
+
+/* FNV-1a */
+static uint32_t key_hash(const char *key)
+{
+    uint32_t hash = 2166136261u;
+    for (const char *p = key; *p != '\0'; p++) {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    return hash;
+}
+
+static void nvs_key(uint32_t hash, char *key)
+{
+    snprintf(key, NVS_KEY_SIZE, "m%08lx", (unsigned long)hash);
+}
+
+static bool same_metadata(const media_metadata_t *a, const media_metadata_t *b)
+{
+    return strcmp(a->title, b->title) == 0 && strcmp(a->artist, b->artist) == 0 && a->duration == b->duration;
+}
+
+static cache_entry_t *cache_find_locked(const char *media_id, uint32_t hash)
+{
+    for (int i = 0; i < MEDIA_METADATA_CACHE_SIZE; i++) {
+        if (s_cache[i].used && s_cache[i].hash == hash && strcmp(s_cache[i].media_id, media_id) == 0) {
+            return &s_cache[i];
+        }
+    }
+    return NULL;
+}
+
+/* Put an entry into the RAM LRU, replacing the least recently used one */
+static cache_entry_t *cache_insert_locked(const char *media_id, uint32_t hash, const media_metadata_t *metadata)
+{
+    cache_entry_t *entry = cache_find_locked(media_id, hash);
+    if (entry == NULL) {
+        entry = &s_cache[0];
+        for (int i = 0; i < MEDIA_METADATA_CACHE_SIZE; i++) {
+            if (!s_cache[i].used) {
+                entry = &s_cache[i];
+                break;
+            }
+            if (s_cache[i].last_use < entry->last_use) {
+                entry = &s_cache[i];
+            }
+        }
+        entry->used = true;
+        entry->hash = hash;
+        strcpy(entry->media_id, media_id);
+    }
+    entry->metadata = *metadata;
+    entry->last_use = ++s_use_clock;
+    return entry;
+}
+
+static flash_entry_t *flash_find_locked(uint32_t hash)
+{
+    for (int i = 0; i < MEDIA_METADATA_FLASH_MAX; i++) {
+        if (s_flash[i].seq != 0 && s_flash[i].hash == hash) {
+            return &s_flash[i];
+        }
+    }
+    return NULL;
+}
+
+static bool flash_read_locked(const char *media_id, uint32_t hash, media_metadata_t *metadata)
+{
+    uint8_t record[RECORD_MAX_SIZE];
+    size_t size = sizeof(record);
+    char key[NVS_KEY_SIZE];
+
+    nvs_key(hash, key);
+    if (nvs_get_blob(s_nvs, key, record, &size) != ESP_OK || size < sizeof(record_header_t)) {
+        return false;
+    }
+
+    record_header_t header;
+    memcpy(&header, record, sizeof(header));
+    const char *p = (const char *)record + sizeof(header);
+    size_t id_len = strlen(media_id);
+    if (sizeof(header) + header.id_len + header.title_len + header.artist_len != size ||
+        header.id_len != id_len || memcmp(p, media_id, id_len) != 0 ||
+        header.title_len >= MEDIA_METADATA_TEXT_MAX || header.artist_len >= MEDIA_METADATA_TEXT_MAX) {
+        /* Another media ID with the same hash, or a stale layout */
+        return false;
+    }
+    p += header.id_len;
+
+    memset(metadata, 0, sizeof(*metadata));
+    memcpy(metadata->title, p, header.title_len);
+    p += header.title_len;
+    memcpy(metadata->artist, p, header.artist_len);
+    metadata->duration = header.duration;
+    return true;
+}
+
+static esp_err_t flash_write_locked(const char *media_id, uint32_t hash, const media_metadata_t *metadata)
+{
+    uint8_t record[RECORD_MAX_SIZE];
+    record_header_t header = {
+        .seq = ++s_write_seq,
+        .duration = metadata->duration,
+        .id_len = (uint8_t)strlen(media_id),
+        .title_len = (uint8_t)strlen(metadata->title),
+        .artist_len = (uint8_t)strlen(metadata->artist),
+    };
+    uint8_t *p = record;
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    memcpy(p, media_id, header.id_len);
+    p += header.id_len;
+    memcpy(p, metadata->title, header.title_len);
+    p += header.title_len;
+    memcpy(p, metadata->artist, header.artist_len);
+    p += header.artist_len;
+
+    flash_entry_t *slot = flash_find_locked(hash);
+    if (slot == NULL) {
+        slot = &s_flash[0];
+        for (int i = 0; i < MEDIA_METADATA_FLASH_MAX; i++) {
+            if (s_flash[i].seq == 0) {
+                slot = &s_flash[i];
+                break;
+            }
+            if (s_flash[i].seq < slot->seq) {
+                slot = &s_flash[i];
+            }
+        }
+        if (slot->seq != 0) {
+            char old_key[NVS_KEY_SIZE];
+            nvs_key(slot->hash, old_key);
+            nvs_erase_key(s_nvs, old_key);
+            s_metrics.evictions++;
+            s_metrics.flash_entries--;
+        }
+        slot->seq = 0;
+        slot->hash = hash;
+    }
+
+    char key[NVS_KEY_SIZE];
+    nvs_key(hash, key);
+    esp_err_t err = nvs_set_blob(s_nvs, key, record, (size_t)(p - record));
+    if (err == ESP_OK) {
+        err = nvs_commit(s_nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store metadata: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    if (slot->seq == 0) {
+        s_metrics.flash_entries++;
+    }
+    slot->seq = header.seq;
+    s_metrics.flash_writes++;
+    return ESP_OK;
+}
+
+/* Rebuild the flash index from the stored blobs' headers */
+static void index_entries(void)
+{
+    nvs_iterator_t it = NULL;
+    esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, NVS_NAMESPACE, NVS_TYPE_BLOB, &it);
+    int count = 0;
+
+    while (err == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+
+        uint8_t record[RECORD_MAX_SIZE];
+        size_t size = sizeof(record);
+        record_header_t header;
+        unsigned long hash = 0;
+        if (nvs_get_blob(s_nvs, info.key, record, &size) == ESP_OK && size >= sizeof(header) &&
+            sscanf(info.key, "m%08lx", &hash) == 1 && count < MEDIA_METADATA_FLASH_MAX) {
+            memcpy(&header, record, sizeof(header));
+            s_flash[count++] = (flash_entry_t){ .hash = (uint32_t)hash, .seq = header.seq };
+            if (header.seq > s_write_seq) {
+                s_write_seq = header.seq;
+            }
+        }
+        err = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    s_metrics.flash_entries = (uint32_t)count;
+}
+
+esp_err_t media_metadata_init(void)
+{
+    if (s_lock != NULL) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &s_nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS namespace '%s': %s", NVS_NAMESPACE, esp_err_to_name(err));
+        return err;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        nvs_close(s_nvs);
+        return ESP_ERR_NO_MEM;
+    }
+
+    index_entries();
+    ESP_LOGI(TAG, "%lu media ID(s) known", (unsigned long)s_metrics.flash_entries);
+    return ESP_OK;
+}
+
+bool media_metadata_get(const char *media_id, media_metadata_t *metadata)
+{
+    if (s_lock == NULL || media_id == NULL || metadata == NULL ||
+        media_id[0] == '\0' || strlen(media_id) >= MEDIA_METADATA_KEY_MAX) {
+        return false;
+    }
+
+    uint32_t hash = key_hash(media_id);
+    bool found = false;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_metrics.lookups++;
+    cache_entry_t *entry = cache_find_locked(media_id, hash);
+    if (entry != NULL) {
+        entry->last_use = ++s_use_clock;
+        *metadata = entry->metadata;
+        s_metrics.ram_hits++;
+        found = true;
+    } else if (flash_find_locked(hash) != NULL && flash_read_locked(media_id, hash, metadata)) {
+        cache_insert_locked(media_id, hash, metadata);
+        s_metrics.flash_hits++;
+        found = true;
+    }
+    xSemaphoreGive(s_lock);
+    return found;
+}
+
+esp_err_t media_metadata_put(const char *media_id, const media_metadata_t *metadata)
+{
+    if (media_id == NULL || metadata == NULL || media_id[0] == '\0' ||
+        strlen(media_id) >= MEDIA_METADATA_KEY_MAX || metadata->title[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    media_metadata_t stored = *metadata;
+    /* Bounded strings, so the lengths fit the record header */
+    stored.title[sizeof(stored.title) - 1] = '\0';
+    stored.artist[sizeof(stored.artist) - 1] = '\0';
+    uint32_t hash = key_hash(media_id);
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_metrics.stores++;
+    media_metadata_t known;
+    cache_entry_t *entry = cache_find_locked(media_id, hash);
+    bool unchanged = false;
+    if (entry != NULL) {
+        unchanged = same_metadata(&entry->metadata, &stored);
+    } else if (flash_find_locked(hash) != NULL && flash_read_locked(media_id, hash, &known)) {
+        unchanged = same_metadata(&known, &stored);
+    }
+    if (!unchanged) {
+        err = flash_write_locked(media_id, hash, &stored);
+    }
+    cache_insert_locked(media_id, hash, &stored);
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void media_metadata_get_metrics(media_metadata_metrics_t *metrics)
+{
+    if (metrics == NULL || s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *metrics = s_metrics;
+    xSemaphoreGive(s_lock);
+}
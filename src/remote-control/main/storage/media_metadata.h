@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @file media_metadata.h
+ * @brief Title, artist and duration per media ID, remembered across reboots
+ *
+ * Lets a card tap show what it is going to play before Home Assistant has
+ * even received the play_media request. Entries are learnt from the first
+ * player state reported after a media ID was loaded.
+ *
+ * The most recently used entries are kept in a RAM LRU of
+ * MEDIA_METADATA_CACHE_SIZE; all entries, up to MEDIA_METADATA_FLASH_MAX,
+ * are stored in NVS (namespace "media_meta"), one blob per media ID, and
+ * the one written longest ago is dropped first. An entry is only written
+ * when it changes, which for a given card is about once, so NVS wear is
+ * not a concern here (unlike the state kept in the log store).
+ *
+ * All functions are safe to call from any task. media_metadata_init() needs
+ * NVS to be initialized (wifi_manager_init()).
+ */
+
+/** Longest title and artist kept, in bytes (UTF-8) including the terminating NUL */
+#define MEDIA_METADATA_TEXT_MAX 64
+
+/** Longest media ID, including the terminating NUL */
+#define MEDIA_METADATA_KEY_MAX 128
+
+typedef struct {
+    char title[MEDIA_METADATA_TEXT_MAX];
+    char artist[MEDIA_METADATA_TEXT_MAX];   /* Empty if unknown */
+    float duration;                         /* Seconds, 0 if unknown (e.g. radio) */
+} media_metadata_t;
+
+typedef struct {
+    uint32_t lookups;
+    uint32_t ram_hits;
+    uint32_t flash_hits;        /* Found in NVS after a RAM miss */
+    uint32_t stores;            /* media_metadata_put() calls */
+    uint32_t flash_writes;      /* ... that changed an entry and were written */
+    uint32_t evictions;         /* NVS entries dropped to make room */
+    uint32_t flash_entries;
+} media_metadata_metrics_t;
+
+/**
+ * @brief Open the NVS namespace and index the stored entries
+ *
+ * @return ESP_OK on success, or the NVS error
+ */
+esp_err_t media_metadata_init(void);
+
+/**
+ * @brief Look up the metadata of a media ID (RAM first, then NVS)
+ *
+ * @return true and *metadata filled if known
+ */
+bool media_metadata_get(const char *media_id, media_metadata_t *metadata);
+
+/**
+ * @brief Remember the metadata of a media ID
+ *
+ * Storing what is already known costs no flash write.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an empty or oversized media ID or
+ *         an empty title, ESP_ERR_INVALID_STATE before media_metadata_init(),
+ *         or the NVS error
+ */
+esp_err_t media_metadata_put(const char *media_id, const media_metadata_t *metadata);
+
+/**
+ * @brief Copy the cache counters
+ */
+void media_metadata_get_metrics(media_metadata_metrics_t *metrics);
@@ -0,0 +1,84 @@
+#include "time_sync.h"
+
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_netif_sntp.h"
+#include "esp_wifi.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "TIME_SYNC";
+
+static bool s_handlers_registered = false;
+static bool s_sntp_started = false;
+static volatile bool s_synced = false;
+
+static void time_sync_notification(struct timeval *tv)
+{
+    bool first = !s_synced;
+    s_synced = true;
+
+    if (first) {
+        ESP_LOGI(TAG, "System time set by SNTP: %lld", (long long)tv->tv_sec);
+    } else {
+        ESP_LOGD(TAG, "System time resynchronised: %lld", (long long)tv->tv_sec);
+    }
+}
+
+static void time_sync_ip_event_handler(void *arg, esp_event_base_t event_base,
+                                       int32_t event_id, void *event_data)
+{
+    (void)arg;
+    (void)event_data;
+
+    if (event_base != IP_EVENT || event_id != IP_EVENT_STA_GOT_IP || s_sntp_started) {
+        return;
+    }
+
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_TIME_SYNC_SNTP_SERVER);
+    config.sync_cb = time_sync_notification;
+
+    esp_err_t err = esp_netif_sntp_init(&config);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to start SNTP: %s", esp_err_to_name(err));
+        return;
+    }
+    s_sntp_started = true;
+    ESP_LOGI(TAG, "SNTP started (%s)", CONFIG_TIME_SYNC_SNTP_SERVER);
+}
+
+esp_err_t time_sync_init(void)
+{
+    if (s_handlers_registered) {
+        return ESP_OK;
+    }
+
+    /* Local time for everything that cares about calendar days */
+    setenv("TZ", CONFIG_TIME_SYNC_TIMEZONE, 1);
+    tzset();
+
+    esp_err_t err = esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                                               &time_sync_ip_event_handler, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    s_handlers_registered = true;
+    return ESP_OK;
+}
+
+bool time_sync_is_synced(void)
+{
+    return s_synced;
+}
+
+int64_t time_sync_now_us(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @file time_sync.h
+ * @brief Wall clock synchronisation via SNTP
+ *
+ * Starts SNTP (CONFIG_TIME_SYNC_SNTP_SERVER) on the first IP_EVENT_STA_GOT_IP
+ * and keeps the system time in sync with it, so timestamps reported by Home
+ * Assistant can be compared with gettimeofday().
+ */
+
+/**
+ * @brief Register for IP events; SNTP starts once the station has an address
+ *
+ * @return ESP_OK on success, ESP_ERR_* on failure
+ */
+esp_err_t time_sync_init(void);
+
+/**
+ * @brief Whether the system time has been set by SNTP at least once
+ */
+bool time_sync_is_synced(void);
+
+/**
+ * @brief Current wall clock time in microseconds since the Unix epoch
+ *
+ * Only meaningful once time_sync_is_synced() returns true.
+ */
+int64_t time_sync_now_us(void);
@@ -5,6 +5,7 @@
 #include "freertos/event_groups.h"
 #include "sdkconfig.h"
 #include "common/config.h"
+#include "wifi_manager.h"
 
 /* WiFi connection state handling */
 #define WIFI_CONNECT_MAX_RETRY 5
@@ -21,6 +22,11 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        /* The AP remembered across standby may have moved: retry with a full scan.
+         * Not when we left ourselves (esp_wifi_stop() before standby). */
+        if (((wifi_event_sta_disconnected_t*)event_data)->reason != WIFI_REASON_ASSOC_LEAVE) {
+            wifi_manager_forget_ap();
+        }
         if (s_retry_num < WIFI_CONNECT_MAX_RETRY) {
             esp_wifi_connect();
             s_retry_num++;
@@ -33,6 +39,7 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
         //ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         //ESP_LOGI(TAG, "got ip:%s", esp_ip4addr_ntoa(&event->ip_info.ip));
         s_retry_num = 0;
+        wifi_manager_remember_ap();
     }
 }
 
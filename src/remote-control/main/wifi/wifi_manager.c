@@ -6,9 +6,20 @@
 #include "freertos/event_groups.h"
 #include "sdkconfig.h"
 #include "common/config.h"
+#include <string.h>
 
 static const char *TAG = "WIFI_MANAGER";
 
+/* AP of the last connection, kept across deep sleep (zeroed by a cold boot) */
+typedef struct {
+    bool valid;
+    uint8_t bssid[6];
+    uint8_t channel;
+} wifi_ap_hint_t;
+
+static RTC_DATA_ATTR wifi_ap_hint_t s_ap_hint;
+static bool s_hint_in_use = false;
+
 esp_err_t wifi_manager_init()
 {
     /* Initialize NVS */
@@ -44,9 +55,21 @@ esp_err_t wifi_manager_init()
             .password = "",
 #endif
             .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+            /* Only used in maximum modem sleep, see wifi_power_save */
+            .listen_interval = CONFIG_WIFI_PS_LISTEN_INTERVAL,
         },
     };
 
+    if (s_ap_hint.valid) {
+        /* Known AP and channel: one probe on that channel instead of a full scan */
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, s_ap_hint.bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = s_ap_hint.channel;
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+        s_hint_in_use = true;
+        ESP_LOGI(TAG, "Joining the last AP on channel %u", s_ap_hint.channel);
+    }
+
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
@@ -54,3 +77,32 @@ esp_err_t wifi_manager_init()
     ESP_LOGI(TAG, "WiFi manager initialized");
     return ESP_OK;
 }
+
+void wifi_manager_remember_ap(void)
+{
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    memcpy(s_ap_hint.bssid, ap.bssid, sizeof(s_ap_hint.bssid));
+    s_ap_hint.channel = ap.primary;
+    s_ap_hint.valid = true;
+}
+
+void wifi_manager_forget_ap(void)
+{
+    s_ap_hint.valid = false;
+    if (!s_hint_in_use) {
+        return;
+    }
+    s_hint_in_use = false;
+
+    wifi_config_t wifi_config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK) {
+        wifi_config.sta.bssid_set = false;
+        wifi_config.sta.channel = 0;
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+        ESP_LOGI(TAG, "Remembered AP not reached, scanning all channels");
+    }
+}
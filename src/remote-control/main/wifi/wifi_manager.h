@@ -13,6 +13,23 @@
 /**
  * @brief Initialize and start WiFi connection
  * 
+ * After a wake from standby the AP remembered by wifi_manager_remember_ap()
+ * is joined directly on its channel instead of scanning all channels.
+ * 
  * @return ESP_OK on success, ESP_ERR_* on failure
  */
 esp_err_t wifi_manager_init();
+
+/**
+ * @brief Remember the connected AP's BSSID and channel in RTC memory
+ *
+ * Call once connected; kept across deep sleep only.
+ */
+void wifi_manager_remember_ap(void);
+
+/**
+ * @brief Stop using the remembered AP, so the next attempt scans all channels
+ *
+ * Call when a connection attempt failed (the AP may have changed channel).
+ */
+void wifi_manager_forget_ap(void);
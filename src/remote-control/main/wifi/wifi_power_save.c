@@ -0,0 +1,174 @@
+#include "wifi_power_save.h"
+
+#include <stdbool.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "WIFI_POWER_SAVE";
+
+#define ACTIVE_WINDOW_US ((uint64_t)CONFIG_WIFI_PS_ACTIVE_WINDOW_MS * 1000)
+#define IDLE_TASK_STACK_SIZE    2048
+#define IDLE_TASK_PRIORITY      2
+
+static const wifi_ps_type_t s_ps_types[WIFI_POWER_SAVE_MODE_COUNT] = {
+    [WIFI_POWER_SAVE_ACTIVE] = WIFI_PS_NONE,
+    [WIFI_POWER_SAVE_IDLE] = WIFI_PS_MAX_MODEM,
+};
+
+/* Serialises mode changes, so the driver always ends up in s_mode */
+static SemaphoreHandle_t s_switch_lock = NULL;
+static esp_timer_handle_t s_idle_timer = NULL;
+static TaskHandle_t s_idle_task = NULL;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static wifi_power_save_mode_t s_mode = WIFI_POWER_SAVE_IDLE;
+static int64_t s_mode_since_us = 0;
+static uint64_t s_residency_us[WIFI_POWER_SAVE_MODE_COUNT];
+static uint64_t s_latency_ms_total[WIFI_POWER_SAVE_MODE_COUNT];
+static wifi_power_save_metrics_t s_metrics;
+
+static void switch_mode(wifi_power_save_mode_t mode)
+{
+    xSemaphoreTake(s_switch_lock, portMAX_DELAY);
+    if (mode != s_mode) {
+        esp_err_t err = esp_wifi_set_ps(s_ps_types[mode]);
+        if (err == ESP_OK) {
+            int64_t now_us = esp_timer_get_time();
+            portENTER_CRITICAL(&s_lock);
+            s_residency_us[s_mode] += now_us - s_mode_since_us;
+            s_mode_since_us = now_us;
+            s_mode = mode;
+            s_metrics.switches++;
+            portEXIT_CRITICAL(&s_lock);
+            ESP_LOGD(TAG, "Power save %s", mode == WIFI_POWER_SAVE_ACTIVE ? "off" : "on");
+        } else {
+            ESP_LOGW(TAG, "Failed to set power save mode: %s", esp_err_to_name(err));
+        }
+    }
+    xSemaphoreGive(s_switch_lock);
+}
+
+/* Switching waits for the lock and the WiFi driver: keep it off the esp_timer task */
+static void idle_timer_callback(void *arg)
+{
+    (void)arg;
+    xTaskNotifyGive(s_idle_task);
+}
+
+static void idle_task(void *arg)
+{
+    (void)arg;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        xSemaphoreTake(s_switch_lock, portMAX_DELAY);
+        /* Input since the timer fired restarted it first: the new window stays active */
+        bool active_window = esp_timer_is_active(s_idle_timer);
+        xSemaphoreGive(s_switch_lock);
+        if (!active_window) {
+            switch_mode(WIFI_POWER_SAVE_IDLE);
+        }
+    }
+}
+
+esp_err_t wifi_power_save_init(void)
+{
+    if (s_idle_timer != NULL) {
+        return ESP_OK;
+    }
+
+    s_switch_lock = xSemaphoreCreateMutex();
+    if (s_switch_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = idle_timer_callback,
+        .name = "wifi_ps",
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_idle_timer);
+    if (err == ESP_OK && xTaskCreate(idle_task, "wifi_ps", IDLE_TASK_STACK_SIZE, NULL,
+                                     IDLE_TASK_PRIORITY, &s_idle_task) != pdPASS) {
+        esp_timer_delete(s_idle_timer);
+        s_idle_timer = NULL;
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err != ESP_OK) {
+        vSemaphoreDelete(s_switch_lock);
+        s_switch_lock = NULL;
+        return err;
+    }
+
+    s_mode_since_us = esp_timer_get_time();
+    /* Booting or waking is user activity: the first command should be quick */
+    wifi_power_save_note_activity();
+
+    ESP_LOGI(TAG, "Power save off for %d ms after input, then listen interval %d",
+             CONFIG_WIFI_PS_ACTIVE_WINDOW_MS, CONFIG_WIFI_PS_LISTEN_INTERVAL);
+    return ESP_OK;
+}
+
+void wifi_power_save_note_activity(void)
+{
+    if (s_idle_timer == NULL) {
+        return;
+    }
+    /* Window first: an idle switch already under way then sees it and stands down */
+    esp_timer_stop(s_idle_timer);
+    esp_timer_start_once(s_idle_timer, ACTIVE_WINDOW_US);
+    switch_mode(WIFI_POWER_SAVE_ACTIVE);
+}
+
+wifi_power_save_mode_t wifi_power_save_get_mode(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    wifi_power_save_mode_t mode = s_mode;
+    portEXIT_CRITICAL(&s_lock);
+    return mode;
+}
+
+void wifi_power_save_record_command(wifi_power_save_mode_t mode, uint32_t latency_ms)
+{
+    if (mode >= WIFI_POWER_SAVE_MODE_COUNT) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    wifi_power_save_mode_metrics_t *metrics = &s_metrics.modes[mode];
+    metrics->commands++;
+    s_latency_ms_total[mode] += latency_ms;
+    metrics->avg_latency_ms = (uint32_t)(s_latency_ms_total[mode] / metrics->commands);
+    if (latency_ms > metrics->max_latency_ms) {
+        metrics->max_latency_ms = latency_ms;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void wifi_power_save_get_metrics(wifi_power_save_metrics_t *metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    *metrics = s_metrics;
+    for (int i = 0; i < WIFI_POWER_SAVE_MODE_COUNT; i++) {
+        uint64_t residency_us = s_residency_us[i];
+        if ((wifi_power_save_mode_t)i == s_mode && s_idle_timer != NULL) {
+            residency_us += now_us - s_mode_since_us;
+        }
+        metrics->modes[i].residency_ms = (uint32_t)(residency_us / 1000);
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    const wifi_power_save_mode_metrics_t *active = &metrics->modes[WIFI_POWER_SAVE_ACTIVE];
+    const wifi_power_save_mode_metrics_t *idle = &metrics->modes[WIFI_POWER_SAVE_IDLE];
+    if (active->commands > 0 && idle->commands > 0) {
+        metrics->added_latency_ms = (int32_t)idle->avg_latency_ms - (int32_t)active->avg_latency_ms;
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @file wifi_power_save.h
+ * @brief WiFi power save driven by user activity
+ *
+ * Idle, the station runs in maximum modem sleep and only wakes for every
+ * CONFIG_WIFI_PS_LISTEN_INTERVAL-th beacon, so frames for it wait at the AP
+ * for up to that many beacon intervals. Any button, card or volume input
+ * switches power save off (WIFI_PS_NONE) for CONFIG_WIFI_PS_ACTIVE_WINDOW_MS,
+ * so the command it causes and the state reads that follow are answered
+ * without the beacon delay. With automatic light sleep enabled, the WiFi
+ * driver also keeps the chip awake during that window.
+ *
+ * Time spent in each mode and the command round trips started in each mode
+ * are in wifi_power_save_get_metrics(); the difference of the averages is
+ * the latency power save adds.
+ */
+
+typedef enum {
+    WIFI_POWER_SAVE_ACTIVE = 0,     /* WIFI_PS_NONE after user activity */
+    WIFI_POWER_SAVE_IDLE,           /* WIFI_PS_MAX_MODEM with the long listen interval */
+    WIFI_POWER_SAVE_MODE_COUNT,
+} wifi_power_save_mode_t;
+
+typedef struct {
+    uint32_t residency_ms;          /* Time spent in this mode since start */
+    uint32_t commands;              /* Music Assistant commands started in this mode */
+    uint32_t avg_latency_ms;
+    uint32_t max_latency_ms;
+} wifi_power_save_mode_metrics_t;
+
+typedef struct {
+    uint32_t switches;              /* Mode changes */
+    wifi_power_save_mode_metrics_t modes[WIFI_POWER_SAVE_MODE_COUNT];
+    int32_t added_latency_ms;       /* Idle minus active average; 0 until both have commands */
+} wifi_power_save_metrics_t;
+
+/**
+ * @brief Start in the active mode and arm the idle timer
+ *
+ * Call after wifi_manager_init().
+ *
+ * @return ESP_OK on success, ESP_ERR_* on failure
+ */
+esp_err_t wifi_power_save_init(void);
+
+/**
+ * @brief User input: power save off for the next active window
+ *
+ * Cheap when already active (restarts the window). Safe to call from any
+ * task except the esp_timer task: switching waits for the WiFi driver.
+ */
+void wifi_power_save_note_activity(void);
+
+/**
+ * @brief Current mode, to tag a command about to be sent
+ */
+wifi_power_save_mode_t wifi_power_save_get_mode(void);
+
+/**
+ * @brief Record the round trip of a command started in the given mode
+ */
+void wifi_power_save_record_command(wifi_power_save_mode_t mode, uint32_t latency_ms);
+
+/**
+ * @brief Copy the counters; the residency includes the running period
+ */
+void wifi_power_save_get_metrics(wifi_power_save_metrics_t *metrics);
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""Stand-in for the parts of the Home Assistant REST API the panel uses.
+
+Answers service calls, the media player state document and the template
+endpoint with a fixed delay, so request pipelining and connection reuse can
+be measured without a real server:
+
+    python3 tools/mock_ha_server.py --port 8123 --latency-ms 100
+
+Point CONFIG_MUSIC_ASSISTANT_HOST at it and enable
+CONFIG_MUSIC_ASSISTANT_BENCHMARK. The log shows every request with its
+arrival time, how many requests were in flight and on which connection.
+
+With --tls-cert/--tls-key the server speaks https and logs every handshake
+with its duration and whether the client resumed a session, e.g. with a
+self-signed certificate (pin it with CONFIG_MUSIC_ASSISTANT_TLS_CA_PEM):
+
+    openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:P-256 -nodes \
+        -days 365 -subj /CN=<address> -addext subjectAltName=IP:<address> \
+        -keyout key.pem -out main/certs/music_assistant_ca.pem
+    python3 tools/mock_ha_server.py --tls-cert main/certs/music_assistant_ca.pem --tls-key key.pem
+
+--no-tickets stops issuing session tickets, so every connect is a full
+handshake for comparison.
+"""
+
+import argparse
+import gzip
+import json
+import ssl
+import threading
+import time
+from datetime import datetime, timezone
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class Player:
+    """Just enough player state to answer consistently."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.state = "paused"
+        self.volume = 0.3
+        self.position = 0.0
+        self.updated = time.time()
+
+    def apply(self, service, body):
+        with self.lock:
+            now = time.time()
+            if self.state == "playing":
+                self.position += now - self.updated
+            self.updated = now
+            if service in ("media_play", "play_media"):
+                self.state = "playing"
+            elif service == "media_pause":
+                self.state = "paused"
+            elif service == "volume_set":
+                self.volume = float(body.get("volume_level", self.volume))
+            elif service == "media_seek":
+                self.position = float(body.get("seek_position", 0.0))
+
+    def document(self, entity_id):
+        with self.lock:
+            updated = datetime.fromtimestamp(self.updated, timezone.utc).isoformat()
+            return {
+                "entity_id": entity_id,
+                "state": self.state,
+                "attributes": {
+                    "volume_level": self.volume,
+                    "media_title": "Mock Title",
+                    "media_artist": "Mock Artist",
+                    "media_duration": 240.0,
+                    "media_position": round(self.position, 2),
+                    "media_position_updated_at": updated,
+                },
+                "last_updated": updated,
+            }
+
+    def template(self):
+        with self.lock:
+            return "%.2f|%.3f|%s" % (self.position, self.updated, self.state)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"   # keep-alive, like Home Assistant
+    player = Player()
+    latency_s = 0.0
+    in_flight = 0
+    in_flight_lock = threading.Lock()
+
+    def log_message(self, fmt, *args):
+        pass
+
+    def setup(self):
+        if isinstance(self.request, ssl.SSLSocket):
+            # Handshake here, in the connection's thread, to time it
+            start = time.time()
+            self.request.do_handshake()
+            print("%.3f TLS   %s handshake in %.1f ms conn=%s:%d" % (
+                time.time(), "resumed" if self.request.session_reused else "full",
+                (time.time() - start) * 1000.0,
+                self.client_address[0], self.client_address[1]), flush=True)
+        super().setup()
+
+    def _enter(self):
+        with Handler.in_flight_lock:
+            Handler.in_flight += 1
+            in_flight = Handler.in_flight
+        print("%.3f %-5s %-45s in_flight=%d conn=%s:%d" % (
+            time.time(), self.command, self.path, in_flight,
+            self.client_address[0], self.client_address[1]), flush=True)
+        time.sleep(Handler.latency_s)
+
+    def _leave(self):
+        with Handler.in_flight_lock:
+            Handler.in_flight -= 1
+
+    def _reply(self, status, payload, content_type="application/json"):
+        data = payload.encode()
+        headers = {"Content-Type": content_type}
+        if "gzip" in self.headers.get("Accept-Encoding", ""):
+            data = gzip.compress(data)
+            headers["Content-Encoding"] = "gzip"
+        self.send_response(status)
+        for key, value in headers.items():
+            self.send_header(key, value)
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def _body(self):
+        length = int(self.headers.get("Content-Length", 0))
+        raw = self.rfile.read(length) if length else b""
+        try:
+            return json.loads(raw or b"{}")
+        except ValueError:
+            return None
+
+    def do_POST(self):
+        self._enter()
+        try:
+            body = self._body()
+            if body is None:
+                self._reply(400, '{"message":"Invalid JSON"}')
+            elif self.path.startswith("/api/services/"):
+                self.player.apply(self.path.rsplit("/", 1)[-1], body)
+                self._reply(200, "[]")
+            elif self.path == "/api/template":
+                self._reply(200, self.player.template(), "text/plain")
+            else:
+                self._reply(404, '{"message":"Not found"}')
+        finally:
+            self._leave()
+
+    def do_GET(self):
+        self._enter()
+        try:
+            if self.path.startswith("/api/states/"):
+                entity_id = self.path[len("/api/states/"):]
+                self._reply(200, json.dumps(self.player.document(entity_id)))
+            else:
+                self._reply(404, '{"message":"Not found"}')
+        finally:
+            self._leave()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8123)
+    parser.add_argument("--latency-ms", type=int, default=100,
+                        help="delay before every response (default 100)")
+    parser.add_argument("--tls-cert", help="serve https with this PEM certificate")
+    parser.add_argument("--tls-key", help="private key of --tls-cert")
+    parser.add_argument("--no-tickets", action="store_true",
+                        help="do not issue TLS session tickets (full handshakes only)")
+    args = parser.parse_args()
+
+    Handler.latency_s = args.latency_ms / 1000.0
+    server = ThreadingHTTPServer((args.host, args.port), Handler)
+    scheme = "http"
+    if args.tls_cert:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(args.tls_cert, args.tls_key)
+        if args.no_tickets:
+            context.options |= ssl.OP_NO_TICKET     # TLS 1.2
+            context.num_tickets = 0                 # TLS 1.3
+        server.socket = context.wrap_socket(server.socket, server_side=True,
+                                            do_handshake_on_connect=False)
+        scheme = "https"
+    print("Mock Home Assistant on %s://%s:%d, %d ms latency" % (
+        scheme, args.host, args.port, args.latency_ms), flush=True)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()